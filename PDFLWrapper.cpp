@@ -22,6 +22,9 @@
 #include "PDCalls.h"
 #include "ASCalls.h"
 
+#include "PDFLibStats.h"
+#include "PDFLibTrace.h"
+
 namespace  {
 
 	class PDFLInitter  {
@@ -92,15 +95,233 @@ namespace  {
 
 	TypeMap g_mTypeMap = CreateTypeMap();
 
+	// The error goes to the Document's log and the error sink; its text is
+	// only looked up when asked for, see PDFLDoc::GetErrorMessage.
 	void
-	ReportSPDFError(const char *szMessage, ASErrorCode nError)
+	ReportSPDFError(const PDFLDoc *pDoc, const char *szOperation, ASErrorCode nError,
+		Object::ID nID = Object::kInvalidID, const Name *pKey = NULL, long nIndex = -1)
+	{
+		PDFLIB_STAT_COUNT(kStatPDFLErrors);
+		ErrorRecord oError;
+		oError.m_nCode = nError;
+		oError.m_szOperation = szOperation;
+		oError.m_nID = nID;
+		if (pKey)  {
+			oError.m_nmKey = *pKey;
+		}
+		oError.m_nIndex = nIndex;
+		Document::ReportError(pDoc, oError);
+	}
+
+	// std::istream reading a decoded Cos stream a buffer at a time
+	class ASStmBuf : public std::streambuf  {
+	public:
+		ASStmBuf(ASStm stm, const PDFLDoc *pDoc) : m_stm(stm), m_pDoc(pDoc), m_vBuffer(16 * 1024)  { }
+		~ASStmBuf()  {
+			DURING
+				ASStmClose(m_stm);
+			HANDLER
+				ReportSPDFError(m_pDoc, "Error closing stream", ERRORCODE);
+			END_HANDLER
+		}
+
+	protected:
+		virtual int_type underflow()  {
+			if (gptr() < egptr())  {
+				return traits_type::to_int_type(*gptr());
+			}
+			ASTArraySize nRead = 0;
+			DURING
+				nRead = ASStmRead(&m_vBuffer[0], 1, m_vBuffer.size(), m_stm);
+			HANDLER
+				ReportSPDFError(m_pDoc, "Error reading stream", ERRORCODE);
+				nRead = 0;
+			END_HANDLER
+			if (nRead <= 0)  {
+				return traits_type::eof();
+			}
+			setg(&m_vBuffer[0], &m_vBuffer[0], &m_vBuffer[0] + nRead);
+			return traits_type::to_int_type(*gptr());
+		}
+
+	private:
+		ASStm m_stm;
+		const PDFLDoc *m_pDoc;
+		std::vector<char> m_vBuffer;
+	};
+
+	class ASStmIStream : public std::istream  {
+	public:
+		ASStmIStream(ASStm stm, const PDFLDoc *pDoc) : std::istream(NULL), m_oBuf(stm, pDoc)  {
+			rdbuf(&m_oBuf);
+		}
+
+	private:
+		ASStmBuf m_oBuf;
+	};
+
+	// ASFileSys reading through a PDFLibWrapper::Reader, so documents can be
+	// opened from memory or any other byte source.  Its ASPathNames are
+	// heap-allocated Reader::Ptrs.  Reads from a RangeReader that can't be
+	// served yet fail with fileErrBytesNotReady, after asking for the bytes.
+	struct ReaderFile  {
+		ReaderFile(const Reader::Ptr &pReader)
+			: m_pReader(pReader), m_pRangeReader(dynamic_cast<RangeReader *>(pReader.get())),
+			  m_nPos(0)
+		{ }
+		Reader::Ptr m_pReader;
+		RangeReader *m_pRangeReader;
+		boost::int64_t m_nPos;
+	};
+
+	ACCB1 ASErrorCode ACCB2
+	ReaderFileOpen(ASPathName pathName, ASUns16 nMode, MDFile *pFile)
+	{
+		if (!pathName || (nMode & ASFILE_WRITE))  {
+			return fileErrWrPerm;
+		}
+		*pFile = (MDFile)new ReaderFile(*(Reader::Ptr *)pathName);
+		return 0;
+	}
+
+	ACCB1 ASInt32 ACCB2
+	ReaderFileClose(MDFile pFile)
+	{
+		delete (ReaderFile *)pFile;
+		return 0;
+	}
+
+	ACCB1 ASInt32 ACCB2
+	ReaderFileFlush(MDFile)
+	{
+		return 0;
+	}
+
+	ACCB1 ASInt32 ACCB2
+	ReaderFileSetPos(MDFile pFile, ASFilePos nPos)
+	{
+		((ReaderFile *)pFile)->m_nPos = nPos;
+		return 0;
+	}
+
+	// the 32-bit procedures fail rather than truncate beyond 2 GB; PDFL
+	// uses the 64-bit ones where it can
+	ACCB1 ASInt32 ACCB2
+	ReaderFileGetPos(MDFile pFile, ASFilePos *pnPos)
+	{
+		boost::int64_t nPos = ((ReaderFile *)pFile)->m_nPos;
+		if (nPos > boost::integer_traits<ASInt32>::const_max)  {
+			return fileErrIO;
+		}
+		*pnPos = (ASFilePos)nPos;
+		return 0;
+	}
+
+	ACCB1 ASInt32 ACCB2
+	ReaderFileGetEof(MDFile pFile, ASFilePos *pnPos)
+	{
+		boost::int64_t nSize = ((ReaderFile *)pFile)->m_pReader->GetSize();
+		if (nSize > boost::integer_traits<ASInt32>::const_max)  {
+			return fileErrIO;
+		}
+		*pnPos = (ASFilePos)nSize;
+		return 0;
+	}
+
+	ACCB1 ASErrorCode ACCB2
+	ReaderFileSetPos64(MDFile pFile, ASFilePos64 nPos)
+	{
+		((ReaderFile *)pFile)->m_nPos = nPos;
+		return 0;
+	}
+
+	ACCB1 ASErrorCode ACCB2
+	ReaderFileGetPos64(MDFile pFile, ASFilePos64 *pnPos)
+	{
+		*pnPos = ((ReaderFile *)pFile)->m_nPos;
+		return 0;
+	}
+
+	ACCB1 ASErrorCode ACCB2
+	ReaderFileGetEof64(MDFile pFile, ASFilePos64 *pnPos)
+	{
+		*pnPos = ((ReaderFile *)pFile)->m_pReader->GetSize();
+		return 0;
+	}
+
+	ACCB1 ASSize_t ACCB2
+	ReaderFileRead(void *pDest, ASSize_t nSize, ASSize_t nCount, MDFile pFile,
+		ASInt32 *pnError)
+	{
+		ReaderFile *pReaderFile = (ReaderFile *)pFile;
+		RangeReader *pRangeReader = pReaderFile->m_pRangeReader;
+		if (pRangeReader && !pRangeReader->IsAvailable(pReaderFile->m_nPos, nSize * nCount))  {
+			pRangeReader->Request(pReaderFile->m_nPos, nSize * nCount);
+			*pnError = fileErrBytesNotReady;
+			return 0;
+		}
+		size_t nRead = pReaderFile->m_pReader->ReadAt(pReaderFile->m_nPos, pDest,
+			nSize * nCount);
+		pReaderFile->m_nPos += nRead;
+		*pnError = 0;
+		return (ASSize_t)nRead;
+	}
+
+	ACCB1 ASInt32 ACCB2
+	ReaderFileGetName(ASPathName, char *szName, ASInt32 nMaxLength)
+	{
+		if (nMaxLength > 0)  {
+			strncpy(szName, "reader.pdf", nMaxLength);
+			szName[nMaxLength - 1] = 0;
+		}
+		return 0;
+	}
+
+	ACCB1 ASPathName ACCB2
+	ReaderFileCopyPathName(ASPathName pathName)
+	{
+		return (ASPathName)new Reader::Ptr(*(Reader::Ptr *)pathName);
+	}
+
+	ACCB1 void ACCB2
+	ReaderFileDisposePathName(ASPathName pathName)
+	{
+		delete (Reader::Ptr *)pathName;
+	}
+
+	ACCB1 ASAtom ACCB2
+	ReaderFileGetFileSysName()
+	{
+		return ASAtomFromString("PDFLibWrapperReader");
+	}
+
+	ASFileSys
+	GetReaderFileSys()
 	{
-		std::cerr << szMessage;
-		char szError[256] = {0};
-		if (ASGetErrorString(nError, szError, sizeof(szError)))  {
-			std::cerr << ":  " << szError;
+		static ASFileSysRec g_oReaderFileSys;
+		static bool g_bInitialized = false;
+		static boost::mutex g_mtxReaderFileSys;
+		boost::unique_lock<boost::mutex> lck(g_mtxReaderFileSys);
+		if (!g_bInitialized)  {
+			memset(&g_oReaderFileSys, 0, sizeof(g_oReaderFileSys));
+			g_oReaderFileSys.size = sizeof(g_oReaderFileSys);
+			g_oReaderFileSys.open = ReaderFileOpen;
+			g_oReaderFileSys.close = ReaderFileClose;
+			g_oReaderFileSys.flush = ReaderFileFlush;
+			g_oReaderFileSys.setpos = ReaderFileSetPos;
+			g_oReaderFileSys.getpos = ReaderFileGetPos;
+			g_oReaderFileSys.geteof = ReaderFileGetEof;
+			g_oReaderFileSys.read = ReaderFileRead;
+			g_oReaderFileSys.getName = ReaderFileGetName;
+			g_oReaderFileSys.copyPathName = ReaderFileCopyPathName;
+			g_oReaderFileSys.disposePathName = ReaderFileDisposePathName;
+			g_oReaderFileSys.getFileSysName = ReaderFileGetFileSysName;
+			g_oReaderFileSys.setpos64 = ReaderFileSetPos64;
+			g_oReaderFileSys.getpos64 = ReaderFileGetPos64;
+			g_oReaderFileSys.geteof64 = ReaderFileGetEof64;
+			g_bInitialized = true;
 		}
-		std::cerr << std::endl;
+		return &g_oReaderFileSys;
 	}
 
 }
@@ -126,6 +347,10 @@ struct PDFLObject::Impl  {
 	int GetLength();
 	bool GetKeys(NameSet &setKeys);
 	CosObjWrapper GetElement(int nIndex);
+	bool ConvertElement(CosObj coValue, int &nValue);
+	bool ConvertElement(CosObj coValue, double &dValue);
+	bool ConvertElement(CosObj coValue, Name &rValue);
+	template <class T> bool GetElements(T *pValues, size_t nMaxCount, size_t &nCount);
 	bool GetValue(const char *szName, Object::Ptr &pObj);
 	bool GetValue(const Name &nmKey, Object::Ptr &pObj);
 	const Name &GetName(const char *szName);
@@ -134,8 +359,26 @@ struct PDFLObject::Impl  {
 
 	static ASBool DictEnum(CosObj inCosObj, CosObj inValue, void *inClientData);
 
+	void ExtractValue(CosObj coValue, Object::Value &rValue);
+	struct EntryExtractor  {
+		Impl *m_pImpl;
+		std::vector<Object::Entry> *m_pvEntries;
+		size_t m_nEntries;
+	};
+	static ASBool EntryEnum(CosObj inKey, CosObj inValue, void *inClientData);
+
+	struct ReferenceCollector  {
+		std::vector<Object::ID> *m_pvIDs;
+		int m_nDepth;
+	};
+	static void CollectReferences(CosObj coObject, ReferenceCollector &rCollector);
+	static ASBool ReferenceEnum(CosObj inKey, CosObj inValue, void *inClientData);
+
 	bool HasKey(const Name &nmKey);
 
+	void ReportError(const char *szOperation, ASErrorCode nError, const Name *pKey = NULL,
+		long nIndex = -1);
+
 
 	PDFLDoc *m_pDoc;
 	CosObjWrapper m_CosObj;
@@ -150,6 +393,20 @@ PDFLObject::Impl::Impl(CosObjWrapper co, PDFLDoc *pDoc)
 {
 }
 
+void
+PDFLObject::Impl::ReportError(const char *szOperation, ASErrorCode nError,
+	const Name *pKey /*= NULL */, long nIndex /*= -1 */)
+{
+	Object::ID nID = Object::kInvalidID;
+	DURING
+		if (m_CosObj && CosObjIsIndirect(m_CosObj))  {
+			nID = CosObjGetID(m_CosObj);
+		}
+	HANDLER
+	END_HANDLER
+	ReportSPDFError(m_pDoc, szOperation, nError, nID, pKey, nIndex);
+}
+
 int
 PDFLObject::Impl::GetLength()
 {
@@ -161,7 +418,7 @@ PDFLObject::Impl::GetLength()
 				return 1;
 			}
 		HANDLER
-			ReportSPDFError("Error getting length", ERRORCODE);
+			ReportError("Error getting length", ERRORCODE);
 		END_HANDLER
 	}
 
@@ -191,13 +448,76 @@ PDFLObject::Impl::GetElement(int nIndex)
 				}
 			}
 		HANDLER
-			ReportSPDFError("Error getting object in GetElement", ERRORCODE);
+			ReportError("Error getting object in GetElement", ERRORCODE, NULL, nIndex);
 		END_HANDLER
 	}
 
 	return coRet;
 }
 
+bool
+PDFLObject::Impl::ConvertElement(CosObj coValue, int &nValue)
+{
+	if (CosObjGetType(coValue) != CosInteger)  {
+		return false;
+	}
+	nValue = CosIntegerValue(coValue);
+	return true;
+}
+
+bool
+PDFLObject::Impl::ConvertElement(CosObj coValue, double &dValue)
+{
+	switch (CosObjGetType(coValue))  {
+		case CosInteger:
+			dValue = CosIntegerValue(coValue);
+			return true;
+		case CosFixed:
+			dValue = ASFixedToFloat(CosFixedValue(coValue));
+			return true;
+		default:
+			return false;
+	}
+}
+
+bool
+PDFLObject::Impl::ConvertElement(CosObj coValue, Name &rValue)
+{
+	if (CosObjGetType(coValue) != CosName)  {
+		return false;
+	}
+	rValue = GetName(CosNameValue(coValue));
+	return rValue.IsValid();
+}
+
+// The type and length of the array once, instead of for every element as
+// GetElement does.
+template <class T>
+bool
+PDFLObject::Impl::GetElements(T *pValues, size_t nMaxCount, size_t &nCount)
+{
+	nCount = 0;
+	if (!m_CosObj)  {
+		return false;
+	}
+
+	DURING
+		CosObj coArray = m_CosObj;
+		bool bArray = CosObjGetType(coArray) == CosArray;
+		size_t nLength = bArray ? CosArrayLength(coArray) : 1;
+		for (; nCount<nLength && nCount<nMaxCount; nCount++)  {
+			CosObj coValue = bArray ? CosArrayGet(coArray, (ASInt32)nCount) : coArray;
+			if (!ConvertElement(coValue, pValues[nCount]))  {
+				return false;
+			}
+		}
+		return nLength <= nMaxCount;
+	HANDLER
+		ReportError("Error getting array elements", ERRORCODE, NULL, (long)nCount);
+	END_HANDLER
+	return false;
+}
+
 bool
 PDFLObject::Impl::HasKey(const Name &nmKey)
 {
@@ -228,7 +548,7 @@ PDFLObject::Impl::HasKey(const Name &nmKey)
 			}
 		}
 	HANDLER
-		ReportSPDFError("Error in HasKey", ERRORCODE);
+		ReportError("Error in HasKey", ERRORCODE, &nmKey);
 	END_HANDLER
 
 	return false;
@@ -242,10 +562,13 @@ PDFLObject::Impl::GetValue(const Name &nmKey, Object::Ptr &pObj)
 	if (m_pDict)  {
 		Dict::const_iterator itFind = m_pDict->find(nmKey);
 		if (itFind != m_pDict->end())  {
+			PDFLIB_STAT_COUNT(kStatDictCacheHits);
 			pObj = itFind->second;
 			return true;
 		}
 	}
+	PDFLIB_STAT_COUNT(kStatDictCacheMisses);
+	PDFLIB_STAT_TIME(kStatGetValue);
 
 	CosObjWrapper coValue;
 	CosObjWrapper coDict;
@@ -273,7 +596,7 @@ PDFLObject::Impl::GetValue(const Name &nmKey, Object::Ptr &pObj)
 			}
 		}
 	HANDLER
-		ReportSPDFError("Error in GetValue", ERRORCODE);
+		ReportError("Error in GetValue", ERRORCODE, &nmKey);
 	END_HANDLER
 		pObj.reset();
 
@@ -345,7 +668,7 @@ PDFLObject::Impl::GetKeys(NameSet &setKeys)
 			}
 		}
 	HANDLER
-		ReportSPDFError("Error getting dictionary keys", ERRORCODE);
+		ReportError("Error getting dictionary keys", ERRORCODE);
 	END_HANDLER
 	return false;
 }
@@ -360,10 +683,120 @@ PDFLObject::Impl::DictEnum(CosObj inCosObj, CosObj , void *inClientData)
 	return true;
 }
 
+// the type once, and the payload with the call made for that type
+void
+PDFLObject::Impl::ExtractValue(CosObj coValue, Object::Value &rValue)
+{
+	rValue.m_pObject.reset();
+	switch (CosObjGetType(coValue))  {
+		case CosNull:
+			rValue.m_eType = Object::kNull;
+			break;
+		case CosBoolean:
+			rValue.m_eType = Object::kBoolean;
+			rValue.m_bBoolean = CosBooleanValue(coValue) != 0;
+			break;
+		case CosInteger:
+			rValue.m_eType = Object::kInteger;
+			rValue.m_nInteger = CosIntegerValue(coValue);
+			break;
+		case CosFixed:
+			rValue.m_eType = Object::kFixed;
+			rValue.m_dReal = ASFixedToFloat(CosFixedValue(coValue));
+			break;
+		case CosName:
+			rValue.m_eType = Object::kName;
+			rValue.m_nmName = GetName(CosNameValue(coValue));
+			break;
+		case CosString:  {
+			ASInt32 nLength = 0;
+			const char *szValue = CosStringValue(coValue, &nLength);
+			rValue.m_eType = Object::kString;
+			rValue.m_sString.assign(szValue ? szValue : "", szValue ? nLength : 0);
+			break;
+		}
+		case CosArray:
+			rValue.m_eType = Object::kArray;
+			m_pDoc->CreateObject(coValue, rValue.m_pObject);
+			break;
+		case CosDict:
+			rValue.m_eType = Object::kDict;
+			m_pDoc->CreateObject(coValue, rValue.m_pObject);
+			break;
+		case CosStream:
+			rValue.m_eType = Object::kStream;
+			m_pDoc->CreateObject(coValue, rValue.m_pObject);
+			break;
+		default:
+			rValue.m_eType = Object::kUnknown;
+			break;
+	}
+}
+
+ASBool
+PDFLObject::Impl::EntryEnum(CosObj inKey, CosObj inValue, void *inClientData)
+{
+	EntryExtractor *pExtractor = (EntryExtractor *)inClientData;
+	if (CosObjGetType(inKey) != CosName)  {
+		return true;
+	}
+	std::vector<Object::Entry> &vEntries = *pExtractor->m_pvEntries;
+	if (pExtractor->m_nEntries == vEntries.size())  {
+		vEntries.resize(vEntries.size() + 1);
+	}
+	Object::Entry &rEntry = vEntries[pExtractor->m_nEntries++];
+	rEntry.m_nmKey = pExtractor->m_pImpl->GetName(CosNameValue(inKey));
+	pExtractor->m_pImpl->ExtractValue(inValue, rEntry.m_oValue);
+	return true;
+}
+
+void
+PDFLObject::Impl::CollectReferences(CosObj coObject, ReferenceCollector &rCollector)
+{
+	// deeply nested direct objects are rare; stop rather than recurse forever
+	if (rCollector.m_nDepth > 32)  {
+		return;
+	}
+	++rCollector.m_nDepth;
+	switch (CosObjGetType(coObject))  {
+		case CosStream:
+			CosObjEnum(CosStreamDict(coObject), ReferenceEnum, &rCollector);
+			break;
+		case CosDict:
+			CosObjEnum(coObject, ReferenceEnum, &rCollector);
+			break;
+		case CosArray:  {
+			ASTArraySize nLength = CosArrayLength(coObject);
+			for (ASTArraySize i=0; i<nLength; i++)  {
+				ReferenceEnum(CosArrayGet(coObject, i), CosNewNull(), &rCollector);
+			}
+			break;
+		}
+		default:
+			break;
+	}
+	--rCollector.m_nDepth;
+}
+
+ASBool
+PDFLObject::Impl::ReferenceEnum(CosObj inKey, CosObj inValue, void *inClientData)
+{
+	ReferenceCollector &rCollector = *(ReferenceCollector *)inClientData;
+	// dictionaries pass key and value, arrays just the element
+	CosObj coValue = CosObjGetType(inValue) == CosNull ? inKey : inValue;
+	if (CosObjIsIndirect(coValue))  {
+		rCollector.m_pvIDs->push_back(CosObjGetID(coValue));
+	} else  {
+		CollectReferences(coValue, rCollector);
+	}
+	return true;
+}
+
 
 PDFLObject::PDFLObject(CosObjWrapper coObject, PDFLDoc *pDoc)
 : m_pImpl(new Impl(coObject, pDoc))
 {
+	PDFLIB_STAT_COUNT(kStatObjectsCreated);
 	if (coObject)  {
 		TypeMap::const_iterator itType = g_mTypeMap.find(CosObjGetType(coObject));
 		if (itType != g_mTypeMap.end())  {
@@ -378,7 +811,7 @@ PDFLObject::IsIndirect() const
 	DURING
 		return m_pImpl->m_CosObj && CosObjIsIndirect(m_pImpl->m_CosObj);
 	HANDLER
-		ReportSPDFError("Error in IsIndirect", ERRORCODE);
+		m_pImpl->ReportError("Error in IsIndirect", ERRORCODE);
 	END_HANDLER
 
 	return false;
@@ -392,7 +825,7 @@ PDFLObject::GetID() const
 		DURING
 			nRet = CosObjGetID(m_pImpl->m_CosObj);
 		HANDLER
-			ReportSPDFError("Error in GetID", ERRORCODE);
+			m_pImpl->ReportError("Error in GetID", ERRORCODE);
 		END_HANDLER
 	}
 	return nRet;
@@ -408,7 +841,7 @@ PDFLObject::Get(bool &bValue, int nIndex /*= 0 */)
 			return true;
 		}
 	HANDLER
-		ReportSPDFError("Error getting boolean value", ERRORCODE);
+		m_pImpl->ReportError("Error getting boolean value", ERRORCODE, NULL, nIndex);
 	END_HANDLER
 	return false;
 }
@@ -423,7 +856,7 @@ PDFLObject::Get(int &nValue, int nIndex /*= 0 */)
 			return true;
 		}
 	HANDLER
-		ReportSPDFError("Error getting int value", ERRORCODE);
+		m_pImpl->ReportError("Error getting int value", ERRORCODE, NULL, nIndex);
 	END_HANDLER
 	return false;
 }
@@ -441,7 +874,7 @@ PDFLObject::Get(unsigned int &nValue, int nIndex /*= 0 */)
 			}
 		}
 	HANDLER
-		ReportSPDFError("Error getting unsigned int value", ERRORCODE);
+		m_pImpl->ReportError("Error getting unsigned int value", ERRORCODE, NULL, nIndex);
 	END_HANDLER
 	return false;
 }
@@ -456,7 +889,7 @@ PDFLObject::Get(float &fValue, int nIndex /*= 0 */)
 			return true;
 		}
 	HANDLER
-		ReportSPDFError("Error getting float value", ERRORCODE);
+		m_pImpl->ReportError("Error getting float value", ERRORCODE, NULL, nIndex);
 	END_HANDLER
 	return false;
 }
@@ -471,7 +904,7 @@ PDFLObject::Get(double &dValue, int nIndex /*= 0 */)
 			return true;
 		}
 	HANDLER
-		ReportSPDFError("Error getting double value", ERRORCODE);
+		m_pImpl->ReportError("Error getting double value", ERRORCODE, NULL, nIndex);
 	END_HANDLER
 	return false;
 }
@@ -486,7 +919,7 @@ PDFLObject::Get(Name &rValue, int nIndex /*= 0 */)
 			return rValue.IsValid();
 		}
 	HANDLER
-		ReportSPDFError("Error getting Name value", ERRORCODE);
+		m_pImpl->ReportError("Error getting Name value", ERRORCODE, NULL, nIndex);
 	END_HANDLER
 
 	return false;
@@ -506,7 +939,7 @@ PDFLObject::Get(std::string &sValue, int nIndex /*= 0 */)
 			}
 		}
 	HANDLER
-		ReportSPDFError("Error getting string value", ERRORCODE);
+		m_pImpl->ReportError("Error getting string value", ERRORCODE, NULL, nIndex);
 	END_HANDLER
 	return false;
 }
@@ -531,7 +964,36 @@ PDFLObject::Get(Buffer &oValue, int nIndex /*= 0 */)
 bool
 PDFLObject::Get(Stream &oValue, int nIndex /*= 0 */)
 {
-	throw std::logic_error("The method or operation is not implemented.");
+	DURING
+		CosObjWrapper coValue = m_pImpl->GetElement(nIndex);
+		if (coValue && CosObjGetType(coValue) == CosStream)  {
+			ASStm stm = CosStreamOpenStm(coValue, cosOpenFiltered);
+			if (stm)  {
+				oValue.reset(new ASStmIStream(stm, m_pImpl->m_pDoc));
+				return true;
+			}
+		}
+	HANDLER
+		m_pImpl->ReportError("Error opening stream", ERRORCODE, NULL, nIndex);
+	END_HANDLER
+	return false;
+}
+
+bool
+PDFLObject::GetEncoded(Stream &oValue)
+{
+	DURING
+		if (m_pImpl->m_CosObj && CosObjGetType(m_pImpl->m_CosObj) == CosStream)  {
+			ASStm stm = CosStreamOpenStm(m_pImpl->m_CosObj, cosOpenUnfiltered);
+			if (stm)  {
+				oValue.reset(new ASStmIStream(stm, m_pImpl->m_pDoc));
+				return true;
+			}
+		}
+	HANDLER
+		m_pImpl->ReportError("Error opening encoded stream", ERRORCODE);
+	END_HANDLER
+	return false;
 }
 
 bool
@@ -619,7 +1081,11 @@ PDFLObject::Get(Buffer &oValue, const char *szKey)
 bool
 PDFLObject::Get(Stream &oValue, const char *szKey)
 {
-	throw std::logic_error("The method or operation is not implemented.");
+	Object::Ptr pObject;
+	if (m_pImpl->GetValue(szKey, pObject))  {
+		return pObject->Get(oValue);
+	}
+	return false;
 }
 
 bool
@@ -707,7 +1173,11 @@ PDFLObject::Get(Buffer &oValue, const Name &nmKey)
 bool
 PDFLObject::Get(Stream &oValue, const Name &nmKey)
 {
-	throw std::logic_error("The method or operation is not implemented.");
+	Object::Ptr pObject;
+	if (m_pImpl->GetValue(nmKey, pObject))  {
+		return pObject->Get(oValue);
+	}
+	return false;
 }
 
 int
@@ -722,6 +1192,89 @@ PDFLObject::GetKeys(NameSet &setKeys)
 	return m_pImpl->GetKeys(setKeys);
 }
 
+bool
+PDFLObject::GetReferences(std::vector<ID> &vIDs)
+{
+	if (!m_pImpl->m_CosObj)  { return false; }
+
+	DURING
+		Impl::ReferenceCollector oCollector;
+		oCollector.m_pvIDs = &vIDs;
+		oCollector.m_nDepth = 0;
+		Impl::CollectReferences(m_pImpl->m_CosObj, oCollector);
+		return true;
+	HANDLER
+		m_pImpl->ReportError("Error collecting references", ERRORCODE);
+	END_HANDLER
+	return false;
+}
+
+bool
+PDFLObject::GetElements(int *pValues, size_t nMaxCount, size_t &nCount)
+{
+	return m_pImpl->GetElements(pValues, nMaxCount, nCount);
+}
+
+bool
+PDFLObject::GetElements(double *pValues, size_t nMaxCount, size_t &nCount)
+{
+	return m_pImpl->GetElements(pValues, nMaxCount, nCount);
+}
+
+bool
+PDFLObject::GetElements(Name *pValues, size_t nMaxCount, size_t &nCount)
+{
+	return m_pImpl->GetElements(pValues, nMaxCount, nCount);
+}
+
+bool
+PDFLObject::ExtractElements(std::vector<Value> &vValues)
+{
+	if (!m_pImpl->m_CosObj)  { return false; }
+
+	DURING
+		CosObj coArray = m_pImpl->m_CosObj;
+		if (CosObjGetType(coArray) != CosArray)  {
+			return false;
+		}
+		vValues.resize(CosArrayLength(coArray));
+		for (size_t i=0; i<vValues.size(); i++)  {
+			m_pImpl->ExtractValue(CosArrayGet(coArray, (ASInt32)i), vValues[i]);
+		}
+		return true;
+	HANDLER
+		m_pImpl->ReportError("Error extracting array elements", ERRORCODE);
+	END_HANDLER
+	return false;
+}
+
+bool
+PDFLObject::ExtractEntries(std::vector<Entry> &vEntries)
+{
+	if (!m_pImpl->m_CosObj)  { return false; }
+
+	DURING
+		CosObj coDict = m_pImpl->m_CosObj;
+		CosType eType = CosObjGetType(coDict);
+		if (eType != CosDict && eType != CosStream)  {
+			return false;
+		}
+		if (eType == CosStream)  {
+			coDict = CosStreamDict(coDict);
+		}
+		Impl::EntryExtractor oExtractor;
+		oExtractor.m_pImpl = m_pImpl.get();
+		oExtractor.m_pvEntries = &vEntries;
+		oExtractor.m_nEntries = 0;
+		CosObjEnum(coDict, Impl::EntryEnum, &oExtractor);
+		vEntries.resize(oExtractor.m_nEntries);
+		return true;
+	HANDLER
+		m_pImpl->ReportError("Error extracting dictionary entries", ERRORCODE);
+	END_HANDLER
+	return false;
+}
+
 Document *
 PDFLObject::GetDoc() const
 {
@@ -745,15 +1298,23 @@ struct PDFLDoc::MyImpl  {
 	typedef std::map<Object::ID, boost::shared_ptr<PDFLObject> > ObjectMap;
 
 	MyImpl(PDFLDoc *pOwner, const std::string &sFileName);
+	~MyImpl();
 
 	bool Open(const std::string &sFileName);
+	bool Open(const Reader::Ptr &pReader);
 
 	bool GetObject(Object::ID nID, Object::Ptr &pObject);
+	// true if nError means the reader is still downloading, and more data
+	// has arrived since
+	bool WaitForBytes(ASErrorCode nError) const;
 
 	PDFLDoc *m_pOwner;
 	PDDoc m_pdDoc;
 	CosDoc m_cdDoc;
 	ObjectMap m_mObjects;
+	// set when opened through a Reader
+	ASFile m_asFile;
+	RangeReader::Ptr m_pRangeReader;
 };
 
 struct ASPathName_deleter  {
@@ -761,13 +1322,28 @@ struct ASPathName_deleter  {
 };
 
 PDFLDoc::MyImpl::MyImpl(PDFLDoc *pOwner, const std::string &sFileName)
-: m_pOwner(pOwner), m_pdDoc(NULL), m_cdDoc(NULL)
+: m_pOwner(pOwner), m_pdDoc(NULL), m_cdDoc(NULL), m_asFile(NULL)
 {
 	if (!sFileName.empty())  {
 		Open(sFileName);
 	}
 }
 
+PDFLDoc::MyImpl::~MyImpl()
+{
+	m_mObjects.clear();
+	DURING
+		if (m_pdDoc)  {
+			PDDocClose(m_pdDoc);
+		}
+		if (m_asFile)  {
+			ASFileClose(m_asFile);
+		}
+	HANDLER
+		ReportSPDFError(m_pOwner, "Error closing document", ERRORCODE);
+	END_HANDLER
+}
+
 bool
 PDFLDoc::MyImpl::Open(const std::string &sFileName)
 {
@@ -790,35 +1366,98 @@ PDFLDoc::MyImpl::Open(const std::string &sFileName)
 				bSuccess = true;
 			}
 		HANDLER
-			ReportSPDFError("Error opening file", ERRORCODE);
+			ReportSPDFError(m_pOwner, "Error opening file", ERRORCODE);
 		END_HANDLER
 	}
 	return bSuccess;
 }
 
+bool
+PDFLDoc::MyImpl::Open(const Reader::Ptr &pReader)
+{
+	bool bSuccess = false;
+
+	if (pReader)  {
+		if (!PDFLInitter::Get()->IsValid())  {
+			return false;
+		}
+
+		m_pRangeReader = boost::dynamic_pointer_cast<RangeReader>(pReader);
+		bool bRetry;
+		do  {
+			bRetry = false;
+			DURING
+				if (!m_asFile)  {
+					boost::shared_ptr<void> aspFile(
+						(ASPathName)new Reader::Ptr(pReader),
+						ReaderFileDisposePathName
+						);
+					if (ASFileSysOpenFile(GetReaderFileSys(), (ASPathName)aspFile.get(),
+						ASFILE_READ, &m_asFile) != 0)
+					{
+						m_asFile = NULL;
+					}
+				}
+				if (m_asFile)  {
+					m_pdDoc = PDDocOpenFromASFile(m_asFile, NULL, false);
+					if (m_pdDoc)  {
+						m_cdDoc = PDDocGetCosDoc(m_pdDoc);
+						bSuccess = true;
+					}
+				}
+			HANDLER
+				bRetry = WaitForBytes(ERRORCODE);
+				if (!bRetry)  {
+					ReportSPDFError(m_pOwner, "Error opening document from reader", ERRORCODE);
+				}
+			END_HANDLER
+		} while (bRetry);
+	}
+	return bSuccess;
+}
+
 bool
 PDFLDoc::MyImpl::GetObject(Object::ID nID, Object::Ptr &pObject)
 {
 	if (nID != Object::kInvalidID)  {
 		MyImpl::ObjectMap::const_iterator itFind = m_mObjects.find(nID);
 		if (itFind != m_mObjects.end())  {
+			PDFLIB_STAT_COUNT(kStatObjectCacheHits);
 			pObject = itFind->second;
 			return true;
 		}
-		DURING
-			CosObjWrapper coFind = CosDocGetObjByID(m_cdDoc, nID);
-			if (coFind)  {
-				m_mObjects[nID].reset(new PDFLObject(coFind, m_pOwner));
-				pObject = m_mObjects[nID];
-				return true;
-			}
-	HANDLER
-		ReportSPDFError("Error getting object by ID", ERRORCODE);
-	END_HANDLER
+		PDFLIB_STAT_COUNT(kStatObjectCacheMisses);
+		PDFLIB_STAT_TIME(kStatGetObject);
+		PDFLIB_TRACE_SPAN_ARG("GetObject", "object", nID);
+		bool bRetry;
+		do  {
+			bRetry = false;
+			DURING
+				CosObjWrapper coFind = CosDocGetObjByID(m_cdDoc, nID);
+				if (coFind)  {
+					m_mObjects[nID].reset(new PDFLObject(coFind, m_pOwner));
+					pObject = m_mObjects[nID];
+					m_pOwner->OnObjectLoaded(pObject);
+					return true;
+				}
+			HANDLER
+				bRetry = WaitForBytes(ERRORCODE);
+				if (!bRetry)  {
+					ReportSPDFError(m_pOwner, "Error getting object by ID", ERRORCODE, nID);
+				}
+			END_HANDLER
+		} while (bRetry);
 	}
 	return false;
 }
 
+bool
+PDFLDoc::MyImpl::WaitForBytes(ASErrorCode nError) const
+{
+	return nError == fileErrBytesNotReady && m_pRangeReader &&
+		m_pRangeReader->WaitForData();
+}
+
 
 PDFLDoc::PDFLDoc(const std::string &sFileName)
 : Document(sFileName)
@@ -834,16 +1473,64 @@ PDFLDoc::IsValid() const
 
 bool
 PDFLDoc::GetCatalog(Object::Ptr &pCatalog) const
+{
+	bool bRetry;
+	do  {
+		bRetry = false;
+		DURING
+			CosObjWrapper coRoot = CosDocGetRoot(m_pMyImpl->m_cdDoc);
+			if (coRoot)  {
+				CreateObject(coRoot, pCatalog);
+				return true;
+			}
+		HANDLER
+			bRetry = m_pMyImpl->WaitForBytes(ERRORCODE);
+			if (!bRetry)  {
+				ReportSPDFError(this, "Error getting Catalog", ERRORCODE);
+			}
+		END_HANDLER
+	} while (bRetry);
+	return false;
+}
+
+int
+PDFLDoc::GetPageCount() const
 {
 	DURING
-		CosObjWrapper coRoot = CosDocGetRoot(m_pMyImpl->m_cdDoc);
-		if (coRoot)  {
-			CreateObject(coRoot, pCatalog);
-			return true;
+		if (m_pMyImpl->m_pdDoc)  {
+			return PDDocGetNumPages(m_pMyImpl->m_pdDoc);
 		}
 	HANDLER
-		ReportSPDFError("Error getting Catalog", ERRORCODE);
+		ReportSPDFError(this, "Error getting page count", ERRORCODE);
 	END_HANDLER
+	return 0;
+}
+
+bool
+PDFLDoc::GetPage(int nIndex, Object::Ptr &pPage) const
+{
+	if (!m_pMyImpl->m_pdDoc || nIndex < 0)  { return false; }
+
+	bool bRetry;
+	do  {
+		bRetry = false;
+		DURING
+			if (nIndex < PDDocGetNumPages(m_pMyImpl->m_pdDoc))  {
+				PDPage pdPage = PDDocAcquirePage(m_pMyImpl->m_pdDoc, nIndex);
+				CosObjWrapper coPage = PDPageGetCosObj(pdPage);
+				PDPageRelease(pdPage);
+				CreateObject(coPage, pPage);
+				return pPage.get() != NULL;
+			}
+		HANDLER
+			// pages of a linearized file can be fetched while the rest of it
+			// is still arriving
+			bRetry = m_pMyImpl->WaitForBytes(ERRORCODE);
+			if (!bRetry)  {
+				ReportSPDFError(this, "Error getting page", ERRORCODE);
+			}
+		END_HANDLER
+	} while (bRetry);
 	return false;
 }
 
@@ -854,7 +1541,7 @@ PDFLDoc::GetVersion() const
 	DURING
 		PDDocGetVersion(m_pMyImpl->m_pdDoc, &nMajor, &nMinor);
 	HANDLER
-		ReportSPDFError("Error getting version", ERRORCODE);
+		ReportSPDFError(this, "Error getting version", ERRORCODE);
 	END_HANDLER
 	return PDFVersion(nMajor, nMinor);
 }
@@ -865,6 +1552,17 @@ PDFLDoc::GetObject(Object::ID nID, Object::Ptr &pObject) const
 	return m_pMyImpl->GetObject(nID, pObject);
 }
 
+bool
+PDFLDoc::GetErrorMessage(long nCode, std::string &sMessage) const
+{
+	char szError[256] = {0};
+	if (!ASGetErrorString((ASErrorCode)nCode, szError, sizeof(szError)))  {
+		return false;
+	}
+	sMessage = szError;
+	return true;
+}
+
 void
 PDFLDoc::CreateObject(CosObjWrapper coObject, Object::Ptr &pObject) const
 {
@@ -875,7 +1573,7 @@ PDFLDoc::CreateObject(CosObjWrapper coObject, Object::Ptr &pObject) const
 			pObject.reset(new PDFLObject(coObject, const_cast<PDFLDoc *>(this)));
 		}
 	HANDLER
-		ReportSPDFError("Error in CreateObject", ERRORCODE);
+		ReportSPDFError(this, "Error in CreateObject", ERRORCODE);
 	END_HANDLER
 }
 
@@ -891,6 +1589,12 @@ PDFLDoc::OpenFile(const std::string &sFileName)
 	return m_pMyImpl->Open(sFileName);
 }
 
+bool
+PDFLDoc::OpenReader(const Reader::Ptr &pReader)
+{
+	return m_pMyImpl->Open(pReader);
+}
+
 Document::Ptr
 PDFLDoc::ClonePtr() const
 {
@@ -52,6 +52,13 @@ namespace PDFLibWrapper  {
 		virtual int GetLength() const;
 
 		virtual bool GetKeys(NameSet &setKeys);
+		virtual bool GetReferences(std::vector<ID> &vIDs);
+		virtual bool GetEncoded(Stream &oValue);
+		virtual bool GetElements(int *pValues, size_t nMaxCount, size_t &nCount);
+		virtual bool GetElements(double *pValues, size_t nMaxCount, size_t &nCount);
+		virtual bool GetElements(Name *pValues, size_t nMaxCount, size_t &nCount);
+		virtual bool ExtractElements(std::vector<Value> &vValues);
+		virtual bool ExtractEntries(std::vector<Entry> &vEntries);
 		virtual bool HasKey(const Name &nmKey);
 		virtual bool HasKey(const char *szKey);
 		using Object::HasKey;
@@ -107,7 +114,11 @@ namespace PDFLibWrapper  {
 		virtual PDFVersion GetVersion() const;
 		virtual bool GetCatalog(Object::Ptr &pCatalog) const;
 
-		bool GetObject(Object::ID nID, Object::Ptr &pObject) const;
+		virtual int GetPageCount() const;
+		virtual bool GetPage(int nIndex, Object::Ptr &pPage) const;
+
+		virtual bool GetObject(Object::ID nID, Object::Ptr &pObject) const;
+		virtual bool GetErrorMessage(long nCode, std::string &sMessage) const;
 		void CreateObject(CosObjWrapper coObject, Object::Ptr &pObject) const;
 
 		struct MyImpl;
@@ -116,6 +127,7 @@ namespace PDFLibWrapper  {
 		virtual Document *clone() const;
 		virtual Document::Ptr ClonePtr() const;
 		virtual bool OpenFile(const std::string &sFileName);
+		virtual bool OpenReader(const Reader::Ptr &pReader);
 
 
 	private:
@@ -0,0 +1,220 @@
+/*
+ *  PDFLibAsync.cpp
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#include <algorithm>
+#include <deque>
+
+#include <boost/bind/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/thread.hpp>
+
+#include "PDFLibAsync.h"
+
+
+namespace  {
+
+	using namespace PDFLibWrapper;
+
+	typedef boost::mutex Mutex;
+	typedef boost::unique_lock<Mutex> Lock;
+
+	// tasks run per turn on the pool, so that one busy document doesn't
+	// hold a worker while others wait
+	const int kTasksPerTurn = 16;
+
+	Object::Ptr
+	GetCatalogTask(Document &rDoc)
+	{
+		Object::Ptr pCatalog;
+		rDoc.GetCatalog(pCatalog);
+		return pCatalog;
+	}
+
+	Object::Ptr
+	GetObjectTask(Document &rDoc, Object::ID nID)
+	{
+		Object::Ptr pObject;
+		rDoc.GetObject(nID, pObject);
+		return pObject;
+	}
+
+	Object::Ptr
+	GetPageTask(Document &rDoc, int nIndex)
+	{
+		Object::Ptr pPage;
+		rDoc.GetPage(nIndex, pPage);
+		return pPage;
+	}
+
+	AsyncDocument::StreamData
+	ReadStreamTask(Document &, const Object::Ptr &pObject)
+	{
+		Object::Stream pStream;
+		if (!pObject || pObject->GetType() != Object::kStream ||
+			!pObject->Get(pStream) || !pStream)
+		{
+			return AsyncDocument::StreamData();
+		}
+
+		boost::shared_ptr<std::vector<char> > pData(new std::vector<char>);
+		const size_t nChunk = 64 * 1024;
+		size_t nSize = 0;
+		std::streamsize nRead;
+		do  {
+			pData->resize(nSize + nChunk);
+			nRead = pStream->rdbuf()->sgetn(&(*pData)[nSize], nChunk);
+			nSize += (std::max)(nRead, (std::streamsize)0);
+		} while (nRead > 0);
+		pData->resize(nSize);
+		return pData;
+	}
+
+	template <class Source>
+	void
+	OpenTask(Source oSource, ThreadPool *pPool,
+		boost::shared_ptr<boost::promise<AsyncDocument::Ptr> > pPromise)
+	{
+		try  {
+			Document::Ptr pDoc = Document::Open(oSource);
+			AsyncDocument::Ptr pAsync;
+			if (pDoc)  {
+				pAsync.reset(new AsyncDocument(pDoc, pPool));
+			}
+			pPromise->set_value(pAsync);
+		} catch (...)  {
+			pPromise->set_exception(boost::current_exception());
+		}
+	}
+
+	template <class Source>
+	boost::shared_future<AsyncDocument::Ptr>
+	OpenAsync(const Source &oSource, ThreadPool *pPool)
+	{
+		if (!pPool)  {
+			pPool = &ThreadPool::GetDefault();
+		}
+		boost::shared_ptr<boost::promise<AsyncDocument::Ptr> > pPromise(
+			new boost::promise<AsyncDocument::Ptr>);
+		boost::shared_future<AsyncDocument::Ptr> futDoc(pPromise->get_future());
+		pPool->Submit(boost::bind(&OpenTask<Source>, oSource, pPool, pPromise));
+		return futDoc;
+	}
+
+}
+
+namespace PDFLibWrapper  {
+
+struct AsyncDocument::Impl : public boost::enable_shared_from_this<Impl>  {
+	Impl(const Document::Ptr &pDoc, ThreadPool *pPool)
+		: m_pDoc(pDoc), m_pPool(pPool), m_bScheduled(false)
+	{ }
+
+	void Post(const Task &fnTask);
+	void RunTurn();
+
+	Document::Ptr m_pDoc;
+	ThreadPool *m_pPool;
+
+	Mutex m_mtx;
+	std::deque<Task> m_dqTasks;
+	// a turn is queued on the pool or running
+	bool m_bScheduled;
+};
+
+void
+AsyncDocument::Impl::Post(const Task &fnTask)
+{
+	Lock lck(m_mtx);
+	m_dqTasks.push_back(fnTask);
+	if (!m_bScheduled)  {
+		m_bScheduled = true;
+		lck.unlock();
+		m_pPool->Submit(boost::bind(&Impl::RunTurn, shared_from_this()));
+	}
+}
+
+void
+AsyncDocument::Impl::RunTurn()
+{
+	Task fnTask;
+	for (int i=0; i<kTasksPerTurn; i++)  {
+		{
+			Lock lck(m_mtx);
+			if (m_dqTasks.empty())  {
+				m_bScheduled = false;
+				return;
+			}
+			fnTask.swap(m_dqTasks.front());
+			m_dqTasks.pop_front();
+		}
+		// tasks made by Call report their own exceptions; anything else
+		// goes to ThreadPool::Wait, after handing the rest of the queue on
+		try  {
+			fnTask(*m_pDoc);
+		} catch (...)  {
+			m_pPool->Submit(boost::bind(&Impl::RunTurn, shared_from_this()));
+			throw;
+		}
+	}
+	m_pPool->Submit(boost::bind(&Impl::RunTurn, shared_from_this()));
+}
+
+
+AsyncDocument::AsyncDocument(const Document::Ptr &pDoc, ThreadPool *pPool /*= NULL*/)
+: m_pImpl(new Impl(pDoc, pPool ? pPool : &ThreadPool::GetDefault()))
+{
+}
+
+boost::shared_future<AsyncDocument::Ptr>
+AsyncDocument::Open(const std::string &sFileName, ThreadPool *pPool /*= NULL*/)
+{
+	return OpenAsync(sFileName, pPool);
+}
+
+boost::shared_future<AsyncDocument::Ptr>
+AsyncDocument::Open(const Reader::Ptr &pReader, ThreadPool *pPool /*= NULL*/)
+{
+	return OpenAsync(pReader, pPool);
+}
+
+const Document::Ptr &
+AsyncDocument::GetDocument() const
+{
+	return m_pImpl->m_pDoc;
+}
+
+boost::shared_future<Object::Ptr>
+AsyncDocument::GetCatalog()
+{
+	return Call<Object::Ptr>(&GetCatalogTask);
+}
+
+boost::shared_future<Object::Ptr>
+AsyncDocument::GetObject(Object::ID nID)
+{
+	return Call<Object::Ptr>(boost::bind(&GetObjectTask, boost::placeholders::_1, nID));
+}
+
+boost::shared_future<Object::Ptr>
+AsyncDocument::GetPage(int nIndex)
+{
+	return Call<Object::Ptr>(boost::bind(&GetPageTask, boost::placeholders::_1, nIndex));
+}
+
+boost::shared_future<AsyncDocument::StreamData>
+AsyncDocument::ReadStream(const Object::Ptr &pStream)
+{
+	return Call<StreamData>(boost::bind(&ReadStreamTask, boost::placeholders::_1, pStream));
+}
+
+void
+AsyncDocument::Post(const Task &fnTask)
+{
+	m_pImpl->Post(fnTask);
+}
+
+}
@@ -0,0 +1,93 @@
+/*
+ *  PDFLibAsync.h
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#ifndef APAGO_PDFLibAsync_h__
+#define APAGO_PDFLibAsync_h__
+
+#include <vector>
+
+#include <boost/exception_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/future.hpp>
+
+#include "PDFLibWrapper.h"
+#include "PDFLibParallel.h"
+
+namespace PDFLibWrapper  {
+
+	namespace detail  {
+		template <class Result>
+		struct PromiseTask  {
+			typedef boost::function<Result (Document &)> Function;
+
+			PromiseTask(const Function &fn, const boost::shared_ptr<boost::promise<Result> > &pPromise)
+				: m_fn(fn), m_pPromise(pPromise)
+			{ }
+			void operator()(Document &rDoc)  {
+				try  {
+					m_pPromise->set_value(m_fn(rDoc));
+				} catch (...)  {
+					m_pPromise->set_exception(boost::current_exception());
+				}
+			}
+			Function m_fn;
+			boost::shared_ptr<boost::promise<Result> > m_pPromise;
+		};
+	}
+
+	// A Document whose requests run on a thread pool.  Requests to one
+	// document are queued and run one at a time in order, so the Document
+	// never sees two threads at once, while many AsyncDocuments sharing a
+	// pool keep their reads and parsing in flight together.
+	//
+	// Objects handed out still belong to the document:  use them in tasks
+	// passed to Post or Call, or once all earlier requests have completed.
+	// Waiting on a future from inside a pool task can deadlock the pool.
+	class AsyncDocument : private boost::noncopyable  {
+	public:
+		typedef boost::shared_ptr<AsyncDocument> Ptr;
+		typedef boost::function<void (Document &rDoc)> Task;
+		typedef boost::shared_ptr<const std::vector<char> > StreamData;
+
+		explicit AsyncDocument(const Document::Ptr &pDoc, ThreadPool *pPool = NULL);
+
+		// an empty Ptr if the document can't be opened
+		static boost::shared_future<Ptr> Open(const std::string &sFileName,
+			ThreadPool *pPool = NULL);
+		static boost::shared_future<Ptr> Open(const Reader::Ptr &pReader,
+			ThreadPool *pPool = NULL);
+
+		const Document::Ptr &GetDocument() const;
+
+		// empty Ptrs for objects that don't exist
+		boost::shared_future<Object::Ptr> GetCatalog();
+		boost::shared_future<Object::Ptr> GetObject(Object::ID nID);
+		boost::shared_future<Object::Ptr> GetPage(int nIndex);
+		// the decoded data of a stream object
+		boost::shared_future<StreamData> ReadStream(const Object::Ptr &pStream);
+
+		void Post(const Task &fnTask);
+
+		template <class Result>
+		boost::shared_future<Result> Call(const boost::function<Result (Document &)> &fn)  {
+			boost::shared_ptr<boost::promise<Result> > pPromise(new boost::promise<Result>);
+			boost::shared_future<Result> futResult(pPromise->get_future());
+			Post(detail::PromiseTask<Result>(fn, pPromise));
+			return futResult;
+		}
+
+		struct Impl;
+
+	private:
+		boost::shared_ptr<Impl> m_pImpl;
+	};
+
+}
+
+#endif // APAGO_PDFLibAsync_h__
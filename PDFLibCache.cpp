@@ -0,0 +1,279 @@
+/*
+ *  PDFLibCache.cpp
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#include <list>
+#include <map>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+#include <boost/thread.hpp>
+
+#include "PDFLibCache.h"
+
+
+namespace  {
+
+	using namespace PDFLibWrapper;
+
+	typedef boost::mutex Mutex;
+	typedef boost::unique_lock<Mutex> Lock;
+
+	struct FileVersion  {
+		FileVersion() : m_nModified(0), m_nSize(0)  { }
+
+		bool operator==(const FileVersion &rOther) const  {
+			return m_nModified == rOther.m_nModified && m_nSize == rOther.m_nSize;
+		}
+		bool operator!=(const FileVersion &rOther) const  { return !(*this == rOther); }
+
+		boost::int64_t m_nModified;
+		boost::int64_t m_nSize;
+	};
+
+	// the modification time in ns, as a file rewritten within the same
+	// second must not look unchanged
+	bool
+	GetFileVersion(const std::string &sFileName, FileVersion &rVersion)
+	{
+#ifdef _WIN32
+		WIN32_FILE_ATTRIBUTE_DATA oData;
+		if (!GetFileAttributesExA(sFileName.c_str(), GetFileExInfoStandard, &oData))  {
+			return false;
+		}
+		// in units of 100 ns
+		rVersion.m_nModified = ((boost::int64_t)oData.ftLastWriteTime.dwHighDateTime << 32 |
+			oData.ftLastWriteTime.dwLowDateTime) * 100;
+		rVersion.m_nSize = (boost::int64_t)oData.nFileSizeHigh << 32 | oData.nFileSizeLow;
+#else
+		struct stat oStat;
+		if (stat(sFileName.c_str(), &oStat) != 0)  {
+			return false;
+		}
+#ifdef __APPLE__
+		const struct timespec &tsModified = oStat.st_mtimespec;
+#else
+		const struct timespec &tsModified = oStat.st_mtim;
+#endif
+		rVersion.m_nModified = (boost::int64_t)tsModified.tv_sec * 1000000000 + tsModified.tv_nsec;
+		rVersion.m_nSize = oStat.st_size;
+#endif
+		return true;
+	}
+
+	struct Slot  {
+		std::string m_sFileName;
+		FileVersion m_oVersion;
+		Document::Ptr m_pDoc;
+	};
+	// most recently used first
+	typedef std::list<Slot> SlotList;
+
+}
+
+namespace PDFLibWrapper  {
+
+struct DocumentCache::Impl  {
+	Impl(size_t nMaxDocuments, boost::uint64_t nMaxMemory)
+		: m_nMaxDocuments(nMaxDocuments), m_nMaxMemory(nMaxMemory), m_nMemory(0),
+		  m_nHits(0), m_nMisses(0), m_nEvictions(0), m_nStaleRemovals(0)
+	{ }
+
+	typedef std::multimap<std::string, SlotList::iterator> SlotIndex;
+
+	// the cache holds the only reference
+	static bool IsIdle(const Slot &rSlot)  { return rSlot.m_pDoc.use_count() == 1; }
+
+	void Remove(SlotList::iterator itSlot);
+	void RemoveStale(const std::string &sFileName, const FileVersion &oVersion);
+	void Trim();
+
+	mutable Mutex m_mtx;
+	SlotList m_lstSlots;
+	SlotIndex m_mIndex;
+	size_t m_nMaxDocuments;
+	boost::uint64_t m_nMaxMemory;
+	boost::uint64_t m_nMemory;
+	unsigned long m_nHits;
+	unsigned long m_nMisses;
+	unsigned long m_nEvictions;
+	unsigned long m_nStaleRemovals;
+};
+
+void
+DocumentCache::Impl::Remove(SlotList::iterator itSlot)
+{
+	std::pair<SlotIndex::iterator, SlotIndex::iterator> prRange =
+		m_mIndex.equal_range(itSlot->m_sFileName);
+	for (SlotIndex::iterator it = prRange.first; it != prRange.second; ++it)  {
+		if (it->second == itSlot)  {
+			m_mIndex.erase(it);
+			break;
+		}
+	}
+	m_nMemory -= itSlot->m_oVersion.m_nSize;
+	m_lstSlots.erase(itSlot);
+}
+
+void
+DocumentCache::Impl::RemoveStale(const std::string &sFileName, const FileVersion &oVersion)
+{
+	// callers still holding an old instance keep it; it just isn't reused
+	std::pair<SlotIndex::iterator, SlotIndex::iterator> prRange =
+		m_mIndex.equal_range(sFileName);
+	std::vector<SlotList::iterator> vStale;
+	for (SlotIndex::iterator it = prRange.first; it != prRange.second; ++it)  {
+		if (it->second->m_oVersion != oVersion)  {
+			vStale.push_back(it->second);
+		}
+	}
+	for (size_t i=0; i<vStale.size(); i++)  {
+		Remove(vStale[i]);
+	}
+	m_nStaleRemovals += vStale.size();
+}
+
+void
+DocumentCache::Impl::Trim()
+{
+	SlotList::iterator itSlot = m_lstSlots.end();
+	while (itSlot != m_lstSlots.begin() &&
+		(m_lstSlots.size() > m_nMaxDocuments || m_nMemory > m_nMaxMemory))
+	{
+		--itSlot;
+		if (IsIdle(*itSlot))  {
+			SlotList::iterator itRemove = itSlot++;
+			Remove(itRemove);
+			++m_nEvictions;
+		}
+	}
+}
+
+
+DocumentCache::DocumentCache(size_t nMaxDocuments /*= 64*/,
+	boost::uint64_t nMaxMemory /*= 1024 * 1024 * 1024*/)
+: m_pImpl(new Impl(nMaxDocuments, nMaxMemory))
+{
+}
+
+DocumentCache::~DocumentCache()
+{
+}
+
+Document::Ptr
+DocumentCache::Open(const std::string &sFileName)
+{
+	FileVersion oVersion;
+	if (!GetFileVersion(sFileName, oVersion))  {
+		return Document::Ptr();
+	}
+
+	{
+		Lock lck(m_pImpl->m_mtx);
+		m_pImpl->RemoveStale(sFileName, oVersion);
+		std::pair<Impl::SlotIndex::iterator, Impl::SlotIndex::iterator> prRange =
+			m_pImpl->m_mIndex.equal_range(sFileName);
+		for (Impl::SlotIndex::iterator it = prRange.first; it != prRange.second; ++it)  {
+			if (Impl::IsIdle(*it->second))  {
+				m_pImpl->m_lstSlots.splice(m_pImpl->m_lstSlots.begin(), m_pImpl->m_lstSlots,
+					it->second);
+				++m_pImpl->m_nHits;
+				return it->second->m_pDoc;
+			}
+		}
+		++m_pImpl->m_nMisses;
+	}
+
+	// opening takes long, so other callers may use the cache meanwhile
+	Document::Ptr pDoc = Document::Open(sFileName);
+	if (!pDoc)  {
+		return pDoc;
+	}
+
+	Lock lck(m_pImpl->m_mtx);
+	Slot oSlot;
+	oSlot.m_sFileName = sFileName;
+	oSlot.m_oVersion = oVersion;
+	oSlot.m_pDoc = pDoc;
+	m_pImpl->m_lstSlots.push_front(oSlot);
+	m_pImpl->m_mIndex.insert(std::make_pair(sFileName, m_pImpl->m_lstSlots.begin()));
+	m_pImpl->m_nMemory += oVersion.m_nSize;
+	m_pImpl->Trim();
+	return pDoc;
+}
+
+void
+DocumentCache::SetLimits(size_t nMaxDocuments, boost::uint64_t nMaxMemory)
+{
+	Lock lck(m_pImpl->m_mtx);
+	m_pImpl->m_nMaxDocuments = nMaxDocuments;
+	m_pImpl->m_nMaxMemory = nMaxMemory;
+	m_pImpl->Trim();
+}
+
+void
+DocumentCache::Clear()
+{
+	Lock lck(m_pImpl->m_mtx);
+	SlotList::iterator itSlot = m_pImpl->m_lstSlots.begin();
+	while (itSlot != m_pImpl->m_lstSlots.end())  {
+		SlotList::iterator itRemove = itSlot++;
+		if (Impl::IsIdle(*itRemove))  {
+			m_pImpl->Remove(itRemove);
+			++m_pImpl->m_nEvictions;
+		}
+	}
+}
+
+size_t
+DocumentCache::GetDocumentCount() const
+{
+	Lock lck(m_pImpl->m_mtx);
+	return m_pImpl->m_lstSlots.size();
+}
+
+boost::uint64_t
+DocumentCache::GetMemoryUsage() const
+{
+	Lock lck(m_pImpl->m_mtx);
+	return m_pImpl->m_nMemory;
+}
+
+unsigned long
+DocumentCache::GetHits() const
+{
+	Lock lck(m_pImpl->m_mtx);
+	return m_pImpl->m_nHits;
+}
+
+unsigned long
+DocumentCache::GetMisses() const
+{
+	Lock lck(m_pImpl->m_mtx);
+	return m_pImpl->m_nMisses;
+}
+
+unsigned long
+DocumentCache::GetEvictions() const
+{
+	Lock lck(m_pImpl->m_mtx);
+	return m_pImpl->m_nEvictions;
+}
+
+unsigned long
+DocumentCache::GetStaleRemovals() const
+{
+	Lock lck(m_pImpl->m_mtx);
+	return m_pImpl->m_nStaleRemovals;
+}
+
+}
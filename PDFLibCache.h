@@ -0,0 +1,57 @@
+/*
+ *  PDFLibCache.h
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#ifndef APAGO_PDFLibCache_h__
+#define APAGO_PDFLibCache_h__
+
+#include <string>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "PDFLibWrapper.h"
+
+namespace PDFLibWrapper  {
+
+	// Open documents kept for reuse, keyed by path, modification time and
+	// size.  A Document is never shared between callers:  Open hands out
+	// one that nobody else holds, or opens another instance of the file.
+	// Instances nobody holds are evicted least recently used first once
+	// there are too many of them or their estimated memory (the file
+	// size) is over the limit.  Thread-safe.
+	class DocumentCache : private boost::noncopyable  {
+	public:
+		explicit DocumentCache(size_t nMaxDocuments = 64,
+			boost::uint64_t nMaxMemory = 1024 * 1024 * 1024);
+		~DocumentCache();
+
+		// empty if the file can't be opened
+		Document::Ptr Open(const std::string &sFileName);
+
+		void SetLimits(size_t nMaxDocuments, boost::uint64_t nMaxMemory);
+		// drops every document nobody holds
+		void Clear();
+
+		size_t GetDocumentCount() const;
+		boost::uint64_t GetMemoryUsage() const;
+		unsigned long GetHits() const;
+		unsigned long GetMisses() const;
+		// dropped for the limits or by Clear
+		unsigned long GetEvictions() const;
+		// dropped because the file changed since they were opened
+		unsigned long GetStaleRemovals() const;
+
+		struct Impl;
+
+	private:
+		boost::shared_ptr<Impl> m_pImpl;
+	};
+
+}
+
+#endif // APAGO_PDFLibCache_h__
@@ -0,0 +1,770 @@
+/*
+ *  PDFLibContent.cpp
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include <map>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "PDFLibContent.h"
+#include "PDFLibTrace.h"
+
+
+namespace  {
+
+	enum CharClass  { kRegular = 0, kWhitespace = 1, kDelimiter = 2 };
+
+	struct CharClassTable  {
+		CharClassTable()  {
+			memset(m_aClasses, kRegular, sizeof(m_aClasses));
+			const char *szWhitespace = " \t\r\n\f";
+			while (*szWhitespace)  {
+				m_aClasses[(unsigned char)*szWhitespace++] = kWhitespace;
+			}
+			m_aClasses[0] = kWhitespace;
+			const char *szDelimiters = "()<>[]{}/%";
+			while (*szDelimiters)  {
+				m_aClasses[(unsigned char)*szDelimiters++] = kDelimiter;
+			}
+		}
+		unsigned char m_aClasses[256];
+	};
+	const CharClassTable g_oCharClasses;
+
+	inline bool IsWhitespace(int c)  {
+		return c >= 0 && g_oCharClasses.m_aClasses[c] == kWhitespace;
+	}
+	inline bool IsRegular(int c)  {
+		return c >= 0 && g_oCharClasses.m_aClasses[c] == kRegular;
+	}
+
+	inline int HexValue(char c)  {
+		if (c >= '0' && c <= '9')  { return c - '0'; }
+		if (c >= 'a' && c <= 'f')  { return c - 'a' + 10; }
+		if (c >= 'A' && c <= 'F')  { return c - 'A' + 10; }
+		return -1;
+	}
+
+	PDFLibWrapper::ContentToken::Type
+	ClassifyKeyword(const char *pData, size_t nLength)
+	{
+		using PDFLibWrapper::ContentToken;
+
+		const char *pCurrent = pData, *pEnd = pData + nLength;
+		if (pCurrent != pEnd && (*pCurrent == '+' || *pCurrent == '-'))  {
+			++pCurrent;
+		}
+		bool bDigits = false, bPoint = false;
+		while (pCurrent != pEnd)  {
+			if (*pCurrent >= '0' && *pCurrent <= '9')  {
+				bDigits = true;
+			} else if (*pCurrent == '.' && !bPoint)  {
+				bPoint = true;
+			} else  {
+				break;
+			}
+			++pCurrent;
+		}
+		if (pCurrent == pEnd && bDigits)  {
+			return bPoint ? ContentToken::kReal : ContentToken::kInteger;
+		}
+		if ((nLength == 4 && !memcmp(pData, "true", 4)) ||
+			(nLength == 5 && !memcmp(pData, "false", 5)))
+		{
+			return ContentToken::kBoolean;
+		}
+		if (nLength == 4 && !memcmp(pData, "null", 4))  {
+			return ContentToken::kNull;
+		}
+		return ContentToken::kOperator;
+	}
+
+}
+
+namespace PDFLibWrapper  {
+
+bool
+ContentToken::Is(const char *szText) const
+{
+	return strlen(szText) == m_nLength && !memcmp(m_pData, szText, m_nLength);
+}
+
+bool
+ContentToken::Get(bool &bValue) const
+{
+	if (m_eType == kBoolean)  {
+		bValue = m_nLength == 4;
+		return true;
+	}
+	return false;
+}
+
+bool
+ContentToken::Get(int &nValue) const
+{
+	if (m_eType != kInteger)  {
+		return false;
+	}
+	const char *pCurrent = m_pData, *pEnd = m_pData + m_nLength;
+	bool bNegative = *pCurrent == '-';
+	if (*pCurrent == '-' || *pCurrent == '+')  {
+		++pCurrent;
+	}
+	int nTemp = 0;
+	while (pCurrent != pEnd)  {
+		nTemp = nTemp * 10 + (*pCurrent++ - '0');
+	}
+	nValue = bNegative ? -nTemp : nTemp;
+	return true;
+}
+
+bool
+ContentToken::Get(double &dValue) const
+{
+	if (!IsNumber())  {
+		return false;
+	}
+	const char *pCurrent = m_pData, *pEnd = m_pData + m_nLength;
+	bool bNegative = *pCurrent == '-';
+	if (*pCurrent == '-' || *pCurrent == '+')  {
+		++pCurrent;
+	}
+	double dTemp = 0, dScale = 1;
+	bool bFraction = false;
+	while (pCurrent != pEnd)  {
+		if (*pCurrent == '.')  {
+			bFraction = true;
+		} else  {
+			dTemp = dTemp * 10 + (*pCurrent - '0');
+			if (bFraction)  {
+				dScale *= 10;
+			}
+		}
+		++pCurrent;
+	}
+	dValue = (bNegative ? -dTemp : dTemp) / dScale;
+	return true;
+}
+
+bool
+ContentToken::Get(Name &rValue) const
+{
+	if (m_eType != kName)  {
+		return false;
+	}
+	if (!memchr(m_pData, '#', m_nLength))  {
+		rValue.Set(std::string(m_pData, m_nLength));
+		return true;
+	}
+	std::string sTemp;
+	sTemp.reserve(m_nLength);
+	for (size_t i=0; i<m_nLength; i++)  {
+		int nHigh, nLow;
+		if (m_pData[i] == '#' && i + 2 < m_nLength &&
+			(nHigh = HexValue(m_pData[i + 1])) >= 0 &&
+			(nLow = HexValue(m_pData[i + 2])) >= 0)
+		{
+			sTemp += (char)(nHigh * 16 + nLow);
+			i += 2;
+		} else  {
+			sTemp += m_pData[i];
+		}
+	}
+	rValue.Set(sTemp);
+	return true;
+}
+
+bool
+ContentToken::Get(std::string &sValue) const
+{
+	sValue.clear();
+	if (m_eType == kHexString)  {
+		sValue.reserve(m_nLength / 2);
+		int nHigh = -1, nDigit;
+		for (size_t i=0; i<m_nLength; i++)  {
+			if ((nDigit = HexValue(m_pData[i])) < 0)  {
+				continue;
+			}
+			if (nHigh < 0)  {
+				nHigh = nDigit;
+			} else  {
+				sValue += (char)(nHigh * 16 + nDigit);
+				nHigh = -1;
+			}
+		}
+		if (nHigh >= 0)  {
+			sValue += (char)(nHigh * 16);
+		}
+		return true;
+	}
+	if (m_eType != kString)  {
+		return false;
+	}
+
+	sValue.reserve(m_nLength);
+	const char *pCurrent = m_pData, *pEnd = m_pData + m_nLength;
+	while (pCurrent != pEnd)  {
+		char c = *pCurrent++;
+		if (c == '\r')  {
+			// end-of-line sequences read as a single LF
+			if (pCurrent != pEnd && *pCurrent == '\n')  {
+				++pCurrent;
+			}
+			sValue += '\n';
+			continue;
+		}
+		if (c != '\\' || pCurrent == pEnd)  {
+			sValue += c;
+			continue;
+		}
+		c = *pCurrent++;
+		switch (c)  {
+			case 'n':  sValue += '\n';  break;
+			case 'r':  sValue += '\r';  break;
+			case 't':  sValue += '\t';  break;
+			case 'b':  sValue += '\b';  break;
+			case 'f':  sValue += '\f';  break;
+			case '\r':
+				if (pCurrent != pEnd && *pCurrent == '\n')  {
+					++pCurrent;
+				}
+				break;
+			case '\n':
+				break;
+			default:
+				if (c >= '0' && c <= '7')  {
+					int nCode = c - '0';
+					for (int i=0; i<2 && pCurrent != pEnd &&
+						*pCurrent >= '0' && *pCurrent <= '7'; i++)
+					{
+						nCode = nCode * 8 + (*pCurrent++ - '0');
+					}
+					sValue += (char)nCode;
+				} else  {
+					sValue += c;
+				}
+				break;
+		}
+	}
+	return true;
+}
+
+
+ContentTokenizer::ContentTokenizer(size_t nBufferSize /*= 64 * 1024*/)
+: m_vBuffer((std::max)(nBufferSize, (size_t)16))
+{
+	Reset();
+}
+
+void
+ContentTokenizer::Reset()
+{
+	m_nBase = m_nKeep = m_nPos = m_nEnd = 0;
+	m_pData = &m_vBuffer[0];
+	m_vContents.clear();
+	m_nNextContent = 0;
+	m_pStream.reset();
+	m_bInlineImageData = false;
+}
+
+bool
+ContentTokenizer::Open(const Object::Ptr &pContents)
+{
+	Reset();
+	if (!pContents)  {
+		return false;
+	}
+
+	Object::Ptr pTarget = pContents;
+	if (pContents->GetType() == Object::kDict)  {
+		if (!pContents->Get(pTarget, "Contents"))  {
+			// a page without contents is empty, not an error
+			return true;
+		}
+	}
+	switch (pTarget->GetType())  {
+		case Object::kStream:
+			m_vContents.push_back(pTarget);
+			break;
+		case Object::kArray:
+			{
+				Object::Ptr pElement;
+				int nLength = pTarget->GetLength();
+				for (int i=0; i<nLength; i++)  {
+					if (pTarget->Get(pElement, i) && pElement->GetType() == Object::kStream)  {
+						m_vContents.push_back(pElement);
+					}
+				}
+			}
+			break;
+		default:
+			return false;
+	}
+	return true;
+}
+
+bool
+ContentTokenizer::Open(const Object::Stream &pStream)
+{
+	Reset();
+	m_pStream = pStream;
+	return m_pStream.get() != NULL;
+}
+
+bool
+ContentTokenizer::Open(const char *pData, size_t nLength)
+{
+	Reset();
+	m_pData = pData;
+	m_nEnd = nLength;
+	return pData != NULL;
+}
+
+bool
+ContentTokenizer::OpenNextStream()
+{
+	m_pStream.reset();
+	while (m_nNextContent < m_vContents.size())  {
+		Object::Stream pStream;
+		if (m_vContents[m_nNextContent++]->Get(pStream) && pStream)  {
+			m_pStream = pStream;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Makes the byte at nPos available, moving the kept part of the buffer to
+// the front or growing the buffer when there is no room left.
+bool
+ContentTokenizer::Fill(size_t nPos)
+{
+	while (nPos >= m_nEnd)  {
+		if (!m_pStream && !OpenNextStream())  {
+			return false;
+		}
+		if (m_nEnd - m_nBase == m_vBuffer.size())  {
+			size_t nShift = m_nKeep - m_nBase;
+			if (nShift > 0)  {
+				memmove(&m_vBuffer[0], &m_vBuffer[nShift], m_nEnd - m_nKeep);
+				m_nBase = m_nKeep;
+			} else  {
+				m_vBuffer.resize(m_vBuffer.size() * 2);
+			}
+			m_pData = &m_vBuffer[0];
+		}
+		std::streamsize nRead = m_pStream->rdbuf()->sgetn(
+			&m_vBuffer[m_nEnd - m_nBase], m_vBuffer.size() - (m_nEnd - m_nBase));
+		if (nRead > 0)  {
+			m_nEnd += nRead;
+		} else  {
+			// the streams of a /Contents array are separated by whitespace
+			m_vBuffer[m_nEnd - m_nBase] = '\n';
+			++m_nEnd;
+			m_pStream.reset();
+		}
+	}
+	return true;
+}
+
+void
+ContentTokenizer::SkipWhitespace()
+{
+	int c;
+	while ((c = Peek(m_nPos)) >= 0)  {
+		if (c == '%')  {
+			while ((c = Peek(++m_nPos)) >= 0 && c != '\r' && c != '\n')  {
+			}
+		} else if (IsWhitespace(c))  {
+			++m_nPos;
+		} else  {
+			break;
+		}
+	}
+}
+
+bool
+ContentTokenizer::ScanInlineImageData(ContentToken &rToken)
+{
+	m_bInlineImageData = false;
+
+	// a single whitespace character follows ID
+	if (IsWhitespace(Peek(m_nPos)))  {
+		++m_nPos;
+	}
+	rToken.m_eType = ContentToken::kInlineImageData;
+	rToken.m_nOffset = m_nPos;
+
+	// the data ends at "EI" surrounded by whitespace (or the end of the content)
+	int c;
+	size_t nScan = m_nPos;
+	while ((c = Peek(nScan)) >= 0)  {
+		if (IsWhitespace(c) && Peek(nScan + 1) == 'E' && Peek(nScan + 2) == 'I')  {
+			int nAfter = Peek(nScan + 3);
+			if (nAfter < 0 || !IsRegular(nAfter))  {
+				break;
+			}
+		}
+		++nScan;
+	}
+	rToken.m_nLength = nScan - rToken.m_nOffset;
+	m_nPos = nScan;
+	return true;
+}
+
+bool
+ContentTokenizer::Scan(ContentToken &rToken)
+{
+	if (m_bInlineImageData)  {
+		return ScanInlineImageData(rToken);
+	}
+
+	SkipWhitespace();
+	int c = Peek(m_nPos);
+	if (c < 0)  {
+		return false;
+	}
+
+	rToken.m_nOffset = m_nPos;
+	rToken.m_nLength = 1;
+	switch (c)  {
+		case '/':
+			rToken.m_eType = ContentToken::kName;
+			rToken.m_nOffset = ++m_nPos;
+			while (IsRegular(Peek(m_nPos)))  {
+				++m_nPos;
+			}
+			rToken.m_nLength = m_nPos - rToken.m_nOffset;
+			break;
+		case '(':
+			{
+				rToken.m_eType = ContentToken::kString;
+				rToken.m_nOffset = ++m_nPos;
+				int nDepth = 1;
+				while ((c = Peek(m_nPos)) >= 0)  {
+					if (c == '\\')  {
+						++m_nPos;
+					} else if (c == '(')  {
+						++nDepth;
+					} else if (c == ')' && --nDepth == 0)  {
+						break;
+					}
+					++m_nPos;
+				}
+				rToken.m_nLength = (std::min)(m_nPos, m_nEnd) - rToken.m_nOffset;
+				if (c >= 0)  {
+					++m_nPos;
+				}
+			}
+			break;
+		case '<':
+			if (Peek(m_nPos + 1) == '<')  {
+				rToken.m_eType = ContentToken::kDictBegin;
+				rToken.m_nLength = 2;
+				m_nPos += 2;
+			} else  {
+				rToken.m_eType = ContentToken::kHexString;
+				rToken.m_nOffset = ++m_nPos;
+				while ((c = Peek(m_nPos)) >= 0 && c != '>')  {
+					++m_nPos;
+				}
+				rToken.m_nLength = m_nPos - rToken.m_nOffset;
+				if (c >= 0)  {
+					++m_nPos;
+				}
+			}
+			break;
+		case '>':
+			if (Peek(m_nPos + 1) == '>')  {
+				rToken.m_eType = ContentToken::kDictEnd;
+				rToken.m_nLength = 2;
+				m_nPos += 2;
+			} else  {
+				rToken.m_eType = ContentToken::kOperator;
+				++m_nPos;
+			}
+			break;
+		case '[':
+			rToken.m_eType = ContentToken::kArrayBegin;
+			++m_nPos;
+			break;
+		case ']':
+			rToken.m_eType = ContentToken::kArrayEnd;
+			++m_nPos;
+			break;
+		default:
+			if (!IsRegular(c))  {
+				// stray delimiter
+				rToken.m_eType = ContentToken::kOperator;
+				++m_nPos;
+				break;
+			}
+			while (IsRegular(Peek(++m_nPos)))  {
+			}
+			rToken.m_nLength = m_nPos - rToken.m_nOffset;
+			Resolve(rToken);
+			rToken.m_eType = ClassifyKeyword(rToken.m_pData, rToken.m_nLength);
+			m_bInlineImageData = rToken.m_eType == ContentToken::kOperator &&
+				rToken.m_nLength == 2 && rToken.m_pData[0] == 'I' && rToken.m_pData[1] == 'D';
+			break;
+	}
+	return true;
+}
+
+bool
+ContentTokenizer::Next(ContentToken &rToken)
+{
+	m_nKeep = m_nPos;
+	if (!Scan(rToken))  {
+		return false;
+	}
+	Resolve(rToken);
+	return true;
+}
+
+bool
+ContentTokenizer::Next(ContentOperation &rOperation)
+{
+	rOperation.m_vOperands.clear();
+	m_nKeep = m_nPos;
+
+	ContentToken tokCurrent;
+	while (Scan(tokCurrent))  {
+		if (tokCurrent.m_eType == ContentToken::kOperator)  {
+			rOperation.m_tokOperator = tokCurrent;
+			Resolve(rOperation.m_tokOperator);
+			std::vector<ContentToken>::iterator itOperand = rOperation.m_vOperands.begin(),
+				itEndOperands = rOperation.m_vOperands.end();
+			while (itOperand != itEndOperands)  {
+				Resolve(*itOperand);
+				++itOperand;
+			}
+			return true;
+		}
+		if (rOperation.m_vOperands.empty())  {
+			m_nKeep = tokCurrent.m_nOffset;
+		}
+		rOperation.m_vOperands.push_back(tokCurrent);
+	}
+
+	// operands without an operator at the end of the content are dropped
+	rOperation.m_vOperands.clear();
+	return false;
+}
+
+
+ParsedContent::Ptr
+ParsedContent::Parse(const Object::Ptr &pContents)
+{
+	PDFLIB_TRACE_SPAN("ParsedContent::Parse", "content");
+	Object::Stream pStream;
+	if (!pContents || pContents->GetType() != Object::kStream ||
+		!pContents->Get(pStream) || !pStream)
+	{
+		return Ptr();
+	}
+
+	boost::shared_ptr<ParsedContent> pNew(new ParsedContent);
+	std::vector<char> &vData = pNew->m_vData;
+	const size_t nChunk = 64 * 1024;
+	size_t nSize = 0;
+	std::streamsize nRead;
+	do  {
+		vData.resize(nSize + nChunk);
+		nRead = pStream->rdbuf()->sgetn(&vData[nSize], nChunk);
+		nSize += (std::max)(nRead, (std::streamsize)0);
+	} while (nRead > 0);
+	vData.resize(nSize);
+	std::vector<char>(vData).swap(vData);
+
+	if (!vData.empty())  {
+		ContentTokenizer oTokenizer;
+		ContentOperation oOperation;
+		oTokenizer.Open(&vData[0], vData.size());
+		while (oTokenizer.Next(oOperation))  {
+			size_t nFirst = pNew->m_vTokens.size();
+			pNew->m_vTokens.insert(pNew->m_vTokens.end(),
+				oOperation.m_vOperands.begin(), oOperation.m_vOperands.end());
+			pNew->m_vOperations.push_back(
+				OperationRange(nFirst, pNew->m_vTokens.size()));
+			pNew->m_vTokens.push_back(oOperation.m_tokOperator);
+		}
+	}
+
+	return pNew;
+}
+
+void
+ParsedContent::GetOperation(size_t nIndex, ContentOperation &rOperation) const
+{
+	const OperationRange &rRange = m_vOperations[nIndex];
+	rOperation.m_vOperands.assign(m_vTokens.begin() + rRange.first,
+		m_vTokens.begin() + rRange.second);
+	rOperation.m_tokOperator = m_vTokens[rRange.second];
+}
+
+size_t
+ParsedContent::GetMemoryUsage() const
+{
+	return sizeof(*this) + m_vData.capacity() +
+		m_vTokens.capacity() * sizeof(ContentToken) +
+		m_vOperations.capacity() * sizeof(OperationRange);
+}
+
+
+struct ContentCache::Impl  {
+	struct Entry  {
+		Entry() : m_nSize(0), m_bLoading(true)  { }
+		ParsedContent::Ptr m_pParsed;
+		size_t m_nSize;
+		bool m_bLoading;
+		std::list<Object::ID>::iterator m_itRecent;
+	};
+	typedef std::map<Object::ID, Entry> EntryMap;
+
+	Impl(size_t nBudget)
+		: m_nBudget(nBudget), m_nUsage(0), m_nHits(0), m_nMisses(0)
+	{ }
+
+	void Trim();
+
+	mutable boost::mutex m_mtx;
+	boost::condition_variable m_cvLoaded;
+	EntryMap m_mEntries;
+	// most recently used first
+	std::list<Object::ID> m_lstRecent;
+	size_t m_nBudget;
+	size_t m_nUsage;
+	unsigned long m_nHits;
+	unsigned long m_nMisses;
+};
+
+void
+ContentCache::Impl::Trim()
+{
+	std::list<Object::ID>::iterator itRecent = m_lstRecent.end();
+	while (m_nUsage > m_nBudget && itRecent != m_lstRecent.begin())  {
+		--itRecent;
+		EntryMap::iterator itEntry = m_mEntries.find(*itRecent);
+		if (itEntry->second.m_pParsed.use_count() > 1)  {
+			continue;
+		}
+		m_nUsage -= itEntry->second.m_nSize;
+		m_mEntries.erase(itEntry);
+		itRecent = m_lstRecent.erase(itRecent);
+	}
+}
+
+ContentCache::ContentCache(size_t nBudget /*= 64 * 1024 * 1024*/)
+: m_pImpl(new Impl(nBudget))
+{
+}
+
+ContentCache::~ContentCache()
+{
+}
+
+bool
+ContentCache::Get(const Object::Ptr &pContents, ParsedContent::Ptr &pParsed)
+{
+	if (!pContents || pContents->GetType() != Object::kStream)  {
+		return false;
+	}
+	if (!pContents->IsIndirect())  {
+		pParsed = ParsedContent::Parse(pContents);
+		return pParsed.get() != NULL;
+	}
+
+	Object::ID nID = pContents->GetID();
+	boost::unique_lock<boost::mutex> lck(m_pImpl->m_mtx);
+	Impl::EntryMap::iterator itFind = m_pImpl->m_mEntries.find(nID);
+	while (itFind != m_pImpl->m_mEntries.end() && itFind->second.m_bLoading)  {
+		// another thread is parsing this one right now
+		m_pImpl->m_cvLoaded.wait(lck);
+		itFind = m_pImpl->m_mEntries.find(nID);
+	}
+	if (itFind != m_pImpl->m_mEntries.end())  {
+		++m_pImpl->m_nHits;
+		m_pImpl->m_lstRecent.splice(m_pImpl->m_lstRecent.begin(),
+			m_pImpl->m_lstRecent, itFind->second.m_itRecent);
+		pParsed = itFind->second.m_pParsed;
+		return true;
+	}
+
+	++m_pImpl->m_nMisses;
+	m_pImpl->m_mEntries[nID];
+	lck.unlock();
+	ParsedContent::Ptr pNew;
+	try  {
+		pNew = ParsedContent::Parse(pContents);
+	} catch (...)  {
+		// the threads waiting for it try for themselves
+		lck.lock();
+		m_pImpl->m_mEntries.erase(nID);
+		m_pImpl->m_cvLoaded.notify_all();
+		throw;
+	}
+	lck.lock();
+
+	itFind = m_pImpl->m_mEntries.find(nID);
+	if (pNew)  {
+		Impl::Entry &rEntry = itFind->second;
+		rEntry.m_pParsed = pNew;
+		rEntry.m_nSize = pNew->GetMemoryUsage();
+		rEntry.m_bLoading = false;
+		rEntry.m_itRecent = m_pImpl->m_lstRecent.insert(m_pImpl->m_lstRecent.begin(), nID);
+		m_pImpl->m_nUsage += rEntry.m_nSize;
+		pParsed = pNew;
+		m_pImpl->Trim();
+	} else  {
+		m_pImpl->m_mEntries.erase(itFind);
+	}
+	m_pImpl->m_cvLoaded.notify_all();
+
+	return pNew.get() != NULL;
+}
+
+void
+ContentCache::SetBudget(size_t nBudget)
+{
+	boost::unique_lock<boost::mutex> lck(m_pImpl->m_mtx);
+	m_pImpl->m_nBudget = nBudget;
+	m_pImpl->Trim();
+}
+
+size_t
+ContentCache::GetBudget() const
+{
+	boost::unique_lock<boost::mutex> lck(m_pImpl->m_mtx);
+	return m_pImpl->m_nBudget;
+}
+
+size_t
+ContentCache::GetMemoryUsage() const
+{
+	boost::unique_lock<boost::mutex> lck(m_pImpl->m_mtx);
+	return m_pImpl->m_nUsage;
+}
+
+unsigned long
+ContentCache::GetHits() const
+{
+	boost::unique_lock<boost::mutex> lck(m_pImpl->m_mtx);
+	return m_pImpl->m_nHits;
+}
+
+unsigned long
+ContentCache::GetMisses() const
+{
+	boost::unique_lock<boost::mutex> lck(m_pImpl->m_mtx);
+	return m_pImpl->m_nMisses;
+}
+
+}
@@ -0,0 +1,168 @@
+/*
+ *  PDFLibContent.h
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#ifndef APAGO_PDFLibContent_h__
+#define APAGO_PDFLibContent_h__
+
+#include <vector>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "PDFLibWrapper.h"
+
+namespace PDFLibWrapper  {
+
+	// A token is a view into the tokenizer's buffer; it stays valid until
+	// the next call to ContentTokenizer::Next.
+	class ContentToken  {
+	public:
+		enum Type { kNone, kInteger, kReal, kBoolean, kNull, kName, kString,
+			kHexString, kArrayBegin, kArrayEnd, kDictBegin, kDictEnd, kOperator,
+			kInlineImageData };
+
+		ContentToken() : m_eType(kNone), m_pData(NULL), m_nLength(0), m_nOffset(0)  { }
+
+		Type GetType() const  { return m_eType; }
+		bool IsNumber() const  { return m_eType == kInteger || m_eType == kReal; }
+
+		// raw bytes, without the delimiters of names and strings
+		const char *GetData() const  { return m_pData; }
+		size_t GetLength() const  { return m_nLength; }
+
+		bool Is(const char *szText) const;
+
+		bool Get(bool &bValue) const;
+		bool Get(int &nValue) const;
+		bool Get(double &dValue) const;
+		bool Get(Name &rValue) const;
+		bool Get(std::string &sValue) const;
+
+	private:
+		Type m_eType;
+		const char *m_pData;
+		size_t m_nLength;
+		size_t m_nOffset;
+
+		friend class ContentTokenizer;
+	};
+
+	class ContentOperation  {
+	public:
+		const ContentToken &GetOperator() const  { return m_tokOperator; }
+		size_t GetOperandCount() const  { return m_vOperands.size(); }
+		const ContentToken &GetOperand(size_t nIndex) const  { return m_vOperands[nIndex]; }
+
+	private:
+		ContentToken m_tokOperator;
+		std::vector<ContentToken> m_vOperands;
+
+		friend class ContentTokenizer;
+		friend class ParsedContent;
+	};
+
+	// Pull tokenizer over decoded content streams.  The streams of a page's
+	// /Contents array are read one after the other through a single buffer
+	// that only grows when one operation doesn't fit into it.
+	class ContentTokenizer : private boost::noncopyable  {
+	public:
+		explicit ContentTokenizer(size_t nBufferSize = 64 * 1024);
+
+		// a page dictionary, a form or content stream, or an array of streams
+		bool Open(const Object::Ptr &pContents);
+		bool Open(const Object::Stream &pStream);
+		// tokens point straight into the caller's memory, which must outlive them
+		bool Open(const char *pData, size_t nLength);
+
+		bool Next(ContentToken &rToken);
+		bool Next(ContentOperation &rOperation);
+
+		size_t GetBufferSize() const  { return m_vBuffer.size(); }
+
+	private:
+		void Reset();
+		bool Fill(size_t nPos);
+		int Peek(size_t nPos)  {
+			if (nPos < m_nEnd)  {
+				return (unsigned char)m_pData[nPos - m_nBase];
+			}
+			return Fill(nPos) ? (unsigned char)m_pData[nPos - m_nBase] : -1;
+		}
+		bool OpenNextStream();
+		void SkipWhitespace();
+		bool Scan(ContentToken &rToken);
+		bool ScanInlineImageData(ContentToken &rToken);
+		void Resolve(ContentToken &rToken) const  {
+			rToken.m_pData = m_pData + (rToken.m_nOffset - m_nBase);
+		}
+
+		std::vector<char> m_vBuffer;
+		const char *m_pData;
+		// absolute positions in the concatenated content
+		size_t m_nBase;
+		size_t m_nKeep;
+		size_t m_nPos;
+		size_t m_nEnd;
+
+		ObjectList m_vContents;
+		size_t m_nNextContent;
+		Object::Stream m_pStream;
+		bool m_bInlineImageData;
+	};
+
+	// The fully tokenized content of one stream, kept in memory so that
+	// forms and patterns used on many pages are decoded and parsed once.
+	class ParsedContent : private boost::noncopyable  {
+	public:
+		typedef boost::shared_ptr<const ParsedContent> Ptr;
+
+		static Ptr Parse(const Object::Ptr &pContents);
+
+		size_t GetOperationCount() const  { return m_vOperations.size(); }
+		void GetOperation(size_t nIndex, ContentOperation &rOperation) const;
+
+		size_t GetMemoryUsage() const;
+
+	private:
+		ParsedContent()  { }
+
+		// first operand and operator of every operation
+		typedef std::pair<size_t, size_t> OperationRange;
+
+		std::vector<char> m_vData;
+		std::vector<ContentToken> m_vTokens;
+		std::vector<OperationRange> m_vOperations;
+	};
+
+	// Per-Document cache of parsed form XObject and tiling pattern content,
+	// keyed by object ID.  Content that a caller still holds is never
+	// evicted; the rest is dropped least recently used first once the
+	// memory budget is exceeded.  Thread-safe, and shared with the
+	// documents created by Document::Reopen.
+	class ContentCache : private boost::noncopyable  {
+	public:
+		explicit ContentCache(size_t nBudget = 64 * 1024 * 1024);
+		~ContentCache();
+
+		bool Get(const Object::Ptr &pContents, ParsedContent::Ptr &pParsed);
+
+		void SetBudget(size_t nBudget);
+		size_t GetBudget() const;
+		size_t GetMemoryUsage() const;
+		unsigned long GetHits() const;
+		unsigned long GetMisses() const;
+
+		struct Impl;
+
+	private:
+		boost::shared_ptr<Impl> m_pImpl;
+	};
+
+}
+
+#endif // APAGO_PDFLibContent_h__
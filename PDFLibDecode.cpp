@@ -0,0 +1,240 @@
+/*
+ *  PDFLibDecode.cpp
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#include <algorithm>
+
+#include <boost/bind/bind.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include "PDFLibDecode.h"
+#include "PDFLibTrace.h"
+
+
+namespace  {
+
+	using namespace PDFLibWrapper;
+
+	typedef boost::mutex Mutex;
+	typedef boost::unique_lock<Mutex> Lock;
+
+	bool
+	IsImageFilter(const std::string &sFilter)
+	{
+		return sFilter == "DCTDecode" || sFilter == "JPXDecode" ||
+			sFilter == "JBIG2Decode" || sFilter == "CCITTFaxDecode";
+	}
+
+}
+
+namespace PDFLibWrapper  {
+
+struct StreamDecoder::Impl  {
+	Impl(size_t nBudget, ThreadPool *pPool)
+		: m_nBudget(nBudget), m_pPool(pPool), m_nHeld(0), m_nPeak(0), m_nRemaining(0)
+	{ }
+
+	// one stream between reading and its callback
+	struct Job  {
+		DecodedStream m_oStream;
+		FilterChain m_vChain;
+		size_t m_nHeld;
+	};
+
+	void Acquire(size_t nBytes);
+	void Adjust(size_t nFrom, size_t nTo);
+	void Release(size_t nBytes);
+	void Run(boost::shared_ptr<Job> pJob);
+
+	size_t m_nBudget;
+	ThreadPool *m_pPool;
+	DecodeCallback m_fnDone;
+
+	Mutex m_mtx;
+	boost::condition_variable m_cvChanged;
+	size_t m_nHeld;
+	size_t m_nPeak;
+	size_t m_nRemaining;
+	boost::exception_ptr m_pException;
+};
+
+void
+StreamDecoder::Impl::Acquire(size_t nBytes)
+{
+	Lock lck(m_mtx);
+	// a single stream over the budget still goes through, on its own
+	while (m_nHeld > 0 && m_nHeld + nBytes > m_nBudget)  {
+		m_cvChanged.wait(lck);
+	}
+	m_nHeld += nBytes;
+	m_nPeak = (std::max)(m_nPeak, m_nHeld);
+}
+
+void
+StreamDecoder::Impl::Adjust(size_t nFrom, size_t nTo)
+{
+	Lock lck(m_mtx);
+	m_nHeld = m_nHeld - nFrom + nTo;
+	m_nPeak = (std::max)(m_nPeak, m_nHeld);
+	if (nTo < nFrom)  {
+		m_cvChanged.notify_all();
+	}
+}
+
+void
+StreamDecoder::Impl::Release(size_t nBytes)
+{
+	Lock lck(m_mtx);
+	m_nHeld -= nBytes;
+	--m_nRemaining;
+	m_cvChanged.notify_all();
+}
+
+void
+StreamDecoder::Impl::Run(boost::shared_ptr<Job> pJob)
+{
+	DecodedStream &rStream = pJob->m_oStream;
+	try  {
+		size_t nApplied = 0;
+		{
+			PDFLIB_TRACE_SPAN_ARG("DecodeStream", "decode", rStream.m_nID);
+			rStream.m_eResult = DecodeFilters(pJob->m_vChain, rStream.m_vData, nApplied,
+				m_nBudget);
+		}
+		if (rStream.m_eResult == kDecodePartial)  {
+			rStream.m_vRemaining.assign(pJob->m_vChain.begin() + nApplied, pJob->m_vChain.end());
+		}
+		Adjust(pJob->m_nHeld, rStream.m_vData.size());
+		pJob->m_nHeld = rStream.m_vData.size();
+		m_fnDone(rStream);
+	} catch (...)  {
+		Lock lck(m_mtx);
+		if (!m_pException)  {
+			m_pException = boost::current_exception();
+		}
+	}
+	// whatever the callback left in the stream goes with the job
+	Release(pJob->m_nHeld);
+}
+
+
+StreamDecoder::StreamDecoder(size_t nMemoryBudget /*= 256 * 1024 * 1024*/,
+	ThreadPool *pPool /*= NULL*/)
+: m_pImpl(new Impl(nMemoryBudget, pPool ? pPool : &ThreadPool::GetDefault()))
+{
+}
+
+bool
+StreamDecoder::Decode(const ObjectList &vStreams, const DecodeCallback &fnDone)
+{
+	m_pImpl->m_fnDone = fnDone;
+	m_pImpl->m_nHeld = m_pImpl->m_nPeak = 0;
+	m_pImpl->m_nRemaining = vStreams.size();
+	m_pImpl->m_pException = boost::exception_ptr();
+
+	// blocking a worker on other workers could deadlock the pool
+	bool bInline = ThreadPool::GetWorkerIndex() >= 0;
+	bool bAllRead = true;
+
+	for (size_t i=0; i<vStreams.size(); i++)  {
+		boost::shared_ptr<Impl::Job> pJob(new Impl::Job);
+		DecodedStream &rStream = pJob->m_oStream;
+		rStream.m_nIndex = i;
+
+		const Object::Ptr &pObject = vStreams[i];
+		Object::Stream pData;
+		bool bRead = false;
+		if (pObject && pObject->GetType() == Object::kStream)  {
+			rStream.m_nID = pObject->GetID();
+			// only image codecs may be left undone; anything else this
+			// module can't decode is left to the Document
+			bool bEncoded = GetFilterChain(pObject, pJob->m_vChain);
+			for (size_t nFilter=0; bEncoded && nFilter<pJob->m_vChain.size(); nFilter++)  {
+				const std::string &sFilter = pJob->m_vChain[nFilter].m_sName;
+				if (IsImageFilter(sFilter))  {
+					break;
+				}
+				bEncoded = CanDecode(sFilter);
+			}
+			boost::int64_t nLength = 0;
+			if (bEncoded && pObject->GetEncoded(pData) && pData)  {
+				pObject->Get(nLength, "Length");
+				bRead = ReadStreamData(pData, rStream.m_vData, nLength > 0 ? (size_t)nLength : 0);
+			} else  {
+				size_t nDecoded = 0;
+				GetDecodedLength(pObject, nDecoded);
+				pJob->m_vChain.clear();
+				rStream.m_vData.clear();
+				bRead = pObject->Get(pData) && pData && ReadStreamData(pData, rStream.m_vData, nDecoded);
+			}
+		}
+		if (!bRead)  {
+			bAllRead = false;
+			pJob->m_vChain.clear();
+			rStream.m_vData.clear();
+		}
+
+		pJob->m_nHeld = rStream.m_vData.size();
+		m_pImpl->Acquire(pJob->m_nHeld);
+		if (bInline)  {
+			m_pImpl->Run(pJob);
+		} else  {
+			m_pImpl->m_pPool->Submit(boost::bind(&Impl::Run, m_pImpl.get(), pJob));
+		}
+	}
+
+	Lock lck(m_pImpl->m_mtx);
+	while (m_pImpl->m_nRemaining > 0)  {
+		m_pImpl->m_cvChanged.wait(lck);
+	}
+	if (m_pImpl->m_pException)  {
+		boost::exception_ptr pException = m_pImpl->m_pException;
+		m_pImpl->m_pException = boost::exception_ptr();
+		boost::rethrow_exception(pException);
+	}
+	return bAllRead;
+}
+
+size_t
+StreamDecoder::GetMemoryBudget() const
+{
+	return m_pImpl->m_nBudget;
+}
+
+size_t
+StreamDecoder::GetPeakMemory() const
+{
+	Lock lck(m_pImpl->m_mtx);
+	return m_pImpl->m_nPeak;
+}
+
+
+bool
+ReadStreamData(const Object::Stream &pStream, std::vector<char> &vData,
+	size_t nSizeHint /*= 0*/)
+{
+	if (!pStream)  {
+		return false;
+	}
+	// one more byte than expected, so the end is seen without growing
+	const size_t nChunk = 64 * 1024;
+	size_t nSize = 0;
+	std::streamsize nRead;
+	vData.clear();
+	vData.resize(nSizeHint > 0 ? (std::min)(nSizeHint, kMaxSizeHint) + 1 : nChunk);
+	do  {
+		if (nSize == vData.size())  {
+			vData.resize(nSize + (std::max)(nSize / 2, nChunk));
+		}
+		nRead = pStream->rdbuf()->sgetn(&vData[nSize], vData.size() - nSize);
+		nSize += (std::max)(nRead, (std::streamsize)0);
+	} while (nRead > 0);
+	vData.resize(nSize);
+	return true;
+}
+
+}
@@ -0,0 +1,81 @@
+/*
+ *  PDFLibDecode.h
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#ifndef APAGO_PDFLibDecode_h__
+#define APAGO_PDFLibDecode_h__
+
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "PDFLibWrapper.h"
+#include "PDFLibFilters.h"
+#include "PDFLibParallel.h"
+
+namespace PDFLibWrapper  {
+
+	class DecodedStream  {
+	public:
+		DecodedStream() : m_nIndex(0), m_nID(Object::kInvalidID), m_eResult(kDecodeFailed)  { }
+
+		// position in the list passed to StreamDecoder::Decode
+		size_t GetIndex() const  { return m_nIndex; }
+		Object::ID GetID() const  { return m_nID; }
+
+		DecodeResult GetResult() const  { return m_eResult; }
+		// swap it out to keep it beyond the callback
+		std::vector<char> &GetData()  { return m_vData; }
+		// image filters left to apply, if the result is kDecodePartial
+		const FilterChain &GetRemainingFilters() const  { return m_vRemaining; }
+
+	private:
+		size_t m_nIndex;
+		Object::ID m_nID;
+		DecodeResult m_eResult;
+		std::vector<char> m_vData;
+		FilterChain m_vRemaining;
+
+		friend class StreamDecoder;
+	};
+
+	typedef boost::function<void (DecodedStream &rStream)> DecodeCallback;
+
+	// Decodes many streams at once.  Encoded data is read on the calling
+	// thread, which owns the streams' Document, and decoded on the pool,
+	// where the callback gets each stream as soon as it is done.  Reading
+	// pauses while the data of streams read but not yet through their
+	// callback exceeds the memory budget.  Streams with filters not handled
+	// by PDFLibFilters are decoded by the Document on the calling thread.
+	class StreamDecoder : private boost::noncopyable  {
+	public:
+		explicit StreamDecoder(size_t nMemoryBudget = 256 * 1024 * 1024,
+			ThreadPool *pPool = NULL);
+
+		// returns once every callback has run, rethrowing the first
+		// exception one of them threw; false if a stream couldn't be read
+		bool Decode(const ObjectList &vStreams, const DecodeCallback &fnDone);
+
+		size_t GetMemoryBudget() const;
+		// most bytes held at once during the last Decode
+		size_t GetPeakMemory() const;
+
+		struct Impl;
+
+	private:
+		boost::shared_ptr<Impl> m_pImpl;
+	};
+
+	// reads a stream to its end; with the right size hint, into a single
+	// allocation
+	bool ReadStreamData(const Object::Stream &pStream, std::vector<char> &vData,
+		size_t nSizeHint = 0);
+
+}
+
+#endif // APAGO_PDFLibDecode_h__
@@ -0,0 +1,1087 @@
+/*
+ *  PDFLibFilters.cpp
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include <zlib.h>
+
+#include <boost/atomic.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PDFLWRAP_SSE2
+#include <emmintrin.h>
+// AVX2 code is compiled per function and only run if the CPU has it
+#if defined(__GNUC__) || defined(_MSC_VER)
+#define PDFLWRAP_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(PDFLWRAP_AVX2) && defined(__GNUC__)
+#define PDFLWRAP_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PDFLWRAP_TARGET_AVX2
+#endif
+
+#if defined(PDFLWRAP_AVX2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "PDFLibFilters.h"
+#include "PDFLibSchema.h"
+
+
+namespace  {
+
+	using namespace PDFLibWrapper;
+
+	const char *
+	ExpandFilterName(const std::string &sName)
+	{
+		static const char *aszAbbreviations[][2] =  {
+			{ "AHx", "ASCIIHexDecode" },
+			{ "A85", "ASCII85Decode" },
+			{ "LZW", "LZWDecode" },
+			{ "Fl", "FlateDecode" },
+			{ "RL", "RunLengthDecode" },
+			{ "CCF", "CCITTFaxDecode" },
+			{ "DCT", "DCTDecode" }
+		};
+		for (size_t i=0; i<sizeof(aszAbbreviations) / sizeof(aszAbbreviations[0]); i++)  {
+			if (sName == aszAbbreviations[i][0])  {
+				return aszAbbreviations[i][1];
+			}
+		}
+		return sName.c_str();
+	}
+
+	void
+	GetFilterParams(const Object::Ptr &pParams, FilterParams &rParams)
+	{
+		if (!pParams || pParams->GetType() != Object::kDict)  {
+			return;
+		}
+		DecodeSchema(*pParams, rParams);
+	}
+
+	// components of a color space as used by images; 0 if unknown
+	int
+	GetComponentCount(const Object::Ptr &pColorSpace)
+	{
+		Name nmFamily;
+		if (!pColorSpace)  {
+			return 0;
+		}
+		if (pColorSpace->GetType() == Object::kArray)  {
+			if (!pColorSpace->Get(nmFamily, 0))  {
+				return 0;
+			}
+			if (nmFamily.GetString() == "ICCBased")  {
+				Object::Ptr pProfile;
+				int nComponents = 0;
+				if (pColorSpace->Get(pProfile, 1) && pProfile && pProfile->Get(nComponents, "N"))  {
+					return nComponents;
+				}
+				return 0;
+			}
+		} else if (!pColorSpace->Get(nmFamily))  {
+			return 0;
+		}
+
+		const std::string &sFamily = nmFamily.GetString();
+		if (sFamily == "DeviceGray" || sFamily == "CalGray" || sFamily == "Indexed" ||
+			sFamily == "Separation" || sFamily == "G" || sFamily == "I")
+		{
+			return 1;
+		}
+		if (sFamily == "DeviceRGB" || sFamily == "CalRGB" || sFamily == "Lab" || sFamily == "RGB")  {
+			return 3;
+		}
+		if (sFamily == "DeviceCMYK" || sFamily == "CMYK")  {
+			return 4;
+		}
+		return 0;
+	}
+
+	// deflate doesn't compress better than about 1:1032, so anything
+	// beyond is a broken hint and not worth allocating for
+	const size_t kMaxInflateRatio = 1032;
+
+	// false if the product doesn't fit
+	inline bool
+	Multiply(size_t nLeft, size_t nRight, size_t &nProduct)
+	{
+		if (nLeft != 0 && nRight > (std::numeric_limits<size_t>::max)() / nLeft)  {
+			return false;
+		}
+		nProduct = nLeft * nRight;
+		return true;
+	}
+
+	// the size of a row the predictor works on, 0 if the parameters are
+	// out of range or the row is too large to be true
+	size_t
+	GetRowBytes(const FilterParams &rParams)
+	{
+		const int nBPC = rParams.m_nBitsPerComponent;
+		if (rParams.m_nColors < 1 || rParams.m_nColumns < 1 ||
+			(nBPC != 1 && nBPC != 2 && nBPC != 4 && nBPC != 8 && nBPC != 16))
+		{
+			return 0;
+		}
+		size_t nPixelBits, nRowBits;
+		if (!Multiply(rParams.m_nColors, nBPC, nPixelBits) ||
+			!Multiply(nPixelBits, rParams.m_nColumns, nRowBits))
+		{
+			return 0;
+		}
+		size_t nRowBytes = nRowBits / 8 + (nRowBits % 8 != 0);
+		return nRowBytes <= kMaxSizeHint ? nRowBytes : 0;
+	}
+
+	// the size of what inflate produces, before the predictor removes
+	// the tag bytes PNG puts in front of each row; 0 for no hint
+	size_t
+	GetInflatedLength(const FilterSpec &rFilter)
+	{
+		const FilterParams &rParams = rFilter.m_oParams;
+		if (rFilter.m_nDecodedLength == 0 || rParams.m_nPredictor < 10)  {
+			return rFilter.m_nDecodedLength;
+		}
+		size_t nRowBytes = GetRowBytes(rParams), nInflated;
+		if (nRowBytes == 0 ||
+			!Multiply(rFilter.m_nDecodedLength / nRowBytes, nRowBytes + 1, nInflated) ||
+			nInflated > kMaxSizeHint)
+		{
+			return 0;
+		}
+		return nInflated;
+	}
+
+	inline bool
+	IsWhitespace(unsigned char c)
+	{
+		return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\0';
+	}
+
+	inline int
+	HexValue(unsigned char c)
+	{
+		if (c >= '0' && c <= '9')  {
+			return c - '0';
+		}
+		c |= 0x20;
+		if (c >= 'a' && c <= 'f')  {
+			return c - 'a' + 10;
+		}
+		return -1;
+	}
+
+	inline unsigned char
+	Paeth(unsigned char a, unsigned char b, unsigned char c)
+	{
+		int p = a + b - c;
+		int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+		if (pa <= pb && pa <= pc)  {
+			return a;
+		}
+		return pb <= pc ? b : c;
+	}
+
+	inline bool
+	IsASCII85Digit(unsigned char c)
+	{
+		return c >= '!' && c <= 'u';
+	}
+
+	// nGroups complete groups of five digits, without 'z' or whitespace
+	void
+	DecodeASCII85Groups(const unsigned char *pIn, size_t nGroups, unsigned char *pOut)
+	{
+		for (size_t i=0; i<nGroups; i++, pIn+=5, pOut+=4)  {
+			unsigned int nTuple = (pIn[0] - '!') * 52200625u + (pIn[1] - '!') * 614125u +
+				(pIn[2] - '!') * 7225u + (pIn[3] - '!') * 85u + (pIn[4] - '!');
+			pOut[0] = (unsigned char)(nTuple >> 24);
+			pOut[1] = (unsigned char)(nTuple >> 16);
+			pOut[2] = (unsigned char)(nTuple >> 8);
+			pOut[3] = (unsigned char)nTuple;
+		}
+	}
+
+	// number of consecutive ASCII85 digits at the start of pIn, given the
+	// bit mask of digits among the next 16 or 32 bytes
+	inline size_t
+	CountLeadingDigits(unsigned int nMask)
+	{
+		size_t n = 0;
+		while (nMask & 1)  {
+			nMask >>= 1;
+			++n;
+		}
+		return n;
+	}
+
+	// unfiltering of a single PNG row; the TIFF predictor is Sub
+	typedef void (*RowFunction)(unsigned char *pRow, const unsigned char *pUp,
+		size_t nRowBytes, size_t nPixelBytes);
+
+	void
+	UndoSub(unsigned char *pRow, const unsigned char *, size_t nRowBytes, size_t nPixelBytes)
+	{
+		for (size_t i=nPixelBytes; i<nRowBytes; i++)  {
+			pRow[i] += pRow[i - nPixelBytes];
+		}
+	}
+
+	void
+	UndoUp(unsigned char *pRow, const unsigned char *pUp, size_t nRowBytes, size_t)
+	{
+		for (size_t i=0; i<nRowBytes; i++)  {
+			pRow[i] += pUp[i];
+		}
+	}
+
+	void
+	UndoAverage(unsigned char *pRow, const unsigned char *pUp, size_t nRowBytes, size_t nPixelBytes)
+	{
+		for (size_t i=0; i<nRowBytes; i++)  {
+			unsigned char nLeft = i >= nPixelBytes ? pRow[i - nPixelBytes] : 0;
+			pRow[i] += (unsigned char)((nLeft + pUp[i]) / 2);
+		}
+	}
+
+	void
+	UndoPaeth(unsigned char *pRow, const unsigned char *pUp, size_t nRowBytes, size_t nPixelBytes)
+	{
+		for (size_t i=0; i<nRowBytes; i++)  {
+			unsigned char nLeft = i >= nPixelBytes ? pRow[i - nPixelBytes] : 0;
+			unsigned char nUpLeft = i >= nPixelBytes ? pUp[i - nPixelBytes] : 0;
+			pRow[i] += Paeth(nLeft, pUp[i], nUpLeft);
+		}
+	}
+
+	// The vector versions.  The block functions convert as much of the
+	// input as they can without having to look at whitespace and the like,
+	// and return how many bytes they consumed; the scalar loops do the rest.
+	struct FilterKernels  {
+		size_t (*m_fnHexBlocks)(const unsigned char *pIn, size_t nLength, unsigned char *pOut);
+		size_t (*m_fnASCII85Blocks)(const unsigned char *pIn, size_t nLength, unsigned char *pOut);
+		// by PNG filter type
+		RowFunction m_afnRows[5];
+	};
+
+#ifdef PDFLWRAP_SSE2
+
+	// reads four bytes even for three byte pixels; narrower reads go
+	// through memory and stall
+	template <size_t N> inline __m128i
+	LoadPixel(const unsigned char *p)
+	{
+		int n;
+		memcpy(&n, p, 4);
+		return _mm_cvtsi32_si128(N == 4 ? n : n & 0xFFFFFF);
+	}
+
+	template <size_t N> inline void
+	StorePixel(unsigned char *p, __m128i v)
+	{
+		int n = _mm_cvtsi128_si32(v);
+		if (N == 4)  {
+			memcpy(p, &n, 4);
+		} else  {
+			p[0] = (unsigned char)n;
+			p[1] = (unsigned char)(n >> 8);
+			p[2] = (unsigned char)(n >> 16);
+		}
+	}
+
+	inline __m128i
+	Select(__m128i vCondition, __m128i vThen, __m128i vElse)
+	{
+		return _mm_or_si128(_mm_and_si128(vCondition, vThen), _mm_andnot_si128(vCondition, vElse));
+	}
+
+	// 16 hex digits to 8 bytes at a time
+	size_t
+	HexBlocksSSE2(const unsigned char *pIn, size_t nLength, unsigned char *pOut)
+	{
+		const __m128i vZero = _mm_set1_epi8('0' - 1), vNine = _mm_set1_epi8('9' + 1);
+		const __m128i vA = _mm_set1_epi8('a' - 1), vF = _mm_set1_epi8('f' + 1);
+		const __m128i vCase = _mm_set1_epi8(0x20), vLowByte = _mm_set1_epi16(0xFF);
+		size_t nDone = 0;
+		while (nDone + 16 <= nLength)  {
+			__m128i v = _mm_loadu_si128((const __m128i *)(pIn + nDone));
+			__m128i vLower = _mm_or_si128(v, vCase);
+			__m128i vDigit = _mm_and_si128(_mm_cmpgt_epi8(v, vZero), _mm_cmplt_epi8(v, vNine));
+			__m128i vLetter = _mm_and_si128(_mm_cmpgt_epi8(vLower, vA), _mm_cmplt_epi8(vLower, vF));
+			if (_mm_movemask_epi8(_mm_or_si128(vDigit, vLetter)) != 0xFFFF)  {
+				break;
+			}
+			__m128i vValue = _mm_or_si128(
+				_mm_and_si128(vDigit, _mm_sub_epi8(v, _mm_set1_epi8('0'))),
+				_mm_and_si128(vLetter, _mm_sub_epi8(vLower, _mm_set1_epi8('a' - 10))));
+			// the high nibble is the even byte, the low byte of each word
+			__m128i vPairs = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(vValue, vLowByte), 4),
+				_mm_srli_epi16(vValue, 8));
+			_mm_storel_epi64((__m128i *)(pOut + nDone / 2), _mm_packus_epi16(vPairs, vPairs));
+			nDone += 16;
+		}
+		return nDone;
+	}
+
+	size_t
+	ASCII85BlocksSSE2(const unsigned char *pIn, size_t nLength, unsigned char *pOut)
+	{
+		const __m128i vLow = _mm_set1_epi8('!' - 1), vHigh = _mm_set1_epi8('u' + 1);
+		size_t nRun = 0;
+		for (;;)  {
+			if (nRun + 16 > nLength)  {
+				while (nRun < nLength && IsASCII85Digit(pIn[nRun]))  {
+					++nRun;
+				}
+				break;
+			}
+			__m128i v = _mm_loadu_si128((const __m128i *)(pIn + nRun));
+			unsigned int nMask = _mm_movemask_epi8(
+				_mm_and_si128(_mm_cmpgt_epi8(v, vLow), _mm_cmplt_epi8(v, vHigh)));
+			if (nMask != 0xFFFF)  {
+				nRun += CountLeadingDigits(nMask);
+				break;
+			}
+			nRun += 16;
+		}
+		DecodeASCII85Groups(pIn, nRun / 5, pOut);
+		return nRun / 5 * 5;
+	}
+
+	void
+	UndoUpSSE2(unsigned char *pRow, const unsigned char *pUp, size_t nRowBytes, size_t nPixelBytes)
+	{
+		size_t i = 0;
+		for (; i+16<=nRowBytes; i+=16)  {
+			__m128i v = _mm_add_epi8(_mm_loadu_si128((const __m128i *)(pRow + i)),
+				_mm_loadu_si128((const __m128i *)(pUp + i)));
+			_mm_storeu_si128((__m128i *)(pRow + i), v);
+		}
+		UndoUp(pRow + i, pUp + i, nRowBytes - i, nPixelBytes);
+	}
+
+	// Sub sums up a row, four pixels at a time: shifted adds within the
+	// block, then the last pixel of the block before is added to all
+	template <size_t N> void
+	UndoSubPixels(unsigned char *pRow, size_t nRowBytes)
+	{
+		const __m128i vPixelMask = _mm_cvtsi32_si128(N == 4 ? -1 : 0xFFFFFF);
+		__m128i vCarry = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i+16<=nRowBytes; i+=4*N)  {
+			__m128i v = _mm_loadu_si128((const __m128i *)(pRow + i));
+			v = _mm_add_epi8(v, _mm_slli_si128(v, N));
+			v = _mm_add_epi8(v, _mm_slli_si128(v, 2 * N));
+			v = _mm_add_epi8(v, vCarry);
+			if (N == 4)  {
+				_mm_storeu_si128((__m128i *)(pRow + i), v);
+			} else  {
+				_mm_storel_epi64((__m128i *)(pRow + i), v);
+				StorePixel<4>(pRow + i + 8, _mm_srli_si128(v, 8));
+			}
+			vCarry = _mm_and_si128(_mm_srli_si128(v, 3 * N), vPixelMask);
+			vCarry = _mm_or_si128(vCarry, _mm_slli_si128(vCarry, N));
+			vCarry = _mm_or_si128(vCarry, _mm_slli_si128(vCarry, 2 * N));
+		}
+		for (i=(std::max)(i, N); i<nRowBytes; i++)  {
+			pRow[i] += pRow[i - N];
+		}
+	}
+
+	// Average and Paeth depend on the pixel to the left in a way that
+	// can't be summed up, so only the bytes of a pixel are done at once
+	template <size_t N> void
+	UndoAveragePixels(unsigned char *pRow, const unsigned char *pUp, size_t nRowBytes)
+	{
+		const __m128i vOne = _mm_set1_epi8(1);
+		__m128i vLeft = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i+4<=nRowBytes; i+=N)  {
+			__m128i vUp = LoadPixel<N>(pUp + i);
+			// _mm_avg_epu8 rounds up, the predictor rounds down
+			__m128i vAverage = _mm_sub_epi8(_mm_avg_epu8(vLeft, vUp),
+				_mm_and_si128(_mm_xor_si128(vLeft, vUp), vOne));
+			vLeft = _mm_add_epi8(vAverage, LoadPixel<N>(pRow + i));
+			StorePixel<N>(pRow + i, vLeft);
+		}
+		for (; i<nRowBytes; i++)  {
+			unsigned char nLeft = i >= N ? pRow[i - N] : 0;
+			pRow[i] += (unsigned char)((nLeft + pUp[i]) / 2);
+		}
+	}
+
+	template <size_t N> void
+	UndoPaethPixels(unsigned char *pRow, const unsigned char *pUp, size_t nRowBytes)
+	{
+		// in 16 bit lanes, as the distances need the sign
+		const __m128i vZero = _mm_setzero_si128();
+		__m128i a = vZero, b = vZero, c = vZero;
+		size_t i = 0;
+		for (; i+4<=nRowBytes; i+=N)  {
+			c = b;
+			b = _mm_unpacklo_epi8(LoadPixel<N>(pUp + i), vZero);
+			__m128i d = _mm_unpacklo_epi8(LoadPixel<N>(pRow + i), vZero);
+
+			__m128i pa = _mm_sub_epi16(b, c);
+			__m128i pb = _mm_sub_epi16(a, c);
+			__m128i pc = _mm_add_epi16(pa, pb);
+			pa = _mm_max_epi16(pa, _mm_sub_epi16(vZero, pa));
+			pb = _mm_max_epi16(pb, _mm_sub_epi16(vZero, pb));
+			pc = _mm_max_epi16(pc, _mm_sub_epi16(vZero, pc));
+			__m128i vSmallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+			__m128i vPredicted = Select(_mm_cmpeq_epi16(pa, vSmallest), a,
+				Select(_mm_cmpeq_epi16(pb, vSmallest), b, c));
+
+			a = _mm_add_epi8(d, vPredicted);
+			StorePixel<N>(pRow + i, _mm_packus_epi16(a, a));
+		}
+		for (; i<nRowBytes; i++)  {
+			unsigned char nLeft = i >= N ? pRow[i - N] : 0;
+			unsigned char nUpLeft = i >= N ? pUp[i - N] : 0;
+			pRow[i] += Paeth(nLeft, pUp[i], nUpLeft);
+		}
+	}
+
+	// worth it for RGB and CMYK; other pixel sizes are left to the scalar code
+	void
+	UndoSubSSE2(unsigned char *pRow, const unsigned char *pUp, size_t nRowBytes, size_t nPixelBytes)
+	{
+		if (nPixelBytes == 3)  {
+			UndoSubPixels<3>(pRow, nRowBytes);
+		} else if (nPixelBytes == 4)  {
+			UndoSubPixels<4>(pRow, nRowBytes);
+		} else  {
+			UndoSub(pRow, pUp, nRowBytes, nPixelBytes);
+		}
+	}
+
+	void
+	UndoAverageSSE2(unsigned char *pRow, const unsigned char *pUp, size_t nRowBytes, size_t nPixelBytes)
+	{
+		if (nPixelBytes == 3)  {
+			UndoAveragePixels<3>(pRow, pUp, nRowBytes);
+		} else if (nPixelBytes == 4)  {
+			UndoAveragePixels<4>(pRow, pUp, nRowBytes);
+		} else  {
+			UndoAverage(pRow, pUp, nRowBytes, nPixelBytes);
+		}
+	}
+
+	void
+	UndoPaethSSE2(unsigned char *pRow, const unsigned char *pUp, size_t nRowBytes, size_t nPixelBytes)
+	{
+		if (nPixelBytes == 3)  {
+			UndoPaethPixels<3>(pRow, pUp, nRowBytes);
+		} else if (nPixelBytes == 4)  {
+			UndoPaethPixels<4>(pRow, pUp, nRowBytes);
+		} else  {
+			UndoPaeth(pRow, pUp, nRowBytes, nPixelBytes);
+		}
+	}
+
+	const FilterKernels g_oSSE2Kernels =  {
+		HexBlocksSSE2, ASCII85BlocksSSE2,
+		{ NULL, UndoSubSSE2, UndoUpSSE2, UndoAverageSSE2, UndoPaethSSE2 }
+	};
+
+#endif // PDFLWRAP_SSE2
+
+#ifdef PDFLWRAP_AVX2
+
+	PDFLWRAP_TARGET_AVX2 size_t
+	HexBlocksAVX2(const unsigned char *pIn, size_t nLength, unsigned char *pOut)
+	{
+		const __m256i vZero = _mm256_set1_epi8('0' - 1), vNine = _mm256_set1_epi8('9' + 1);
+		const __m256i vA = _mm256_set1_epi8('a' - 1), vF = _mm256_set1_epi8('f' + 1);
+		const __m256i vCase = _mm256_set1_epi8(0x20), vLowByte = _mm256_set1_epi16(0xFF);
+		size_t nDone = 0;
+		while (nDone + 32 <= nLength)  {
+			__m256i v = _mm256_loadu_si256((const __m256i *)(pIn + nDone));
+			__m256i vLower = _mm256_or_si256(v, vCase);
+			__m256i vDigit = _mm256_and_si256(_mm256_cmpgt_epi8(v, vZero), _mm256_cmpgt_epi8(vNine, v));
+			__m256i vLetter = _mm256_and_si256(_mm256_cmpgt_epi8(vLower, vA),
+				_mm256_cmpgt_epi8(vF, vLower));
+			if ((unsigned int)_mm256_movemask_epi8(_mm256_or_si256(vDigit, vLetter)) != 0xFFFFFFFFu)  {
+				break;
+			}
+			__m256i vValue = _mm256_or_si256(
+				_mm256_and_si256(vDigit, _mm256_sub_epi8(v, _mm256_set1_epi8('0'))),
+				_mm256_and_si256(vLetter, _mm256_sub_epi8(vLower, _mm256_set1_epi8('a' - 10))));
+			__m256i vPairs = _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(vValue, vLowByte), 4),
+				_mm256_srli_epi16(vValue, 8));
+			// packing works within each half; gather the two results
+			__m256i vPacked = _mm256_permute4x64_epi64(_mm256_packus_epi16(vPairs, vPairs), 0x08);
+			_mm_storeu_si128((__m128i *)(pOut + nDone / 2), _mm256_castsi256_si128(vPacked));
+			nDone += 32;
+		}
+		// avoid the penalty of mixing AVX and SSE code
+		_mm256_zeroupper();
+		return nDone + HexBlocksSSE2(pIn + nDone, nLength - nDone, pOut + nDone / 2);
+	}
+
+	PDFLWRAP_TARGET_AVX2 size_t
+	ASCII85BlocksAVX2(const unsigned char *pIn, size_t nLength, unsigned char *pOut)
+	{
+		const __m256i vLow = _mm256_set1_epi8('!' - 1), vHigh = _mm256_set1_epi8('u' + 1);
+		size_t nRun = 0;
+		for (;;)  {
+			if (nRun + 32 > nLength)  {
+				while (nRun < nLength && IsASCII85Digit(pIn[nRun]))  {
+					++nRun;
+				}
+				break;
+			}
+			__m256i v = _mm256_loadu_si256((const __m256i *)(pIn + nRun));
+			unsigned int nMask = (unsigned int)_mm256_movemask_epi8(
+				_mm256_and_si256(_mm256_cmpgt_epi8(v, vLow), _mm256_cmpgt_epi8(vHigh, v)));
+			if (nMask != 0xFFFFFFFFu)  {
+				nRun += CountLeadingDigits(nMask);
+				break;
+			}
+			nRun += 32;
+		}
+		_mm256_zeroupper();
+		DecodeASCII85Groups(pIn, nRun / 5, pOut);
+		return nRun / 5 * 5;
+	}
+
+	PDFLWRAP_TARGET_AVX2 void
+	UndoUpAVX2(unsigned char *pRow, const unsigned char *pUp, size_t nRowBytes, size_t nPixelBytes)
+	{
+		size_t i = 0;
+		for (; i+32<=nRowBytes; i+=32)  {
+			__m256i v = _mm256_add_epi8(_mm256_loadu_si256((const __m256i *)(pRow + i)),
+				_mm256_loadu_si256((const __m256i *)(pUp + i)));
+			_mm256_storeu_si256((__m256i *)(pRow + i), v);
+		}
+		_mm256_zeroupper();
+		UndoUpSSE2(pRow + i, pUp + i, nRowBytes - i, nPixelBytes);
+	}
+
+	const FilterKernels g_oAVX2Kernels =  {
+		HexBlocksAVX2, ASCII85BlocksAVX2,
+		{ NULL, UndoSubSSE2, UndoUpAVX2, UndoAverageSSE2, UndoPaethSSE2 }
+	};
+
+	bool
+	HasAVX2()
+	{
+#ifdef _MSC_VER
+		int anInfo[4];
+		__cpuid(anInfo, 0);
+		if (anInfo[0] < 7)  {
+			return false;
+		}
+		// the OS has to save the YMM registers as well
+		__cpuid(anInfo, 1);
+		if (!(anInfo[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)  {
+			return false;
+		}
+		__cpuidex(anInfo, 7, 0);
+		return (anInfo[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}
+
+#endif // PDFLWRAP_AVX2
+
+	const FilterKernels g_oScalarKernels =  {
+		NULL, NULL,
+		{ NULL, UndoSub, UndoUp, UndoAverage, UndoPaeth }
+	};
+
+	FilterImpl
+	GetBestFilterImpl()
+	{
+#ifdef PDFLWRAP_AVX2
+		if (HasAVX2())  {
+			return kFilterAVX2;
+		}
+#endif
+#ifdef PDFLWRAP_SSE2
+		return kFilterSSE2;
+#else
+		return kFilterScalar;
+#endif
+	}
+
+	// read by every decoder, so set atomically
+	boost::atomic<int> g_nFilterImpl(GetBestFilterImpl());
+
+	const FilterKernels &
+	GetKernels()
+	{
+		switch (g_nFilterImpl.load(boost::memory_order_relaxed))  {
+#ifdef PDFLWRAP_AVX2
+			case kFilterAVX2:
+				return g_oAVX2Kernels;
+#endif
+#ifdef PDFLWRAP_SSE2
+			case kFilterSSE2:
+				return g_oSSE2Kernels;
+#endif
+			default:
+				return g_oScalarKernels;
+		}
+	}
+
+	// grows geometrically, the decoders can't always tell the final size
+	inline void
+	GrowOutput(std::vector<char> &vOutput, size_t nSize)
+	{
+		if (vOutput.size() < nSize)  {
+			vOutput.resize((std::max)(nSize, vOutput.size() * 2));
+		}
+	}
+
+}
+
+namespace PDFLibWrapper  {
+
+void
+FilterParams::DescribeSchema(Schema<FilterParams> &rSchema)
+{
+	rSchema.Optional<int, &FilterParams::m_nPredictor>("Predictor")
+		.Optional<int, &FilterParams::m_nColors>("Colors")
+		.Optional<int, &FilterParams::m_nBitsPerComponent>("BitsPerComponent")
+		.Optional<int, &FilterParams::m_nColumns>("Columns");
+}
+
+bool
+GetFilterChain(const Object::Ptr &pStream, FilterChain &vChain)
+{
+	vChain.clear();
+	if (!pStream || pStream->GetType() != Object::kStream)  {
+		return false;
+	}
+
+	Object::Ptr pFilter, pParams;
+	if (!pStream->Get(pFilter, "Filter") || !pFilter)  {
+		return true;
+	}
+	pStream->Get(pParams, "DecodeParms");
+
+	Name nmFilter;
+	if (pFilter->GetType() == Object::kName)  {
+		if (!pFilter->Get(nmFilter))  {
+			return false;
+		}
+		vChain.resize(1);
+		vChain[0].m_sName = ExpandFilterName(nmFilter.GetString());
+		GetFilterParams(pParams, vChain[0].m_oParams);
+		GetDecodedLength(pStream, vChain[0].m_nDecodedLength);
+		return true;
+	}
+
+	if (pFilter->GetType() != Object::kArray)  {
+		return false;
+	}
+	int nFilters = pFilter->GetLength();
+	vChain.resize(nFilters);
+	for (int i=0; i<nFilters; i++)  {
+		if (!pFilter->Get(nmFilter, i))  {
+			return false;
+		}
+		vChain[i].m_sName = ExpandFilterName(nmFilter.GetString());
+		Object::Ptr pFilterParams;
+		if (pParams && pParams->GetType() == Object::kArray && pParams->Get(pFilterParams, i))  {
+			GetFilterParams(pFilterParams, vChain[i].m_oParams);
+		}
+	}
+	if (!vChain.empty())  {
+		GetDecodedLength(pStream, vChain.back().m_nDecodedLength);
+	}
+	return true;
+}
+
+bool
+GetDecodedLength(const Object::Ptr &pStream, size_t &nLength)
+{
+	if (!pStream)  {
+		return false;
+	}
+	boost::int64_t nDecoded = 0;
+	if (pStream->Get(nDecoded, "DL") && nDecoded > 0)  {
+		nLength = (size_t)nDecoded;
+		return (boost::int64_t)nLength == nDecoded;
+	}
+
+	Name nmSubtype;
+	if (!pStream->Get(nmSubtype, "Subtype") || nmSubtype.GetString() != "Image")  {
+		return false;
+	}
+	int nWidth = 0, nHeight = 0, nBitsPerComponent = 0, nComponents = 0;
+	bool bMask = false;
+	if (!pStream->Get(nWidth, "Width") || !pStream->Get(nHeight, "Height") || nWidth < 1 || nHeight < 1)  {
+		return false;
+	}
+	if (pStream->Get(bMask, "ImageMask") && bMask)  {
+		nComponents = nBitsPerComponent = 1;
+	} else  {
+		Object::Ptr pColorSpace;
+		pStream->Get(pColorSpace, "ColorSpace");
+		nComponents = GetComponentCount(pColorSpace);
+		pStream->Get(nBitsPerComponent, "BitsPerComponent");
+	}
+	if (nComponents < 1 || nBitsPerComponent < 1 || nBitsPerComponent > 16)  {
+		return false;
+	}
+	boost::uint64_t nRowBytes = ((boost::uint64_t)nWidth * nComponents * nBitsPerComponent + 7) / 8;
+	boost::uint64_t nTotal = nRowBytes * nHeight;
+	nLength = (size_t)nTotal;
+	return nLength == nTotal;
+}
+
+bool
+CanDecode(const std::string &sFilter)
+{
+	return sFilter == "FlateDecode" || sFilter == "ASCIIHexDecode" ||
+		sFilter == "ASCII85Decode" || sFilter == "RunLengthDecode";
+}
+
+DecodeResult
+DecodeFilters(const FilterChain &vChain, std::vector<char> &vData, size_t &nApplied,
+	size_t nMaxOutput /*= 0*/)
+{
+	std::vector<char> vOutput;
+	for (nApplied=0; nApplied<vChain.size(); nApplied++)  {
+		const FilterSpec &rFilter = vChain[nApplied];
+		const char *pData = vData.empty() ? "" : &vData[0];
+		vOutput.clear();
+
+		bool bSuccess;
+		if (rFilter.m_sName == "FlateDecode")  {
+			bSuccess = DecodeFlate(pData, vData.size(), vOutput, GetInflatedLength(rFilter),
+					nMaxOutput) &&
+				ApplyPredictor(rFilter.m_oParams, vOutput);
+		} else if (rFilter.m_sName == "ASCIIHexDecode")  {
+			bSuccess = DecodeASCIIHex(pData, vData.size(), vOutput);
+		} else if (rFilter.m_sName == "ASCII85Decode")  {
+			bSuccess = DecodeASCII85(pData, vData.size(), vOutput);
+		} else if (rFilter.m_sName == "RunLengthDecode")  {
+			bSuccess = DecodeRunLength(pData, vData.size(), vOutput);
+		} else  {
+			return kDecodePartial;
+		}
+		if (!bSuccess)  {
+			return kDecodeFailed;
+		}
+		vData.swap(vOutput);
+	}
+	return kDecodeComplete;
+}
+
+bool
+DecodeFlate(const char *pData, size_t nLength, std::vector<char> &vOutput,
+	size_t nDecodedLength /*= 0*/, size_t nMaxOutput /*= 0*/)
+{
+	z_stream oStream;
+	memset(&oStream, 0, sizeof(oStream));
+	if (inflateInit(&oStream) != Z_OK)  {
+		return false;
+	}
+
+	size_t nStart = vOutput.size();
+	size_t nChunk = (std::max)(nLength * 4, (size_t)16 * 1024);
+	// Z_FINISH also spares inflate its window if everything fits
+	int nFlush = Z_NO_FLUSH;
+	if (nDecodedLength > 0 && nDecodedLength / kMaxInflateRatio <= nLength)  {
+		// one more byte, so a stream of the expected size ends in the
+		// first call rather than asking for more room
+		nChunk = (std::min)(nDecodedLength, kMaxSizeHint) + 1;
+		nFlush = Z_FINISH;
+	}
+	// no more than deflate can produce, so a bomb stops where a real
+	// stream would have to
+	size_t nLimit;
+	if (!Multiply(nLength, kMaxInflateRatio, nLimit))  {
+		nLimit = (std::numeric_limits<size_t>::max)();
+	}
+	if (nMaxOutput > 0)  {
+		nLimit = (std::min)(nLimit, nMaxOutput);
+	}
+
+	// zlib counts in uInt, so larger input goes in pieces
+	const size_t nMaxPiece = (std::numeric_limits<uInt>::max)();
+	const char *pNext = pData;
+	size_t nLeft = nLength;
+	int nResult = Z_OK;
+	while (nResult == Z_OK)  {
+		if (oStream.avail_in == 0 && nLeft > 0)  {
+			oStream.next_in = (Bytef *)pNext;
+			oStream.avail_in = (uInt)(std::min)(nLeft, nMaxPiece);
+			pNext += oStream.avail_in;
+			nLeft -= oStream.avail_in;
+		}
+		size_t nUsed = vOutput.size();
+		size_t nRoom = (std::min)((std::min)(nChunk, nMaxPiece), nLimit - (nUsed - nStart));
+		if (nRoom == 0)  {
+			break;
+		}
+		vOutput.resize(nUsed + nRoom);
+		oStream.next_out = (Bytef *)&vOutput[nUsed];
+		oStream.avail_out = (uInt)nRoom;
+		// Z_FINISH only once inflate has all of the input
+		nResult = inflate(&oStream, nLeft == 0 ? nFlush : Z_NO_FLUSH);
+		vOutput.resize(nUsed + nRoom - oStream.avail_out);
+		// out of room, which with a wrong hint makes this a streaming
+		// decode, or out of the current piece of input
+		if (nResult == Z_BUF_ERROR && (oStream.avail_out == 0 || nLeft > 0))  {
+			nResult = Z_OK;
+		}
+		nChunk = (std::min)((std::max)(nChunk, (size_t)16 * 1024) * 2, nMaxPiece);
+	}
+	inflateEnd(&oStream);
+
+	// damaged streams are common; keep whatever could be decoded
+	return nResult == Z_STREAM_END || vOutput.size() > nStart;
+}
+
+bool
+DecodeASCIIHex(const char *pData, size_t nLength, std::vector<char> &vOutput)
+{
+	const FilterKernels &rKernels = GetKernels();
+	const unsigned char *pIn = (const unsigned char *)pData;
+	size_t nOut = vOutput.size();
+	GrowOutput(vOutput, nOut + nLength / 2 + 1);
+	unsigned char *pOut = (unsigned char *)&vOutput[0];
+
+	int nHigh = -1;
+	for (size_t i=0; i<nLength; i++)  {
+		if (nHigh < 0 && rKernels.m_fnHexBlocks)  {
+			size_t nDone = rKernels.m_fnHexBlocks(pIn + i, nLength - i, pOut + nOut);
+			i += nDone;
+			nOut += nDone / 2;
+			if (i == nLength)  {
+				break;
+			}
+		}
+		unsigned char c = pIn[i];
+		if (c == '>')  {
+			break;
+		}
+		int nValue = HexValue(c);
+		if (nValue < 0)  {
+			if (IsWhitespace(c))  {
+				continue;
+			}
+			vOutput.resize(nOut);
+			return false;
+		}
+		if (nHigh < 0)  {
+			nHigh = nValue;
+		} else  {
+			pOut[nOut++] = (unsigned char)((nHigh << 4) | nValue);
+			nHigh = -1;
+		}
+	}
+	if (nHigh >= 0)  {
+		pOut[nOut++] = (unsigned char)(nHigh << 4);
+	}
+	vOutput.resize(nOut);
+	return true;
+}
+
+bool
+DecodeASCII85(const char *pData, size_t nLength, std::vector<char> &vOutput)
+{
+	const FilterKernels &rKernels = GetKernels();
+	const unsigned char *pIn = (const unsigned char *)pData;
+	size_t nOut = vOutput.size();
+	// 'z' makes four bytes of one, so the output may need to grow later
+	GrowOutput(vOutput, nOut + nLength / 5 * 4 + 4);
+
+	unsigned int nTuple = 0;
+	int nCount = 0;
+	for (size_t i=0; i<nLength; i++)  {
+		if (nCount == 0 && rKernels.m_fnASCII85Blocks)  {
+			GrowOutput(vOutput, nOut + (nLength - i) / 5 * 4);
+			size_t nDone = rKernels.m_fnASCII85Blocks(pIn + i, nLength - i,
+				(unsigned char *)&vOutput[0] + nOut);
+			i += nDone;
+			nOut += nDone / 5 * 4;
+			if (i == nLength)  {
+				break;
+			}
+		}
+		unsigned char c = pIn[i];
+		if (c == '~')  {
+			break;
+		}
+		if (IsWhitespace(c))  {
+			continue;
+		}
+		if (c == 'z' && nCount == 0)  {
+			GrowOutput(vOutput, nOut + 4);
+			memset(&vOutput[nOut], 0, 4);
+			nOut += 4;
+			continue;
+		}
+		if (!IsASCII85Digit(c))  {
+			vOutput.resize(nOut);
+			return false;
+		}
+		nTuple = nTuple * 85 + (c - '!');
+		if (++nCount == 5)  {
+			GrowOutput(vOutput, nOut + 4);
+			vOutput[nOut++] = (char)(nTuple >> 24);
+			vOutput[nOut++] = (char)(nTuple >> 16);
+			vOutput[nOut++] = (char)(nTuple >> 8);
+			vOutput[nOut++] = (char)nTuple;
+			nTuple = 0;
+			nCount = 0;
+		}
+	}
+	// a final partial group is padded with 'u'
+	if (nCount > 1)  {
+		for (int i=nCount; i<5; i++)  {
+			nTuple = nTuple * 85 + 84;
+		}
+		GrowOutput(vOutput, nOut + 4);
+		for (int i=0; i<nCount-1; i++)  {
+			vOutput[nOut++] = (char)(nTuple >> (24 - 8 * i));
+		}
+	}
+	vOutput.resize(nOut);
+	return true;
+}
+
+bool
+DecodeRunLength(const char *pData, size_t nLength, std::vector<char> &vOutput)
+{
+	size_t i = 0;
+	while (i < nLength)  {
+		unsigned char nRun = pData[i++];
+		if (nRun == 128)  {
+			break;
+		}
+		if (nRun < 128)  {
+			size_t nCopy = (std::min)((size_t)nRun + 1, nLength - i);
+			vOutput.insert(vOutput.end(), pData + i, pData + i + nCopy);
+			i += nCopy;
+		} else if (i < nLength)  {
+			vOutput.insert(vOutput.end(), 257 - nRun, pData[i++]);
+		}
+	}
+	return true;
+}
+
+bool
+ApplyPredictor(const FilterParams &oParams, std::vector<char> &vData)
+{
+	if (oParams.m_nPredictor <= 1)  {
+		return true;
+	}
+	// checks the parameters, and that a row fits in memory
+	const size_t nRowBytes = GetRowBytes(oParams);
+	if (nRowBytes == 0)  {
+		return false;
+	}
+	const size_t nPixelBits = (size_t)oParams.m_nColors * oParams.m_nBitsPerComponent;
+	const size_t nPixelBytes = (std::max)(nPixelBits / 8, (size_t)1);
+	unsigned char *pData = (unsigned char *)(vData.empty() ? NULL : &vData[0]);
+
+	const FilterKernels &rKernels = GetKernels();
+
+	if (oParams.m_nPredictor == 2)  {
+		// TIFF: every component is the difference to the one a pixel left
+		if (oParams.m_nBitsPerComponent != 8)  {
+			return false;
+		}
+		for (size_t nRow=0; nRow+nRowBytes<=vData.size(); nRow+=nRowBytes)  {
+			rKernels.m_afnRows[1](pData + nRow, NULL, nRowBytes, nPixelBytes);
+		}
+		return true;
+	}
+
+	// PNG: every row starts with its own filter type byte, which is dropped;
+	// with not even one row, the parameters are more likely wrong than the data
+	if (nRowBytes + 1 > vData.size())  {
+		return false;
+	}
+	std::vector<unsigned char> vPrior(nRowBytes, 0);
+	size_t nIn = 0, nOut = 0;
+	while (nIn + 1 + nRowBytes <= vData.size())  {
+		unsigned char nType = pData[nIn++];
+		unsigned char *pRow = pData + nOut;
+		memmove(pRow, pData + nIn, nRowBytes);
+		nIn += nRowBytes;
+		if (nType > 4)  {
+			return false;
+		}
+		if (nType != 0)  {
+			rKernels.m_afnRows[nType](pRow, &vPrior[0], nRowBytes, nPixelBytes);
+		}
+		memcpy(&vPrior[0], pRow, nRowBytes);
+		nOut += nRowBytes;
+	}
+	vData.resize(nOut);
+	return true;
+}
+
+
+FilterImpl
+GetFilterImpl()
+{
+	return (FilterImpl)g_nFilterImpl.load(boost::memory_order_relaxed);
+}
+
+bool
+SetFilterImpl(FilterImpl eImpl)
+{
+	if (!IsFilterImplSupported(eImpl))  {
+		return false;
+	}
+	g_nFilterImpl.store(eImpl, boost::memory_order_relaxed);
+	return true;
+}
+
+bool
+IsFilterImplSupported(FilterImpl eImpl)
+{
+	switch (eImpl)  {
+		case kFilterScalar:
+			return true;
+#ifdef PDFLWRAP_SSE2
+		case kFilterSSE2:
+			return true;
+#endif
+#ifdef PDFLWRAP_AVX2
+		case kFilterAVX2:
+			return HasAVX2();
+#endif
+		default:
+			return false;
+	}
+}
+
+const char *
+GetFilterImplName(FilterImpl eImpl)
+{
+	switch (eImpl)  {
+		case kFilterScalar:
+			return "scalar";
+		case kFilterSSE2:
+			return "SSE2";
+		case kFilterAVX2:
+			return "AVX2";
+	}
+	return "unknown";
+}
+
+}
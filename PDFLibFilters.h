@@ -0,0 +1,104 @@
+/*
+ *  PDFLibFilters.h
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#ifndef APAGO_PDFLibFilters_h__
+#define APAGO_PDFLibFilters_h__
+
+#include <vector>
+#include <string>
+
+#include "PDFLibWrapper.h"
+
+namespace PDFLibWrapper  {
+
+	// Stream filters that work on plain bytes, so they can run on any
+	// thread once the encoded data has been read from the Document.
+
+	template <class S> class Schema;
+
+	// of /DecodeParms
+	struct FilterParams  {
+		FilterParams()
+			: m_nPredictor(1), m_nColors(1), m_nBitsPerComponent(8), m_nColumns(1)
+		{ }
+
+		int m_nPredictor;
+		int m_nColors;
+		int m_nBitsPerComponent;
+		int m_nColumns;
+
+		static void DescribeSchema(Schema<FilterParams> &rSchema);
+	};
+
+	struct FilterSpec  {
+		FilterSpec() : m_nDecodedLength(0)  { }
+
+		// full name, abbreviations are expanded
+		std::string m_sName;
+		FilterParams m_oParams;
+		// expected size of the output of this filter, 0 if not known
+		size_t m_nDecodedLength;
+	};
+	typedef std::vector<FilterSpec> FilterChain;
+
+	// /Filter and /DecodeParms of a stream, in the order they are applied;
+	// the last filter gets the decoded length of the stream, if known
+	bool GetFilterChain(const Object::Ptr &pStream, FilterChain &vChain);
+
+	// from /DL, or from the dimensions of an image; only a hint, since
+	// either may be wrong in damaged files
+	bool GetDecodedLength(const Object::Ptr &pStream, size_t &nLength);
+
+	enum DecodeResult  {
+		kDecodeFailed,
+		// stopped at a filter not handled here, typically an image codec;
+		// the data is what that filter gets as input
+		kDecodePartial,
+		kDecodeComplete
+	};
+
+	// decodes vData in place; nApplied is set to the number of filters done;
+	// nMaxOutput, if not 0, limits what a single filter may produce
+	DecodeResult DecodeFilters(const FilterChain &vChain, std::vector<char> &vData,
+		size_t &nApplied, size_t nMaxOutput = 0);
+	bool CanDecode(const std::string &sFilter);
+
+	// a larger /Length, /DL or image size is more likely broken than true,
+	// and not allocated for up front
+	const size_t kMaxSizeHint = 256 * 1024 * 1024;
+
+	// the single filters; they append to vOutput
+	// with the size of the output known, it is allocated once and
+	// inflated in a single call; otherwise the output grows as it goes.
+	// Output beyond what deflate could expand nLength bytes to, or beyond
+	// nMaxOutput if not 0, is cut off.
+	bool DecodeFlate(const char *pData, size_t nLength, std::vector<char> &vOutput,
+		size_t nDecodedLength = 0, size_t nMaxOutput = 0);
+	bool DecodeASCIIHex(const char *pData, size_t nLength, std::vector<char> &vOutput);
+	bool DecodeASCII85(const char *pData, size_t nLength, std::vector<char> &vOutput);
+	bool DecodeRunLength(const char *pData, size_t nLength, std::vector<char> &vOutput);
+	// undoes a PNG or TIFF predictor in place
+	bool ApplyPredictor(const FilterParams &oParams, std::vector<char> &vData);
+
+	// Implementations of ASCIIHex, ASCII85 and the predictors.  The fastest
+	// the CPU supports is used; the others exist to compare against.
+	enum FilterImpl  {
+		kFilterScalar,
+		kFilterSSE2,
+		kFilterAVX2
+	};
+
+	FilterImpl GetFilterImpl();
+	// false if the CPU or the build lacks it; decoders already running
+	// may finish with the implementation they started with
+	bool SetFilterImpl(FilterImpl eImpl);
+	bool IsFilterImplSupported(FilterImpl eImpl);
+	const char *GetFilterImplName(FilterImpl eImpl);
+
+}
+
+#endif // APAGO_PDFLibFilters_h__
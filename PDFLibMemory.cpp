@@ -0,0 +1,1089 @@
+/*
+ *  PDFLibMemory.cpp
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+
+#include <boost/integer_traits.hpp>
+
+#include "PDFLibMemory.h"
+#include "PDFLibContent.h"
+#include "PDFLibDecode.h"
+#include "PDFLibFilters.h"
+
+
+namespace  {
+
+	using namespace PDFLibWrapper;
+
+	// deeper nesting is taken for a damaged file
+	const int kMaxDepth = 256;
+
+	// Recursive descent over ContentTokenizer tokens.  References need two
+	// tokens of lookahead, which are pushed back when they turn out not to
+	// be "n g R".
+	class ObjectParser  {
+	public:
+		ObjectParser(const char *pData, size_t nLength)
+			: m_pData(pData), m_nLength(nLength)
+		{
+			m_oTokenizer.Open(pData, nLength);
+		}
+
+		bool Next(ContentToken &rToken)  {
+			if (!m_vPushed.empty())  {
+				rToken = m_vPushed.back();
+				m_vPushed.pop_back();
+				return true;
+			}
+			return m_oTokenizer.Next(rToken);
+		}
+		void PushBack(const ContentToken &rToken)  { m_vPushed.push_back(rToken); }
+
+		// carries on at nPos, as after the data of a stream
+		void Seek(size_t nPos)  {
+			m_vPushed.clear();
+			nPos = (std::min)(nPos, m_nLength);
+			m_oTokenizer.Open(m_pData + nPos, m_nLength - nPos);
+		}
+		size_t GetEnd(const ContentToken &rToken) const  {
+			return rToken.GetData() + rToken.GetLength() - m_pData;
+		}
+
+		// a reference leaves pValue empty and sets nRef
+		bool ParseValue(const ContentToken &tokFirst, MemoryObjectPtr &pValue, Object::ID &nRef,
+			int nDepth = 0);
+
+		// the stream data following tokStream, for the dictionary pDict
+		bool ParseStreamData(const ContentToken &tokStream, const MemoryObjectPtr &pDict,
+			std::string &sData);
+
+		bool IsReference(const ContentToken &tokFirst, Object::ID &nRef);
+
+	private:
+		const char *m_pData;
+		size_t m_nLength;
+		ContentTokenizer m_oTokenizer;
+		std::vector<ContentToken> m_vPushed;
+	};
+
+	// numbers out of range come from damaged files; a cast of them would be
+	// undefined, and an ID that large would make m_vObjects as long as it says
+	Object::ID
+	ToObjectID(double dID)
+	{
+		if (dID >= 0 && dID <= MemoryDoc::kMaxID)  {
+			return (Object::ID)dID;
+		}
+		return Object::kInvalidID;
+	}
+
+	bool
+	ObjectParser::IsReference(const ContentToken &tokFirst, Object::ID &nRef)
+	{
+		ContentToken tokGeneration, tokR;
+		if (!Next(tokGeneration))  {
+			return false;
+		}
+		if (tokGeneration.GetType() == ContentToken::kInteger && Next(tokR))  {
+			if (tokR.Is("R"))  {
+				double dID;
+				tokFirst.Get(dID);
+				nRef = ToObjectID(dID);
+				return true;
+			}
+			PushBack(tokR);
+		}
+		PushBack(tokGeneration);
+		return false;
+	}
+
+	bool
+	ObjectParser::ParseValue(const ContentToken &tokFirst, MemoryObjectPtr &pValue,
+		Object::ID &nRef, int nDepth /*= 0*/)
+	{
+		pValue.reset();
+		nRef = Object::kInvalidID;
+		if (nDepth > kMaxDepth)  {
+			return false;
+		}
+
+		ContentToken tokCurrent;
+		switch (tokFirst.GetType())  {
+			case ContentToken::kInteger:
+				{
+					if (IsReference(tokFirst, nRef))  {
+						return true;
+					}
+					double dValue;
+					tokFirst.Get(dValue);
+					pValue = MemoryObject::MakeInteger((boost::int64_t)dValue);
+				}
+				return true;
+			case ContentToken::kReal:
+				{
+					double dValue;
+					tokFirst.Get(dValue);
+					pValue = MemoryObject::MakeReal(dValue);
+				}
+				return true;
+			case ContentToken::kBoolean:
+				{
+					bool bValue;
+					tokFirst.Get(bValue);
+					pValue = MemoryObject::MakeBoolean(bValue);
+				}
+				return true;
+			case ContentToken::kNull:
+				pValue = MemoryObject::MakeNull();
+				return true;
+			case ContentToken::kName:
+				{
+					Name nmValue;
+					tokFirst.Get(nmValue);
+					pValue = MemoryObject::MakeName(nmValue);
+				}
+				return true;
+			case ContentToken::kString:
+			case ContentToken::kHexString:
+				{
+					std::string sValue;
+					tokFirst.Get(sValue);
+					pValue = MemoryObject::MakeString(sValue);
+				}
+				return true;
+			case ContentToken::kArrayBegin:
+				pValue = MemoryObject::MakeArray();
+				while (Next(tokCurrent) && tokCurrent.GetType() != ContentToken::kArrayEnd)  {
+					MemoryObjectPtr pElement;
+					Object::ID nElementRef;
+					if (!ParseValue(tokCurrent, pElement, nElementRef, nDepth + 1))  {
+						return false;
+					}
+					if (pElement)  {
+						pValue->Append(pElement);
+					} else  {
+						pValue->AppendReference(nElementRef);
+					}
+				}
+				return tokCurrent.GetType() == ContentToken::kArrayEnd;
+			case ContentToken::kDictBegin:
+				pValue = MemoryObject::MakeDict();
+				while (Next(tokCurrent) && tokCurrent.GetType() != ContentToken::kDictEnd)  {
+					Name nmKey;
+					MemoryObjectPtr pElement;
+					Object::ID nElementRef;
+					if (!tokCurrent.Get(nmKey) || !Next(tokCurrent) ||
+						!ParseValue(tokCurrent, pElement, nElementRef, nDepth + 1))
+					{
+						return false;
+					}
+					if (pElement)  {
+						pValue->Set(nmKey, pElement);
+					} else  {
+						pValue->SetReference(nmKey, nElementRef);
+					}
+				}
+				return tokCurrent.GetType() == ContentToken::kDictEnd;
+			default:
+				return false;
+		}
+	}
+
+	bool
+	ObjectParser::ParseStreamData(const ContentToken &tokStream, const MemoryObjectPtr &pDict,
+		std::string &sData)
+	{
+		size_t nStart = GetEnd(tokStream);
+		if (nStart < m_nLength && m_pData[nStart] == '\r')  {
+			++nStart;
+		}
+		if (nStart < m_nLength && m_pData[nStart] == '\n')  {
+			++nStart;
+		}
+
+		// /Length when it is direct and right, otherwise up to endstream
+		static const char szEnd[] = "endstream";
+		const size_t nEndLength = sizeof(szEnd) - 1;
+		boost::int64_t nLength;
+		size_t nEnd = 0;
+		if (pDict->Get(nLength, "Length") && nLength >= 0 &&
+			(boost::uint64_t)nLength <= m_nLength - nStart)
+		{
+			size_t nAfter = nStart + (size_t)nLength;
+			while (nAfter < m_nLength && strchr("\r\n \t", m_pData[nAfter]))  {
+				++nAfter;
+			}
+			if (nAfter + nEndLength <= m_nLength &&
+				memcmp(m_pData + nAfter, szEnd, nEndLength) == 0)
+			{
+				nEnd = nStart + (size_t)nLength;
+				Seek(nAfter + nEndLength);
+			}
+		}
+		if (!nEnd)  {
+			const char *pFound = std::search(m_pData + nStart, m_pData + m_nLength,
+				szEnd, szEnd + nEndLength);
+			if (pFound == m_pData + m_nLength)  {
+				return false;
+			}
+			nEnd = pFound - m_pData;
+			Seek(nEnd + nEndLength);
+			if (nEnd > nStart && m_pData[nEnd - 1] == '\n')  {
+				--nEnd;
+			}
+			if (nEnd > nStart && m_pData[nEnd - 1] == '\r')  {
+				--nEnd;
+			}
+		}
+		sData.assign(m_pData + nStart, nEnd - nStart);
+		return true;
+	}
+
+	void
+	ReportParseError(const MemoryDoc *pDoc, Object::ID nID)
+	{
+		ErrorRecord oError;
+		oError.m_szOperation = "Error parsing object";
+		oError.m_nID = nID;
+		Document::ReportError(pDoc, oError);
+	}
+
+	// the objects of an object stream, unless the file already had them
+	void
+	AddObjectStream(MemoryDoc &rDoc, const Object::Ptr &pStream, Object::ID nStream)
+	{
+		Object::Stream pData;
+		std::vector<char> vData;
+		int nCount, nFirst;
+		if (!pStream->Get(nCount, "N") || !pStream->Get(nFirst, "First") || nCount < 0 ||
+			nFirst < 0 || !pStream->Get(pData) || !ReadStreamData(pData, vData) ||
+			vData.empty() || (size_t)nFirst > vData.size())
+		{
+			ReportParseError(&rDoc, nStream);
+			return;
+		}
+
+		ObjectParser oParser(&vData[0], vData.size());
+		std::vector<std::pair<Object::ID, size_t> > vOffsets;
+		ContentToken tokID, tokOffset;
+		for (int i=0; i<nCount && oParser.Next(tokID) && oParser.Next(tokOffset); i++)  {
+			double dID, dOffset;
+			if (!tokID.Get(dID) || !tokOffset.Get(dOffset) || dOffset < 0 ||
+				dID < 0 || dID > MemoryDoc::kMaxID)
+			{
+				ReportParseError(&rDoc, nStream);
+				break;
+			}
+			vOffsets.push_back(std::make_pair((Object::ID)dID, (size_t)dOffset));
+		}
+
+		for (size_t i=0; i<vOffsets.size(); i++)  {
+			Object::Ptr pExisting;
+			if (rDoc.GetObject(vOffsets[i].first, pExisting))  {
+				continue;
+			}
+			ContentToken tokFirst;
+			MemoryObjectPtr pValue;
+			Object::ID nRef;
+			oParser.Seek(nFirst + vOffsets[i].second);
+			if (!oParser.Next(tokFirst) || !oParser.ParseValue(tokFirst, pValue, nRef) || !pValue)  {
+				ReportParseError(&rDoc, vOffsets[i].first);
+				continue;
+			}
+			rDoc.Add(pValue, vOffsets[i].first);
+		}
+	}
+
+}
+
+namespace PDFLibWrapper  {
+
+MemoryObject::MemoryObject(Type eType)
+: m_pDoc(NULL), m_nID(kInvalidID), m_bBoolean(false), m_nInteger(0), m_dReal(0)
+{
+	m_eType = eType;
+}
+
+MemoryObjectPtr
+MemoryObject::MakeNull()
+{
+	return MemoryObjectPtr(new MemoryObject(kNull));
+}
+
+MemoryObjectPtr
+MemoryObject::MakeBoolean(bool bValue)
+{
+	MemoryObjectPtr pNew(new MemoryObject(kBoolean));
+	pNew->m_bBoolean = bValue;
+	return pNew;
+}
+
+MemoryObjectPtr
+MemoryObject::MakeInteger(boost::int64_t nValue)
+{
+	MemoryObjectPtr pNew(new MemoryObject(kInteger));
+	pNew->m_nInteger = nValue;
+	return pNew;
+}
+
+MemoryObjectPtr
+MemoryObject::MakeReal(double dValue)
+{
+	MemoryObjectPtr pNew(new MemoryObject(kFixed));
+	pNew->m_dReal = dValue;
+	return pNew;
+}
+
+MemoryObjectPtr
+MemoryObject::MakeName(const Name &nmValue)
+{
+	MemoryObjectPtr pNew(new MemoryObject(kName));
+	pNew->m_nmName = nmValue;
+	return pNew;
+}
+
+MemoryObjectPtr
+MemoryObject::MakeString(const std::string &sValue)
+{
+	MemoryObjectPtr pNew(new MemoryObject(kString));
+	pNew->m_sData = sValue;
+	return pNew;
+}
+
+MemoryObjectPtr
+MemoryObject::MakeArray()
+{
+	return MemoryObjectPtr(new MemoryObject(kArray));
+}
+
+MemoryObjectPtr
+MemoryObject::MakeDict()
+{
+	return MemoryObjectPtr(new MemoryObject(kDict));
+}
+
+MemoryObjectPtr
+MemoryObject::MakeStream(const std::string &sData)
+{
+	MemoryObjectPtr pNew(new MemoryObject(kStream));
+	pNew->m_sData = sData;
+	return pNew;
+}
+
+void
+MemoryObject::Append(const MemoryObjectPtr &pValue)
+{
+	m_vElements.push_back(Element(pValue));
+	if (pValue)  {
+		pValue->SetDoc(m_pDoc);
+	}
+}
+
+void
+MemoryObject::AppendReference(ID nID)
+{
+	m_vElements.push_back(Element(MemoryObjectPtr(), nID));
+}
+
+void
+MemoryObject::Set(const Name &nmKey, const MemoryObjectPtr &pValue)
+{
+	m_mDict[nmKey] = Element(pValue);
+	if (pValue)  {
+		pValue->SetDoc(m_pDoc);
+	}
+}
+
+void
+MemoryObject::SetReference(const Name &nmKey, ID nID)
+{
+	m_mDict[nmKey] = Element(MemoryObjectPtr(), nID);
+}
+
+void
+MemoryObject::SetData(const std::string &sData)
+{
+	m_eType = kStream;
+	m_sData = sData;
+}
+
+void
+MemoryObject::SetDoc(MemoryDoc *pDoc)
+{
+	m_pDoc = pDoc;
+	for (size_t i=0; i<m_vElements.size(); i++)  {
+		if (m_vElements[i].m_pObject)  {
+			m_vElements[i].m_pObject->SetDoc(pDoc);
+		}
+	}
+	for (Dict::iterator it = m_mDict.begin(); it != m_mDict.end(); ++it)  {
+		if (it->second.m_pObject)  {
+			it->second.m_pObject->SetDoc(pDoc);
+		}
+	}
+}
+
+Document *
+MemoryObject::GetDoc() const
+{
+	return m_pDoc;
+}
+
+bool
+MemoryObject::IsIndirect() const
+{
+	return m_nID != kInvalidID;
+}
+
+Object::ID
+MemoryObject::GetID() const
+{
+	return m_nID;
+}
+
+int
+MemoryObject::GetLength() const
+{
+	return m_eType == kArray ? (int)m_vElements.size() : 1;
+}
+
+bool
+MemoryObject::GetKeys(NameSet &setKeys)
+{
+	if (m_eType != kDict && m_eType != kStream)  {
+		return false;
+	}
+	for (Dict::const_iterator it = m_mDict.begin(); it != m_mDict.end(); ++it)  {
+		setKeys.insert(it->first);
+	}
+	return true;
+}
+
+bool
+MemoryObject::GetReferences(std::vector<ID> &vIDs)
+{
+	for (size_t i=0; i<m_vElements.size(); i++)  {
+		if (m_vElements[i].m_pObject)  {
+			m_vElements[i].m_pObject->GetReferences(vIDs);
+		} else  {
+			vIDs.push_back(m_vElements[i].m_nRef);
+		}
+	}
+	for (Dict::const_iterator it = m_mDict.begin(); it != m_mDict.end(); ++it)  {
+		if (it->second.m_pObject)  {
+			it->second.m_pObject->GetReferences(vIDs);
+		} else  {
+			vIDs.push_back(it->second.m_nRef);
+		}
+	}
+	return true;
+}
+
+bool
+MemoryObject::GetEncoded(Stream &oValue)
+{
+	if (m_eType != kStream)  {
+		return false;
+	}
+	oValue.reset(new std::istringstream(m_sData));
+	return true;
+}
+
+bool
+MemoryObject::HasKey(const Name &nmKey)
+{
+	return m_mDict.find(nmKey) != m_mDict.end();
+}
+
+bool
+MemoryObject::HasKey(const char *szKey)
+{
+	return HasKey(Name(szKey));
+}
+
+bool
+MemoryObject::Resolve(const Element &rElement, Object::Ptr &pValue) const
+{
+	if (rElement.m_pObject)  {
+		pValue = rElement.m_pObject;
+		return true;
+	}
+	return m_pDoc && m_pDoc->GetObject(rElement.m_nRef, pValue);
+}
+
+void
+MemoryObject::ExtractElement(const Element &rElement, Value &rValue) const
+{
+	const MemoryObjectPtr *ppValue = &rElement.m_pObject;
+	Object::Ptr pResolved;
+	MemoryObjectPtr pResolvedMemory;
+	if (!*ppValue)  {
+		if (!Resolve(rElement, pResolved) || !pResolved)  {
+			rValue.m_eType = kUnknown;
+			rValue.m_pObject.reset();
+			return;
+		}
+		pResolvedMemory = boost::static_pointer_cast<MemoryObject>(pResolved);
+		ppValue = &pResolvedMemory;
+	}
+
+	const MemoryObject &rObject = **ppValue;
+	rValue.m_eType = rObject.m_eType;
+	switch (rObject.m_eType)  {
+		case kBoolean:
+			rValue.m_bBoolean = rObject.m_bBoolean;
+			break;
+		case kInteger:
+			rValue.m_nInteger = rObject.m_nInteger;
+			break;
+		case kFixed:
+			rValue.m_dReal = rObject.m_dReal;
+			break;
+		case kName:
+			rValue.m_nmName = rObject.m_nmName;
+			break;
+		case kString:
+			rValue.m_sString = rObject.m_sData;
+			break;
+		case kArray:
+		case kDict:
+		case kStream:
+			rValue.m_pObject = *ppValue;
+			return;
+		default:
+			break;
+	}
+	rValue.m_pObject.reset();
+}
+
+bool
+MemoryObject::ExtractElements(std::vector<Value> &vValues)
+{
+	if (m_eType != kArray)  {
+		return false;
+	}
+	vValues.resize(m_vElements.size());
+	for (size_t i=0; i<m_vElements.size(); i++)  {
+		ExtractElement(m_vElements[i], vValues[i]);
+	}
+	return true;
+}
+
+bool
+MemoryObject::ExtractEntries(std::vector<Entry> &vEntries)
+{
+	if (m_eType != kDict && m_eType != kStream)  {
+		return false;
+	}
+	vEntries.resize(m_mDict.size());
+	std::vector<Entry>::iterator itEntry = vEntries.begin();
+	for (Dict::const_iterator it = m_mDict.begin(); it != m_mDict.end(); ++it, ++itEntry)  {
+		itEntry->m_nmKey = it->first;
+		ExtractElement(it->second, itEntry->m_oValue);
+	}
+	return true;
+}
+
+bool
+MemoryObject::GetElement(int nIndex, Object::Ptr &pValue)
+{
+	if (m_eType == kArray)  {
+		return nIndex >= 0 && (size_t)nIndex < m_vElements.size() &&
+			Resolve(m_vElements[nIndex], pValue);
+	}
+	if (nIndex != 0)  {
+		return false;
+	}
+	pValue = shared_from_this();
+	return true;
+}
+
+bool
+MemoryObject::GetValue(const Name &nmKey, Object::Ptr &pValue)
+{
+	Dict::const_iterator itFind = m_mDict.find(nmKey);
+	return itFind != m_mDict.end() && Resolve(itFind->second, pValue);
+}
+
+bool
+MemoryObject::GetOwn(bool &bValue)
+{
+	if (m_eType != kBoolean)  {
+		return false;
+	}
+	bValue = m_bBoolean;
+	return true;
+}
+
+bool
+MemoryObject::GetOwn(int &nValue)
+{
+	if (m_eType != kInteger || m_nInteger < boost::integer_traits<int>::const_min ||
+		m_nInteger > boost::integer_traits<int>::const_max)
+	{
+		return false;
+	}
+	nValue = (int)m_nInteger;
+	return true;
+}
+
+bool
+MemoryObject::GetOwn(unsigned int &nValue)
+{
+	if (m_eType != kInteger || m_nInteger < 0 ||
+		m_nInteger > boost::integer_traits<int>::const_max)
+	{
+		return false;
+	}
+	nValue = (unsigned int)m_nInteger;
+	return true;
+}
+
+bool
+MemoryObject::GetOwn(float &fValue)
+{
+	if (m_eType != kFixed)  {
+		return false;
+	}
+	fValue = (float)m_dReal;
+	return true;
+}
+
+bool
+MemoryObject::GetOwn(double &dValue)
+{
+	if (m_eType != kFixed)  {
+		return false;
+	}
+	dValue = m_dReal;
+	return true;
+}
+
+bool
+MemoryObject::GetOwn(Name &rValue)
+{
+	if (m_eType != kName)  {
+		return false;
+	}
+	rValue = m_nmName;
+	return rValue.IsValid();
+}
+
+bool
+MemoryObject::GetOwn(std::string &sValue)
+{
+	if (m_eType != kString)  {
+		return false;
+	}
+	sValue = m_sData;
+	return true;
+}
+
+bool
+MemoryObject::GetOwn(Object::Ptr &pValue)
+{
+	pValue = shared_from_this();
+	return true;
+}
+
+bool
+MemoryObject::GetOwn(Buffer &)
+{
+	// as with PDFL, there is no way to pass the length
+	return false;
+}
+
+bool
+MemoryObject::GetOwn(Stream &oValue)
+{
+	if (m_eType != kStream)  {
+		return false;
+	}
+	if (!HasKey("Filter"))  {
+		oValue.reset(new std::istringstream(m_sData));
+		return true;
+	}
+	FilterChain vChain;
+	size_t nApplied;
+	std::vector<char> vData(m_sData.begin(), m_sData.end());
+	if (!GetFilterChain(shared_from_this(), vChain) ||
+		DecodeFilters(vChain, vData, nApplied) != kDecodeComplete)
+	{
+		return false;
+	}
+	oValue.reset(new std::istringstream(std::string(vData.begin(), vData.end())));
+	return true;
+}
+
+bool
+MemoryObject::GetOwn(boost::int64_t &nValue)
+{
+	if (m_eType == kInteger)  {
+		nValue = m_nInteger;
+		return true;
+	}
+	// integral reals, as Object::Get accepts them
+	if (m_eType == kFixed && m_dReal == (double)(boost::int64_t)m_dReal)  {
+		nValue = (boost::int64_t)m_dReal;
+		return true;
+	}
+	return false;
+}
+
+bool
+MemoryObject::GetOwnElement(double &dValue)
+{
+	if (m_eType == kInteger)  {
+		dValue = (double)m_nInteger;
+		return true;
+	}
+	return GetOwn(dValue);
+}
+
+template <class T>
+bool
+MemoryObject::GetEach(T *pValues, size_t nMaxCount, size_t &nCount)
+{
+	size_t nLength = GetLength();
+	Object::Ptr pResolved;
+	for (nCount=0; nCount<nLength && nCount<nMaxCount; nCount++)  {
+		MemoryObject *pElement = this;
+		if (m_eType == kArray)  {
+			// direct elements without touching their reference counts
+			const Element &rElement = m_vElements[nCount];
+			pElement = rElement.m_pObject.get();
+			if (!pElement)  {
+				if (!Resolve(rElement, pResolved) || !pResolved)  {
+					return false;
+				}
+				pElement = static_cast<MemoryObject *>(pResolved.get());
+			}
+		}
+		if (!pElement->GetOwnElement(pValues[nCount]))  {
+			return false;
+		}
+	}
+	return nLength <= nMaxCount;
+}
+
+bool
+MemoryObject::GetElements(int *pValues, size_t nMaxCount, size_t &nCount)
+{
+	return GetEach(pValues, nMaxCount, nCount);
+}
+
+bool
+MemoryObject::GetElements(double *pValues, size_t nMaxCount, size_t &nCount)
+{
+	return GetEach(pValues, nMaxCount, nCount);
+}
+
+bool
+MemoryObject::GetElements(Name *pValues, size_t nMaxCount, size_t &nCount)
+{
+	return GetEach(pValues, nMaxCount, nCount);
+}
+
+template <class T>
+bool
+MemoryObject::GetAt(T &rValue, int nIndex)
+{
+	Object::Ptr pElement;
+	return GetElement(nIndex, pElement) &&
+		static_cast<MemoryObject *>(pElement.get())->GetOwn(rValue);
+}
+
+template <class T>
+bool
+MemoryObject::GetFor(T &rValue, const Name &nmKey)
+{
+	Object::Ptr pElement;
+	return GetValue(nmKey, pElement) &&
+		static_cast<MemoryObject *>(pElement.get())->GetOwn(rValue);
+}
+
+bool MemoryObject::Get(bool &bValue, int nIndex)  { return GetAt(bValue, nIndex); }
+bool MemoryObject::Get(int &nValue, int nIndex)  { return GetAt(nValue, nIndex); }
+bool MemoryObject::Get(unsigned int &nValue, int nIndex)  { return GetAt(nValue, nIndex); }
+bool MemoryObject::Get(float &fValue, int nIndex)  { return GetAt(fValue, nIndex); }
+bool MemoryObject::Get(double &dValue, int nIndex)  { return GetAt(dValue, nIndex); }
+bool MemoryObject::Get(Name &rValue, int nIndex)  { return GetAt(rValue, nIndex); }
+bool MemoryObject::Get(std::string &sValue, int nIndex)  { return GetAt(sValue, nIndex); }
+bool MemoryObject::Get(Object::Ptr &pValue, int nIndex)  { return GetElement(nIndex, pValue); }
+bool MemoryObject::Get(Buffer &oValue, int nIndex)  { return GetAt(oValue, nIndex); }
+bool MemoryObject::Get(Stream &oValue, int nIndex)  { return GetAt(oValue, nIndex); }
+bool MemoryObject::Get(boost::int64_t &nValue, int nIndex)  { return GetAt(nValue, nIndex); }
+
+bool MemoryObject::Get(bool &bValue, const char *szKey)  { return GetFor(bValue, Name(szKey)); }
+bool MemoryObject::Get(int &nValue, const char *szKey)  { return GetFor(nValue, Name(szKey)); }
+bool MemoryObject::Get(unsigned int &nValue, const char *szKey)  { return GetFor(nValue, Name(szKey)); }
+bool MemoryObject::Get(float &fValue, const char *szKey)  { return GetFor(fValue, Name(szKey)); }
+bool MemoryObject::Get(double &dValue, const char *szKey)  { return GetFor(dValue, Name(szKey)); }
+bool MemoryObject::Get(Name &rValue, const char *szKey)  { return GetFor(rValue, Name(szKey)); }
+bool MemoryObject::Get(std::string &sValue, const char *szKey)  { return GetFor(sValue, Name(szKey)); }
+bool MemoryObject::Get(Object::Ptr &pValue, const char *szKey)  { return GetValue(Name(szKey), pValue); }
+bool MemoryObject::Get(Buffer &oValue, const char *szKey)  { return GetFor(oValue, Name(szKey)); }
+bool MemoryObject::Get(Stream &oValue, const char *szKey)  { return GetFor(oValue, Name(szKey)); }
+bool MemoryObject::Get(boost::int64_t &nValue, const char *szKey)  { return GetFor(nValue, Name(szKey)); }
+
+bool MemoryObject::Get(bool &bValue, const Name &nmKey)  { return GetFor(bValue, nmKey); }
+bool MemoryObject::Get(int &nValue, const Name &nmKey)  { return GetFor(nValue, nmKey); }
+bool MemoryObject::Get(unsigned int &nValue, const Name &nmKey)  { return GetFor(nValue, nmKey); }
+bool MemoryObject::Get(float &fValue, const Name &nmKey)  { return GetFor(fValue, nmKey); }
+bool MemoryObject::Get(double &dValue, const Name &nmKey)  { return GetFor(dValue, nmKey); }
+bool MemoryObject::Get(Name &rValue, const Name &nmKey)  { return GetFor(rValue, nmKey); }
+bool MemoryObject::Get(std::string &sValue, const Name &nmKey)  { return GetFor(sValue, nmKey); }
+bool MemoryObject::Get(Object::Ptr &pValue, const Name &nmKey)  { return GetValue(nmKey, pValue); }
+bool MemoryObject::Get(Buffer &oValue, const Name &nmKey)  { return GetFor(oValue, nmKey); }
+bool MemoryObject::Get(Stream &oValue, const Name &nmKey)  { return GetFor(oValue, nmKey); }
+bool MemoryObject::Get(boost::int64_t &nValue, const Name &nmKey)  { return GetFor(nValue, nmKey); }
+
+
+MemoryDoc::MemoryDoc()
+: Document(""), m_oVersion(1, 7)
+{
+}
+
+Object::ID
+MemoryDoc::Add(const MemoryObjectPtr &pObject, Object::ID nID /*= Object::kInvalidID*/)
+{
+	if (nID == Object::kInvalidID)  {
+		nID = 1;
+		while ((size_t)nID < m_vObjects.size() && m_vObjects[nID])  {
+			++nID;
+		}
+	}
+	if (nID < 0 || nID > kMaxID || !pObject)  {
+		return Object::kInvalidID;
+	}
+	if ((size_t)nID >= m_vObjects.size())  {
+		m_vObjects.resize(nID + 1);
+	}
+	m_vObjects[nID] = pObject;
+	pObject->m_nID = nID;
+	pObject->SetDoc(this);
+	return nID;
+}
+
+void
+MemoryDoc::SetCatalog(Object::ID nID)
+{
+	if (!m_pTrailer)  {
+		SetTrailer(MemoryObject::MakeDict());
+	}
+	m_pTrailer->SetReference("Root", nID);
+}
+
+void
+MemoryDoc::SetTrailer(const MemoryObjectPtr &pTrailer)
+{
+	m_pTrailer = pTrailer;
+	if (m_pTrailer)  {
+		m_pTrailer->SetDoc(this);
+	}
+}
+
+void
+MemoryDoc::SetVersion(const PDFVersion &oVersion)
+{
+	m_oVersion = oVersion;
+}
+
+bool
+MemoryDoc::Parse(const char *pData, size_t nLength)
+{
+	int nMajor, nMinor;
+	if (nLength >= 8 && memcmp(pData, "%PDF-", 5) == 0 &&
+		sscanf(std::string(pData + 5, (std::min)(nLength - 5, (size_t)8)).c_str(), "%d.%d",
+			&nMajor, &nMinor) == 2)
+	{
+		SetVersion(PDFVersion((unsigned short)nMajor, (unsigned short)nMinor));
+	}
+
+	ObjectParser oParser(pData, nLength);
+	std::vector<Object::ID> vObjectStreams;
+	ContentToken tokCurrent, tokNext, tokKeyword;
+	while (oParser.Next(tokCurrent))  {
+		if (tokCurrent.Is("trailer"))  {
+			MemoryObjectPtr pTrailer;
+			Object::ID nRef;
+			// of several trailers, the one of the latest update
+			if (oParser.Next(tokNext) && oParser.ParseValue(tokNext, pTrailer, nRef) &&
+				pTrailer && pTrailer->GetType() == Object::kDict)
+			{
+				SetTrailer(pTrailer);
+			}
+			continue;
+		}
+		if (tokCurrent.GetType() != ContentToken::kInteger)  {
+			continue;
+		}
+
+		// n g obj
+		if (!oParser.Next(tokNext))  {
+			break;
+		}
+		if (tokNext.GetType() != ContentToken::kInteger)  {
+			oParser.PushBack(tokNext);
+			continue;
+		}
+		if (!oParser.Next(tokKeyword))  {
+			break;
+		}
+		if (!tokKeyword.Is("obj"))  {
+			oParser.PushBack(tokKeyword);
+			oParser.PushBack(tokNext);
+			continue;
+		}
+
+		double dID;
+		tokCurrent.Get(dID);
+		Object::ID nID = ToObjectID(dID);
+		MemoryObjectPtr pValue;
+		Object::ID nRef;
+		if (!oParser.Next(tokCurrent) || !oParser.ParseValue(tokCurrent, pValue, nRef) || !pValue)  {
+			ReportParseError(this, nID);
+			continue;
+		}
+		if (oParser.Next(tokCurrent))  {
+			if (tokCurrent.Is("stream") && pValue->GetType() == Object::kDict)  {
+				std::string sData;
+				if (!oParser.ParseStreamData(tokCurrent, pValue, sData))  {
+					ReportParseError(this, nID);
+					continue;
+				}
+				pValue->SetData(sData);
+			} else if (!tokCurrent.Is("endobj"))  {
+				oParser.PushBack(tokCurrent);
+			}
+		}
+		if (nID == Object::kInvalidID || Add(pValue, nID) == Object::kInvalidID)  {
+			ReportParseError(this, nID);
+			continue;
+		}
+
+		Name nmType;
+		if (pValue->GetType() == Object::kStream && pValue->Get(nmType, "Type") &&
+			nmType == Name("ObjStm"))
+		{
+			vObjectStreams.push_back(nID);
+		}
+	}
+
+	for (size_t i=0; i<vObjectStreams.size(); i++)  {
+		AddObjectStream(*this, m_vObjects[vObjectStreams[i]], vObjectStreams[i]);
+	}
+
+	// files with only an xref stream have their trailer in it
+	if (!m_pTrailer)  {
+		for (size_t i=m_vObjects.size(); i-- > 0; )  {
+			Name nmType;
+			if (m_vObjects[i] && m_vObjects[i]->GetType() == Object::kStream &&
+				m_vObjects[i]->Get(nmType, "Type") && nmType == Name("XRef"))
+			{
+				SetTrailer(m_vObjects[i]);
+				break;
+			}
+		}
+	}
+	return IsValid();
+}
+
+bool
+MemoryDoc::IsValid() const
+{
+	Object::Ptr pCatalog;
+	return GetCatalog(pCatalog);
+}
+
+PDFVersion
+MemoryDoc::GetVersion() const
+{
+	return m_oVersion;
+}
+
+bool
+MemoryDoc::GetTrailer(Object::Ptr &pTrailer) const
+{
+	if (!m_pTrailer)  {
+		return false;
+	}
+	pTrailer = m_pTrailer;
+	return true;
+}
+
+bool
+MemoryDoc::GetCatalog(Object::Ptr &pCatalog) const
+{
+	return m_pTrailer && m_pTrailer->Get(pCatalog, "Root") && pCatalog &&
+		pCatalog->GetType() == Object::kDict;
+}
+
+bool
+MemoryDoc::GetObject(Object::ID nID, Object::Ptr &pObject) const
+{
+	if (nID < 0 || (size_t)nID >= m_vObjects.size() || !m_vObjects[nID])  {
+		return false;
+	}
+	pObject = m_vObjects[nID];
+	return true;
+}
+
+Document *
+MemoryDoc::clone() const
+{
+	return new MemoryDoc;
+}
+
+Document::Ptr
+MemoryDoc::ClonePtr() const
+{
+	Document::Ptr pRet(clone());
+	return pRet;
+}
+
+bool
+MemoryDoc::OpenFile(const std::string &sFileName)
+{
+	std::ifstream is(sFileName.c_str(), std::ios_base::in | std::ios_base::binary);
+	if (!is)  {
+		return false;
+	}
+	std::string sData((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+	return Parse(sData.data(), sData.size());
+}
+
+bool
+MemoryDoc::OpenReader(const Reader::Ptr &pReader)
+{
+	boost::int64_t nSize = pReader->GetSize();
+	if (nSize < 0 || (boost::uint64_t)nSize > (std::numeric_limits<size_t>::max)())  {
+		return false;
+	}
+	std::vector<char> vData((size_t)nSize);
+	if (nSize > 0 && pReader->ReadAt(0, &vData[0], vData.size()) != vData.size())  {
+		return false;
+	}
+	return Parse(vData.empty() ? "" : &vData[0], vData.size());
+}
+
+#ifdef PDFLIB_NO_PDFL
+// without the PDF Library, documents are opened with this backend
+bool
+Document::AutoRegister()
+{
+	return Document::Register("Memory", Document::Ptr(new MemoryDoc));
+}
+#endif
+
+}
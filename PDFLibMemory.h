@@ -0,0 +1,211 @@
+/*
+ *  PDFLibMemory.h
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#ifndef APAGO_PDFLibMemory_h__
+#define APAGO_PDFLibMemory_h__
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "PDFLibWrapper.h"
+
+namespace PDFLibWrapper  {
+
+	// A backend holding its objects in memory, without any PDF library
+	// behind it:  for measuring and testing the abstract layer on its own.
+	// Documents are built object by object, or parsed from PDF object
+	// syntax.  Once built they are only read, so any number of threads can
+	// share one.  Register it with
+	//     Document::Register("Memory", Document::Ptr(new MemoryDoc));
+	// and select it with Document::SelectBackend to have Document::Open
+	// parse files with it.
+
+	class MemoryDoc;
+	class MemoryObject;
+	typedef boost::shared_ptr<MemoryObject> MemoryObjectPtr;
+
+	class MemoryObject : public Object, public boost::enable_shared_from_this<MemoryObject>  {
+	public:
+		static MemoryObjectPtr MakeNull();
+		static MemoryObjectPtr MakeBoolean(bool bValue);
+		static MemoryObjectPtr MakeInteger(boost::int64_t nValue);
+		static MemoryObjectPtr MakeReal(double dValue);
+		static MemoryObjectPtr MakeName(const Name &nmValue);
+		static MemoryObjectPtr MakeString(const std::string &sValue);
+		static MemoryObjectPtr MakeArray();
+		static MemoryObjectPtr MakeDict();
+		// sData as stored, that is still encoded with the /Filter set on it
+		static MemoryObjectPtr MakeStream(const std::string &sData);
+
+		// arrays
+		void Append(const MemoryObjectPtr &pValue);
+		void AppendReference(ID nID);
+		// dictionaries and streams
+		void Set(const Name &nmKey, const MemoryObjectPtr &pValue);
+		void SetReference(const Name &nmKey, ID nID);
+		// turns a dictionary into a stream
+		void SetData(const std::string &sData);
+
+		virtual Document *GetDoc() const;
+
+		virtual bool IsIndirect() const;
+		virtual ID GetID() const;
+
+		virtual int GetLength() const;
+
+		virtual bool GetKeys(NameSet &setKeys);
+		virtual bool GetReferences(std::vector<ID> &vIDs);
+		virtual bool GetEncoded(Stream &oValue);
+		virtual bool GetElements(int *pValues, size_t nMaxCount, size_t &nCount);
+		virtual bool GetElements(double *pValues, size_t nMaxCount, size_t &nCount);
+		virtual bool GetElements(Name *pValues, size_t nMaxCount, size_t &nCount);
+		virtual bool ExtractElements(std::vector<Value> &vValues);
+		virtual bool ExtractEntries(std::vector<Entry> &vEntries);
+		virtual bool HasKey(const Name &nmKey);
+		virtual bool HasKey(const char *szKey);
+		using Object::HasKey;
+
+		using Object::Get;
+		virtual bool Get(bool &bValue, int nIndex = 0);
+		virtual bool Get(int &nValue, int nIndex = 0);
+		virtual bool Get(unsigned int &nValue, int nIndex = 0);
+		virtual bool Get(float &fValue, int nIndex = 0);
+		virtual bool Get(double &dValue, int nIndex = 0);
+		virtual bool Get(Name &rValue, int nIndex = 0);
+		virtual bool Get(std::string &sValue, int nIndex = 0);
+		virtual bool Get(Object::Ptr &pValue, int nIndex = 0);
+		virtual bool Get(Buffer &oValue, int nIndex = 0);
+		virtual bool Get(Stream &oValue, int nIndex = 0);
+		virtual bool Get(boost::int64_t &nValue, int nIndex = 0);
+		virtual bool Get(bool &bValue, const char *szKey);
+		virtual bool Get(int &nValue, const char *szKey);
+		virtual bool Get(unsigned int &nValue, const char *szKey);
+		virtual bool Get(float &fValue, const char *szKey);
+		virtual bool Get(double &dValue, const char *szKey);
+		virtual bool Get(Name &rValue, const char *szKey);
+		virtual bool Get(std::string &sValue, const char *szKey);
+		virtual bool Get(Object::Ptr &pValue, const char *szKey);
+		virtual bool Get(Buffer &oValue, const char *szKey);
+		virtual bool Get(Stream &oValue, const char *szKey);
+		virtual bool Get(boost::int64_t &nValue, const char *szKey);
+		virtual bool Get(bool &bValue, const Name &nmKey);
+		virtual bool Get(int &nValue, const Name &nmKey);
+		virtual bool Get(unsigned int &nValue, const Name &nmKey);
+		virtual bool Get(float &fValue, const Name &nmKey);
+		virtual bool Get(double &dValue, const Name &nmKey);
+		virtual bool Get(Name &rValue, const Name &nmKey);
+		virtual bool Get(std::string &sValue, const Name &nmKey);
+		virtual bool Get(Object::Ptr &pValue, const Name &nmKey);
+		virtual bool Get(Buffer &oValue, const Name &nmKey);
+		virtual bool Get(Stream &oValue, const Name &nmKey);
+		virtual bool Get(boost::int64_t &nValue, const Name &nmKey);
+
+	private:
+		explicit MemoryObject(Type eType);
+
+		// a direct object, or a reference to an indirect one
+		struct Element  {
+			Element(const MemoryObjectPtr &pObject = MemoryObjectPtr(), ID nRef = kInvalidID)
+				: m_pObject(pObject), m_nRef(nRef)
+			{ }
+
+			MemoryObjectPtr m_pObject;
+			ID m_nRef;
+		};
+		typedef std::map<Name, Element> Dict;
+
+		void SetDoc(MemoryDoc *pDoc);
+		bool Resolve(const Element &rElement, Object::Ptr &pValue) const;
+		void ExtractElement(const Element &rElement, Value &rValue) const;
+		bool GetElement(int nIndex, Object::Ptr &pValue);
+		bool GetValue(const Name &nmKey, Object::Ptr &pValue);
+
+		// the value of the object itself
+		bool GetOwn(bool &bValue);
+		bool GetOwn(int &nValue);
+		bool GetOwn(unsigned int &nValue);
+		bool GetOwn(float &fValue);
+		bool GetOwn(double &dValue);
+		bool GetOwn(Name &rValue);
+		bool GetOwn(std::string &sValue);
+		bool GetOwn(Object::Ptr &pValue);
+		bool GetOwn(Buffer &oValue);
+		bool GetOwn(Stream &oValue);
+		bool GetOwn(boost::int64_t &nValue);
+
+		// as an element of GetElements
+		bool GetOwnElement(int &nValue)  { return GetOwn(nValue); }
+		bool GetOwnElement(double &dValue);
+		bool GetOwnElement(Name &rValue)  { return GetOwn(rValue); }
+
+		template <class T> bool GetAt(T &rValue, int nIndex);
+		template <class T> bool GetFor(T &rValue, const Name &nmKey);
+		template <class T> bool GetEach(T *pValues, size_t nMaxCount, size_t &nCount);
+
+		MemoryDoc *m_pDoc;
+		ID m_nID;
+		bool m_bBoolean;
+		boost::int64_t m_nInteger;
+		double m_dReal;
+		Name m_nmName;
+		// of strings and streams
+		std::string m_sData;
+		std::vector<Element> m_vElements;
+		Dict m_mDict;
+
+		friend class MemoryDoc;
+	};
+
+	class MemoryDoc : public Document  {
+	public:
+		MemoryDoc();
+
+		// the highest object number of a PDF file, see the implementation
+		// limits of the PDF Reference
+		enum  { kMaxID = 8388607 };
+
+		// under nID, or the lowest ID not yet used; replaces any object
+		// already there.  kInvalidID if nID is above kMaxID.
+		Object::ID Add(const MemoryObjectPtr &pObject, Object::ID nID = Object::kInvalidID);
+		// also sets the /Root of the trailer
+		void SetCatalog(Object::ID nID);
+		void SetTrailer(const MemoryObjectPtr &pTrailer);
+		void SetVersion(const PDFVersion &oVersion);
+
+		// Reads "n 0 obj ... endobj" sections in PDF syntax, including
+		// streams and the objects of object streams, and a trailer whose
+		// /Root is the catalog.  Anything else is skipped, so PDF files
+		// without xref streams or encryption load as they are.
+		bool Parse(const char *pData, size_t nLength);
+
+		virtual bool IsValid() const;
+
+		virtual PDFVersion GetVersion() const;
+		virtual bool GetTrailer(Object::Ptr &pTrailer) const;
+		virtual bool GetCatalog(Object::Ptr &pCatalog) const;
+
+		virtual bool GetObject(Object::ID nID, Object::Ptr &pObject) const;
+
+	protected:
+		virtual Document *clone() const;
+		virtual Document::Ptr ClonePtr() const;
+		virtual bool OpenFile(const std::string &sFileName);
+		virtual bool OpenReader(const Reader::Ptr &pReader);
+
+	private:
+		std::vector<MemoryObjectPtr> m_vObjects;
+		MemoryObjectPtr m_pTrailer;
+		PDFVersion m_oVersion;
+	};
+
+}
+
+#endif // APAGO_PDFLibMemory_h__
@@ -0,0 +1,334 @@
+/*
+ *  PDFLibParallel.cpp
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#include <deque>
+
+#include <boost/bind/bind.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include "PDFLibParallel.h"
+
+
+namespace  {
+
+	using namespace PDFLibWrapper;
+
+	typedef boost::mutex Mutex;
+	typedef boost::unique_lock<Mutex> Lock;
+
+	struct WorkerSlot  {
+		WorkerSlot(const ThreadPool::Impl *pPool, int nIndex)
+			: m_pPool(pPool), m_nIndex(nIndex)
+		{ }
+		const ThreadPool::Impl *m_pPool;
+		int m_nIndex;
+	};
+	boost::thread_specific_ptr<WorkerSlot> g_pWorkerSlot;
+
+	// completion state of one ForEachPage call, so that several callers can
+	// share a pool without waiting for each other's pages
+	struct PageBatch  {
+		PageBatch(const Document::Ptr &pDoc, const PageFunction &fnPage,
+			int nPages, unsigned int nThreads)
+			: m_pDoc(pDoc), m_fnPage(fnPage), m_nRemaining(nPages),
+			  m_bFailed(false), m_vDocs(nThreads)
+		{
+			if (!m_vDocs.empty())  {
+				m_vDocs[0] = pDoc;
+			}
+		}
+
+		Document::Ptr GetWorkerDoc()  {
+			int nWorker = ThreadPool::GetWorkerIndex();
+			if (nWorker < 0 || nWorker >= (int)m_vDocs.size())  {
+				return m_pDoc;
+			}
+			// only this worker touches its slot, so no locking is needed
+			if (!m_vDocs[nWorker])  {
+				m_vDocs[nWorker] = m_pDoc->Reopen();
+			}
+			return m_vDocs[nWorker];
+		}
+
+		void RunPage(int nIndex)  {
+			try  {
+				Document::Ptr pDoc = GetWorkerDoc();
+				Object::Ptr pPage;
+				if (pDoc && pDoc->GetPage(nIndex, pPage))  {
+					m_fnPage(PageView(nIndex, pDoc, pPage));
+				} else  {
+					Lock lck(m_mtx);
+					m_bFailed = true;
+				}
+			} catch (...)  {
+				Lock lck(m_mtx);
+				if (!m_pException)  {
+					m_pException = boost::current_exception();
+				}
+			}
+			Lock lck(m_mtx);
+			if (--m_nRemaining == 0)  {
+				m_cvDone.notify_all();
+			}
+		}
+
+		bool Wait()  {
+			Lock lck(m_mtx);
+			while (m_nRemaining > 0)  {
+				m_cvDone.wait(lck);
+			}
+			if (m_pException)  {
+				boost::rethrow_exception(m_pException);
+			}
+			return !m_bFailed;
+		}
+
+		Document::Ptr m_pDoc;
+		PageFunction m_fnPage;
+		Mutex m_mtx;
+		boost::condition_variable m_cvDone;
+		int m_nRemaining;
+		bool m_bFailed;
+		boost::exception_ptr m_pException;
+		std::vector<Document::Ptr> m_vDocs;
+	};
+
+}
+
+namespace PDFLibWrapper  {
+
+struct ThreadPool::Impl  {
+	struct Queue  {
+		Mutex m_mtx;
+		std::deque<Task> m_dqTasks;
+	};
+
+	Impl(unsigned int nThreads);
+	~Impl();
+
+	void Push(const Task &fnTask);
+	bool Pop(unsigned int nWorker, Task &fnTask);
+	void Run(unsigned int nWorker);
+	void Wait();
+
+	boost::ptr_vector<Queue> m_vQueues;
+	boost::thread_group m_grpThreads;
+
+	Mutex m_mtxState;
+	boost::condition_variable m_cvWork;
+	boost::condition_variable m_cvIdle;
+	size_t m_nQueued;
+	size_t m_nPending;
+	size_t m_nNextQueue;
+	bool m_bStopping;
+	boost::exception_ptr m_pException;
+};
+
+ThreadPool::Impl::Impl(unsigned int nThreads)
+: m_nQueued(0), m_nPending(0), m_nNextQueue(0), m_bStopping(false)
+{
+	for (unsigned int i=0; i<nThreads; i++)  {
+		m_vQueues.push_back(new Queue);
+	}
+	for (unsigned int i=0; i<nThreads; i++)  {
+		m_grpThreads.create_thread(boost::bind(&Impl::Run, this, i));
+	}
+}
+
+ThreadPool::Impl::~Impl()
+{
+	{
+		Lock lck(m_mtxState);
+		m_bStopping = true;
+	}
+	m_cvWork.notify_all();
+	m_grpThreads.join_all();
+}
+
+void
+ThreadPool::Impl::Push(const Task &fnTask)
+{
+	size_t nQueue;
+	WorkerSlot *pSlot = g_pWorkerSlot.get();
+	if (pSlot && pSlot->m_pPool == this)  {
+		nQueue = pSlot->m_nIndex;
+	} else  {
+		Lock lck(m_mtxState);
+		nQueue = m_nNextQueue++ % m_vQueues.size();
+	}
+	{
+		Lock lck(m_vQueues[nQueue].m_mtx);
+		m_vQueues[nQueue].m_dqTasks.push_back(fnTask);
+	}
+	{
+		Lock lck(m_mtxState);
+		++m_nQueued;
+		++m_nPending;
+	}
+	m_cvWork.notify_one();
+}
+
+bool
+ThreadPool::Impl::Pop(unsigned int nWorker, Task &fnTask)
+{
+	{
+		Queue &rOwn = m_vQueues[nWorker];
+		Lock lck(rOwn.m_mtx);
+		if (!rOwn.m_dqTasks.empty())  {
+			fnTask.swap(rOwn.m_dqTasks.back());
+			rOwn.m_dqTasks.pop_back();
+			return true;
+		}
+	}
+	for (size_t i=1; i<m_vQueues.size(); i++)  {
+		Queue &rVictim = m_vQueues[(nWorker + i) % m_vQueues.size()];
+		Lock lck(rVictim.m_mtx);
+		if (!rVictim.m_dqTasks.empty())  {
+			fnTask.swap(rVictim.m_dqTasks.front());
+			rVictim.m_dqTasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void
+ThreadPool::Impl::Run(unsigned int nWorker)
+{
+	g_pWorkerSlot.reset(new WorkerSlot(this, nWorker));
+
+	Task fnTask;
+	while (true)  {
+		if (Pop(nWorker, fnTask))  {
+			{
+				Lock lck(m_mtxState);
+				--m_nQueued;
+			}
+			try  {
+				fnTask();
+			} catch (...)  {
+				Lock lck(m_mtxState);
+				if (!m_pException)  {
+					m_pException = boost::current_exception();
+				}
+			}
+			fnTask.clear();
+			Lock lck(m_mtxState);
+			if (--m_nPending == 0)  {
+				m_cvIdle.notify_all();
+			}
+		} else  {
+			Lock lck(m_mtxState);
+			while (m_nQueued == 0 && !m_bStopping)  {
+				m_cvWork.wait(lck);
+			}
+			if (m_nQueued == 0 && m_bStopping)  {
+				break;
+			}
+		}
+	}
+}
+
+void
+ThreadPool::Impl::Wait()
+{
+	Lock lck(m_mtxState);
+	while (m_nPending > 0)  {
+		m_cvIdle.wait(lck);
+	}
+	if (m_pException)  {
+		boost::exception_ptr pException = m_pException;
+		m_pException = boost::exception_ptr();
+		boost::rethrow_exception(pException);
+	}
+}
+
+
+ThreadPool::ThreadPool(unsigned int nThreads /*= 0*/)
+{
+	if (nThreads == 0)  {
+		nThreads = (std::max)(boost::thread::hardware_concurrency(), 1u);
+	}
+	m_pImpl.reset(new Impl(nThreads));
+}
+
+ThreadPool::~ThreadPool()
+{
+}
+
+unsigned int
+ThreadPool::GetThreadCount() const
+{
+	return m_pImpl->m_vQueues.size();
+}
+
+void
+ThreadPool::Submit(const Task &fnTask)
+{
+	m_pImpl->Push(fnTask);
+}
+
+void
+ThreadPool::Wait()
+{
+	m_pImpl->Wait();
+}
+
+int
+ThreadPool::GetWorkerIndex()
+{
+	WorkerSlot *pSlot = g_pWorkerSlot.get();
+	return pSlot ? pSlot->m_nIndex : -1;
+}
+
+ThreadPool &
+ThreadPool::GetDefault()
+{
+	static Mutex g_mtxDefault;
+	static boost::scoped_ptr<ThreadPool> g_pDefault;
+	Lock lck(g_mtxDefault);
+	if (!g_pDefault)  {
+		g_pDefault.reset(new ThreadPool);
+	}
+	return *g_pDefault;
+}
+
+
+bool
+ForEachPage(const Document::Ptr &pDoc, const PageFunction &fnPage,
+	ThreadPool *pPool /*= NULL*/)
+{
+	if (!pDoc || !pDoc->IsValid())  {
+		return false;
+	}
+	if (!pPool)  {
+		pPool = &ThreadPool::GetDefault();
+	}
+
+	int nPages = pDoc->GetPageCount();
+	boost::shared_ptr<PageBatch> pBatch(
+		new PageBatch(pDoc, fnPage, nPages, pPool->GetThreadCount()));
+
+	if (ThreadPool::GetWorkerIndex() >= 0)  {
+		// called from inside a task:  blocking a worker on other workers
+		// could deadlock the pool, so run the pages right here
+		for (int i=0; i<nPages; i++)  {
+			pBatch->RunPage(i);
+		}
+	} else  {
+		for (int i=0; i<nPages; i++)  {
+			pPool->Submit(boost::bind(&PageBatch::RunPage, pBatch, i));
+		}
+	}
+
+	return pBatch->Wait();
+}
+
+}
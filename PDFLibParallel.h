@@ -0,0 +1,110 @@
+/*
+ *  PDFLibParallel.h
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#ifndef APAGO_PDFLibParallel_h__
+#define APAGO_PDFLibParallel_h__
+
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "PDFLibWrapper.h"
+
+namespace PDFLibWrapper  {
+
+	// Work-stealing pool:  every worker owns a deque, runs its own tasks
+	// newest first and steals the oldest tasks of the other workers when
+	// its deque runs dry.
+	class ThreadPool : private boost::noncopyable  {
+	public:
+		typedef boost::function<void ()> Task;
+
+		explicit ThreadPool(unsigned int nThreads = 0);
+		~ThreadPool();
+
+		unsigned int GetThreadCount() const;
+
+		void Submit(const Task &fnTask);
+		void Wait();
+
+		// index of the calling worker thread in its pool, or -1
+		static int GetWorkerIndex();
+
+		static ThreadPool &GetDefault();
+
+		struct Impl;
+
+	private:
+		boost::shared_ptr<Impl> m_pImpl;
+	};
+
+	// What a page task gets to see:  the page and the Document it was
+	// loaded from.  The Document is private to the worker thread running
+	// the task, so nothing reachable from the page is shared with another
+	// thread.
+	class PageView  {
+	public:
+		PageView(int nIndex, const Document::Ptr &pDoc, const Object::Ptr &pPage)
+			: m_nIndex(nIndex), m_pDoc(pDoc), m_pPage(pPage)
+		{ }
+
+		int GetIndex() const  { return m_nIndex; }
+		Document &GetDocument() const  { return *m_pDoc; }
+		const Object::Ptr &GetPage() const  { return m_pPage; }
+
+	private:
+		int m_nIndex;
+		Document::Ptr m_pDoc;
+		Object::Ptr m_pPage;
+	};
+
+	typedef boost::function<void (const PageView &rView)> PageFunction;
+
+	bool ForEachPage(const Document::Ptr &pDoc, const PageFunction &fnPage,
+		ThreadPool *pPool = NULL);
+
+	namespace detail  {
+		template <class Result, class Function>
+		struct PageResultBinder  {
+			PageResultBinder(Function fnPage, std::vector<Result> &vResults)
+				: m_fnPage(fnPage), m_pvResults(&vResults)
+			{ }
+			void operator()(const PageView &rView)  {
+				m_fnPage(rView, (*m_pvResults)[rView.GetIndex()]);
+			}
+			Function m_fnPage;
+			std::vector<Result> *m_pvResults;
+		};
+	}
+
+	// fnPage(const PageView &, Result &) fills one result per page;
+	// fnMerge(Result &rTotal, const Result &rPage) is then called on the
+	// calling thread in page order.
+	template <class Result, class Function, class Merge>
+	bool ForEachPage(const Document::Ptr &pDoc, Function fnPage, Merge fnMerge,
+		Result &rTotal, ThreadPool *pPool = NULL)
+	{
+		if (!pDoc || !pDoc->IsValid())  {
+			return false;
+		}
+		std::vector<Result> vResults(pDoc->GetPageCount());
+		bool bSuccess = ForEachPage(pDoc,
+			detail::PageResultBinder<Result, Function>(fnPage, vResults), pPool);
+		typename std::vector<Result>::const_iterator itResult = vResults.begin(),
+			itEndResults = vResults.end();
+		while (itResult != itEndResults)  {
+			fnMerge(rTotal, *itResult);
+			++itResult;
+		}
+		return bSuccess;
+	}
+
+}
+
+#endif // APAGO_PDFLibParallel_h__
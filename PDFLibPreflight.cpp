@@ -0,0 +1,238 @@
+/*
+ *  PDFLibPreflight.cpp
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#include <algorithm>
+#include <set>
+
+#include "PDFLibPreflight.h"
+#include "PDFLibTrace.h"
+
+
+namespace  {
+
+	using namespace PDFLibWrapper;
+
+	struct Frame  {
+		Frame() : m_bDict(false), m_nLength(0), m_nNext(0)  { }
+
+		bool m_bDict;
+		std::vector<Name> m_vKeys;
+		int m_nLength;
+		int m_nNext;
+	};
+
+}
+
+namespace PDFLibWrapper  {
+
+const std::string &
+Finding::GetRule() const
+{
+	return m_pRule->GetName();
+}
+
+std::string
+Finding::GetLocation(bool bFullPath /*= false*/) const
+{
+	std::string sDesc;
+	m_oPath.GetDescription(sDesc, true, bFullPath);
+	return sDesc;
+}
+
+
+const Name *
+RuleContext::GetKey() const
+{
+	return m_vPath.back().GetName();
+}
+
+Object::Ptr
+RuleContext::GetParent() const
+{
+	if (m_vObjects.size() < 2)  {
+		return Object::Ptr();
+	}
+	return m_vObjects[m_vObjects.size() - 2];
+}
+
+void
+RuleContext::Report(const std::string &sMessage)
+{
+	m_pvFindings->push_back(Finding(m_pRule, sMessage,
+		PathRef(m_pPaths, m_pPaths->Intern(m_vPath))));
+}
+
+
+void
+RuleEngine::AddRule(const Rule::Ptr &pRule)
+{
+	m_vRules.push_back(pRule);
+	m_bCompiled = false;
+}
+
+void
+RuleEngine::Compile()
+{
+	if (m_bCompiled)  {
+		return;
+	}
+
+	for (int i=0; i<=Object::kDict; i++)  {
+		m_avByType[i].clear();
+	}
+	m_vByKey.clear();
+
+	for (size_t nRule=0; nRule<m_vRules.size(); nRule++)  {
+		RuleInterests oInterests;
+		m_vRules[nRule]->GetInterests(oInterests);
+		for (int i=0; i<=Object::kDict; i++)  {
+			if (oInterests.m_bAllTypes ||
+				std::find(oInterests.m_vTypes.begin(), oInterests.m_vTypes.end(), i) !=
+					oInterests.m_vTypes.end())
+			{
+				m_avByType[i].push_back(nRule);
+			}
+		}
+		std::vector<Name>::const_iterator itKey = oInterests.m_vKeys.begin(),
+			itEndKeys = oInterests.m_vKeys.end();
+		while (itKey != itEndKeys)  {
+			if (itKey->IsValid())  {
+				if (itKey->GetToken() >= m_vByKey.size())  {
+					m_vByKey.resize(itKey->GetToken() + 1);
+				}
+				RuleIndexes &vRules = m_vByKey[itKey->GetToken()];
+				if (std::find(vRules.begin(), vRules.end(), nRule) == vRules.end())  {
+					vRules.push_back(nRule);
+				}
+			}
+			++itKey;
+		}
+	}
+
+	m_vLastVisit.assign(m_vRules.size(), 0);
+	m_nVisit = 0;
+	m_bCompiled = true;
+}
+
+void
+RuleEngine::Dispatch(const RuleIndexes &vRules, RuleContext &rContext)
+{
+	RuleIndexes::const_iterator itRule = vRules.begin(), itEndRules = vRules.end();
+	while (itRule != itEndRules)  {
+		if (m_vLastVisit[*itRule] != m_nVisit)  {
+			m_vLastVisit[*itRule] = m_nVisit;
+			rContext.m_pRule = m_vRules[*itRule];
+			rContext.m_pRule->Check(rContext);
+		}
+		++itRule;
+	}
+}
+
+void
+RuleEngine::Visit(RuleContext &rContext)
+{
+	++m_nVisit;
+	const Name *pKey = rContext.GetKey();
+	if (pKey && pKey->IsValid() && pKey->GetToken() < m_vByKey.size())  {
+		Dispatch(m_vByKey[pKey->GetToken()], rContext);
+	}
+}
+
+bool
+RuleEngine::Run(const Document::Ptr &pDoc, FindingList &vFindings)
+{
+	PDFLIB_TRACE_SPAN("RuleEngine::Run", "traverse");
+	Object::Ptr pCatalog;
+	if (!pDoc || !pDoc->IsValid() || !pDoc->GetCatalog(pCatalog))  {
+		return false;
+	}
+
+	Compile();
+
+	RuleContext oContext(pDoc.get(), &vFindings);
+	std::set<Object::ID> setVisited;
+	std::vector<Frame> vFrames;
+	Object::Ptr pChild = pCatalog;
+	Name nmKey;
+	long nIndex = -1;
+
+	while (true)  {
+		if (pChild)  {
+			if (nIndex < 0)  {
+				oContext.m_vPath.push_back(Object::PathElement(nmKey, pChild.get()));
+			} else  {
+				oContext.m_vPath.push_back(Object::PathElement(nIndex, pChild.get()));
+			}
+			oContext.m_vObjects.push_back(pChild);
+
+			// values stored under an interesting key are checked on every
+			// reference, everything else only on the first one
+			Visit(oContext);
+			bool bEnter = !pChild->IsIndirect() ||
+				setVisited.insert(pChild->GetID()).second;
+			if (bEnter)  {
+				Object::Type eType = pChild->GetType();
+				if (eType <= Object::kDict)  {
+					Dispatch(m_avByType[eType], oContext);
+				}
+				NameSet setKeys;
+				switch (eType)  {
+					case Object::kDict:
+					case Object::kStream:
+						if (pChild->GetKeys(setKeys))  {
+							vFrames.push_back(Frame());
+							vFrames.back().m_bDict = true;
+							vFrames.back().m_vKeys.assign(setKeys.begin(), setKeys.end());
+							vFrames.back().m_nLength = setKeys.size();
+						} else  {
+							bEnter = false;
+						}
+						break;
+					case Object::kArray:
+						vFrames.push_back(Frame());
+						vFrames.back().m_nLength = pChild->GetLength();
+						break;
+					default:
+						bEnter = false;
+						break;
+				}
+			}
+			if (!bEnter)  {
+				oContext.m_vPath.pop_back();
+				oContext.m_vObjects.pop_back();
+			}
+			pChild.reset();
+		}
+
+		if (vFrames.empty())  {
+			break;
+		}
+
+		Frame &rFrame = vFrames.back();
+		const Object::Ptr &pParent = oContext.m_vObjects.back();
+		while (!pChild && rFrame.m_nNext < rFrame.m_nLength)  {
+			int nNext = rFrame.m_nNext++;
+			if (rFrame.m_bDict)  {
+				if (pParent->Get(pChild, rFrame.m_vKeys[nNext]))  {
+					nmKey = rFrame.m_vKeys[nNext];
+					nIndex = -1;
+				}
+			} else if (pParent->Get(pChild, nNext))  {
+				nIndex = nNext;
+			}
+		}
+		if (!pChild)  {
+			vFrames.pop_back();
+			oContext.m_vPath.pop_back();
+			oContext.m_vObjects.pop_back();
+		}
+	}
+
+	return true;
+}
+
+}
@@ -0,0 +1,132 @@
+/*
+ *  PDFLibPreflight.h
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#ifndef APAGO_PDFLibPreflight_h__
+#define APAGO_PDFLibPreflight_h__
+
+#include <vector>
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+
+#include "PDFLibWrapper.h"
+
+namespace PDFLibWrapper  {
+
+	class Rule;
+
+	class Finding  {
+	public:
+		Finding(const boost::shared_ptr<Rule> &pRule, const std::string &sMessage,
+			const PathRef &oPath)
+			: m_pRule(pRule), m_sMessage(sMessage), m_oPath(oPath)
+		{ }
+
+		const std::string &GetRule() const;
+		const std::string &GetMessage() const  { return m_sMessage; }
+		const PathRef &GetPath() const  { return m_oPath; }
+
+		// formatted only when asked for
+		std::string GetLocation(bool bFullPath = false) const;
+
+	private:
+		boost::shared_ptr<Rule> m_pRule;
+		std::string m_sMessage;
+		PathRef m_oPath;
+	};
+	typedef std::vector<Finding> FindingList;
+
+	class RuleInterests  {
+	public:
+		RuleInterests() : m_bAllTypes(false)  { }
+
+		void AddType(Object::Type eType)  { m_vTypes.push_back(eType); }
+		void AddAllTypes()  { m_bAllTypes = true; }
+		void AddKey(const Name &nmKey)  { m_vKeys.push_back(nmKey); }
+
+		bool m_bAllTypes;
+		std::vector<Object::Type> m_vTypes;
+		std::vector<Name> m_vKeys;
+	};
+
+	class RuleContext;
+
+	// A check run by RuleEngine.  Check is called for every object of a
+	// type the rule registered for, and for every value stored under one
+	// of its keys -- but only once per object, even if both match.
+	class Rule  {
+	public:
+		typedef boost::shared_ptr<Rule> Ptr;
+
+		Rule(const std::string &sName) : m_sName(sName)  { }
+		virtual ~Rule()  { }
+
+		const std::string &GetName() const  { return m_sName; }
+
+		virtual void GetInterests(RuleInterests &rInterests) const = 0;
+		virtual void Check(RuleContext &rContext) = 0;
+
+	private:
+		std::string m_sName;
+	};
+
+	class RuleContext  {
+	public:
+		Document &GetDocument() const  { return *m_pDoc; }
+		const Object::Ptr &GetObject() const  { return m_vObjects.back(); }
+		// key and dictionary the object was found in, if any
+		const Name *GetKey() const;
+		Object::Ptr GetParent() const;
+		const Object::Path &GetPath() const  { return m_vPath; }
+
+		void Report(const std::string &sMessage);
+
+	private:
+		RuleContext(Document *pDoc, FindingList *pvFindings)
+			: m_pDoc(pDoc), m_pvFindings(pvFindings), m_pPaths(new PathTable)
+		{ }
+
+		Document *m_pDoc;
+		Rule::Ptr m_pRule;
+		FindingList *m_pvFindings;
+		PathTable::Ptr m_pPaths;
+		Object::Path m_vPath;
+		ObjectList m_vObjects;
+
+		friend class RuleEngine;
+	};
+
+	// Runs any number of rules during a single traversal of the document,
+	// starting at the catalog.  Indirect objects are entered once.
+	class RuleEngine  {
+	public:
+		RuleEngine() : m_bCompiled(false), m_nVisit(0)  { }
+
+		void AddRule(const Rule::Ptr &pRule);
+		size_t GetRuleCount() const  { return m_vRules.size(); }
+
+		bool Run(const Document::Ptr &pDoc, FindingList &vFindings);
+
+	private:
+		typedef std::vector<size_t> RuleIndexes;
+
+		void Compile();
+		void Dispatch(const RuleIndexes &vRules, RuleContext &rContext);
+		void Visit(RuleContext &rContext);
+
+		std::vector<Rule::Ptr> m_vRules;
+		bool m_bCompiled;
+		RuleIndexes m_avByType[Object::kDict + 1];
+		// indexed by Name token
+		std::vector<RuleIndexes> m_vByKey;
+		std::vector<unsigned long> m_vLastVisit;
+		unsigned long m_nVisit;
+	};
+
+}
+
+#endif // APAGO_PDFLibPreflight_h__
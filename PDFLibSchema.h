@@ -0,0 +1,300 @@
+/*
+ *  PDFLibSchema.h
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#ifndef APAGO_PDFLibSchema_h__
+#define APAGO_PDFLibSchema_h__
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <boost/thread/once.hpp>
+
+#include "PDFLibWrapper.h"
+
+namespace PDFLibWrapper  {
+
+	// Fills the members of a struct from the entries of a dictionary.  The
+	// struct lists its fields once, in a static DescribeSchema:
+	//
+	//     struct ImageInfo  {
+	//         ImageInfo() : m_nWidth(0), m_nHeight(0), m_nBitsPerComponent(8)  { }
+	//
+	//         int m_nWidth;
+	//         int m_nHeight;
+	//         int m_nBitsPerComponent;
+	//
+	//         static void DescribeSchema(Schema<ImageInfo> &rSchema)  {
+	//             rSchema.Required<int, &ImageInfo::m_nWidth>("Width")
+	//                 .Required<int, &ImageInfo::m_nHeight>("Height")
+	//                 .Optional<int, &ImageInfo::m_nBitsPerComponent>("BitsPerComponent");
+	//         }
+	//     };
+	//
+	// and DecodeSchema(*pImage, oInfo) fills one in.  The keys are interned
+	// once, when the schema is first used.  The entries of the dictionary
+	// come out of the backend in one call, and every field is filled from
+	// them by a function instantiated for its member, without lookups by
+	// string or virtual calls of the schema's own.
+	// Members of absent fields keep their values, so the constructor sets
+	// the defaults.
+	//
+	// Fields are bool, int, unsigned int, boost::int64_t, float, double,
+	// Name, std::string, Object::Ptr, or a std::vector of int, double or
+	// Name for arrays.  Integers are accepted for floats and doubles.
+
+	struct SchemaError  {
+		enum Kind  { kMissing, kMistyped };
+
+		SchemaError(const Name &nmKey, Kind eKind) : m_nmKey(nmKey), m_eKind(eKind)  { }
+
+		Name m_nmKey;
+		Kind m_eKind;
+	};
+	typedef std::vector<SchemaError> SchemaErrors;
+
+	namespace SchemaField  {
+
+		// from the value of an entry, as extracted by Object::ExtractEntries
+
+		inline bool
+		Get(Object &, const Object::Entry &rEntry, bool &bValue)
+		{
+			if (rEntry.m_oValue.m_eType != Object::kBoolean)  {
+				return false;
+			}
+			bValue = rEntry.m_oValue.m_bBoolean;
+			return true;
+		}
+
+		inline bool
+		Get(Object &, const Object::Entry &rEntry, boost::int64_t &nValue)
+		{
+			if (rEntry.m_oValue.m_eType != Object::kInteger)  {
+				return false;
+			}
+			nValue = rEntry.m_oValue.m_nInteger;
+			return true;
+		}
+
+		inline bool
+		Get(Object &rDict, const Object::Entry &rEntry, int &nValue)
+		{
+			// out of range is mistyped, as for Object::Get
+			boost::int64_t nWide;
+			if (!Get(rDict, rEntry, nWide) || nWide < (std::numeric_limits<int>::min)() ||
+				nWide > (std::numeric_limits<int>::max)())
+			{
+				return false;
+			}
+			nValue = (int)nWide;
+			return true;
+		}
+
+		inline bool
+		Get(Object &rDict, const Object::Entry &rEntry, unsigned int &nValue)
+		{
+			boost::int64_t nWide;
+			if (!Get(rDict, rEntry, nWide) || nWide < 0 ||
+				(boost::uint64_t)nWide > (std::numeric_limits<unsigned int>::max)())
+			{
+				return false;
+			}
+			nValue = (unsigned int)nWide;
+			return true;
+		}
+
+		inline bool
+		Get(Object &, const Object::Entry &rEntry, double &dValue)
+		{
+			if (rEntry.m_oValue.m_eType == Object::kInteger)  {
+				dValue = (double)rEntry.m_oValue.m_nInteger;
+			} else if (rEntry.m_oValue.m_eType == Object::kFixed)  {
+				dValue = rEntry.m_oValue.m_dReal;
+			} else  {
+				return false;
+			}
+			return true;
+		}
+
+		inline bool
+		Get(Object &rDict, const Object::Entry &rEntry, float &fValue)
+		{
+			double dValue;
+			if (!Get(rDict, rEntry, dValue))  {
+				return false;
+			}
+			fValue = (float)dValue;
+			return true;
+		}
+
+		inline bool
+		Get(Object &, const Object::Entry &rEntry, Name &nmValue)
+		{
+			if (rEntry.m_oValue.m_eType != Object::kName)  {
+				return false;
+			}
+			nmValue = rEntry.m_oValue.m_nmName;
+			return true;
+		}
+
+		inline bool
+		Get(Object &, const Object::Entry &rEntry, std::string &sValue)
+		{
+			if (rEntry.m_oValue.m_eType != Object::kString)  {
+				return false;
+			}
+			sValue = rEntry.m_oValue.m_sString;
+			return true;
+		}
+
+		// scalars carry no object of their own
+		inline bool
+		Get(Object &rDict, const Object::Entry &rEntry, Object::Ptr &pValue)
+		{
+			if (rEntry.m_oValue.m_pObject)  {
+				pValue = rEntry.m_oValue.m_pObject;
+				return true;
+			}
+			return rDict.Get(pValue, rEntry.m_nmKey);
+		}
+
+		template <class T>
+		inline bool
+		Get(Object &, const Object::Entry &rEntry, std::vector<T> &vValues)
+		{
+			return rEntry.m_oValue.m_eType == Object::kArray && rEntry.m_oValue.m_pObject &&
+				rEntry.m_oValue.m_pObject->GetArray(vValues);
+		}
+
+		// a null value is the same as none
+		inline bool
+		IsPresent(const Object::Entry *pEntry)
+		{
+			return pEntry && pEntry->m_oValue.m_eType != Object::kNull;
+		}
+
+	}
+
+	template <class S>
+	class Schema  {
+	public:
+		template <class T, T S::*pMember>
+		Schema &Required(const char *szKey)  { return Add(szKey, &DecodeField<T, pMember>, true); }
+		template <class T, T S::*pMember>
+		Schema &Optional(const char *szKey)  { return Add(szKey, &DecodeField<T, pMember>, false); }
+
+		// False if a required field is missing or any field has a value of
+		// another type; those are added to pErrors.  The entries are taken
+		// out of rDict in one call, see Object::ExtractEntries; vEntries
+		// holds them, and passing the same one to every call saves
+		// allocations.
+		bool Decode(Object &rDict, S &rStruct, std::vector<Object::Entry> &vEntries,
+			SchemaErrors *pErrors = NULL) const
+		{
+			if (!rDict.ExtractEntries(vEntries))  {
+				vEntries.clear();
+			}
+			bool bComplete = true;
+			typename std::vector<Field>::const_iterator it = m_vFields.begin(), itEnd = m_vFields.end();
+			for (; it != itEnd; ++it)  {
+				const Object::Entry *pEntry = Find(vEntries, it->m_nmKey);
+				bool bPresent = SchemaField::IsPresent(pEntry);
+				if (bPresent && it->m_fnDecode(rDict, *pEntry, rStruct))  {
+					continue;
+				}
+				if (bPresent || it->m_bRequired)  {
+					bComplete = false;
+					if (pErrors)  {
+						pErrors->push_back(SchemaError(it->m_nmKey,
+							bPresent ? SchemaError::kMistyped : SchemaError::kMissing));
+					}
+				}
+			}
+			return bComplete;
+		}
+
+		bool Decode(Object &rDict, S &rStruct, SchemaErrors *pErrors = NULL) const  {
+			std::vector<Object::Entry> vEntries;
+			return Decode(rDict, rStruct, vEntries, pErrors);
+		}
+
+		size_t GetFieldCount() const  { return m_vFields.size(); }
+
+		// the one of S, described on first use by whichever thread gets
+		// there first; never destroyed, like the Names it holds
+		static const Schema &Get()  {
+			static boost::once_flag s_onceDescribe = BOOST_ONCE_INIT;
+			boost::call_once(&Describe, s_onceDescribe);
+			return *s_pSchema;
+		}
+
+	private:
+		typedef bool (*DecodeFn)(Object &rDict, const Object::Entry &rEntry, S &rStruct);
+
+		struct Field  {
+			Field(const Name &nmKey, DecodeFn fnDecode, bool bRequired)
+				: m_nmKey(nmKey), m_fnDecode(fnDecode), m_bRequired(bRequired)
+			{ }
+
+			Name m_nmKey;
+			DecodeFn m_fnDecode;
+			bool m_bRequired;
+		};
+
+		template <class T, T S::*pMember>
+		static bool DecodeField(Object &rDict, const Object::Entry &rEntry, S &rStruct)  {
+			return SchemaField::Get(rDict, rEntry, rStruct.*pMember);
+		}
+
+		// dictionaries have a handful of entries, so a scan beats a map
+		static const Object::Entry *Find(const std::vector<Object::Entry> &vEntries, const Name &nmKey)  {
+			for (size_t i=0; i<vEntries.size(); i++)  {
+				if (vEntries[i].m_nmKey == nmKey)  {
+					return &vEntries[i];
+				}
+			}
+			return NULL;
+		}
+
+		static void Describe()  {
+			Schema *pSchema = new Schema;
+			S::DescribeSchema(*pSchema);
+			s_pSchema = pSchema;
+		}
+
+		Schema &Add(const char *szKey, DecodeFn fnDecode, bool bRequired)  {
+			m_vFields.push_back(Field(Name(szKey), fnDecode, bRequired));
+			return *this;
+		}
+
+		std::vector<Field> m_vFields;
+
+		static const Schema *s_pSchema;
+	};
+
+	template <class S>
+	const Schema<S> *Schema<S>::s_pSchema = NULL;
+
+	template <class S>
+	inline bool
+	DecodeSchema(Object &rDict, S &rStruct, SchemaErrors *pErrors = NULL)
+	{
+		return Schema<S>::Get().Decode(rDict, rStruct, pErrors);
+	}
+
+	template <class S>
+	inline bool
+	DecodeSchema(Object &rDict, S &rStruct, std::vector<Object::Entry> &vEntries,
+		SchemaErrors *pErrors = NULL)
+	{
+		return Schema<S>::Get().Decode(rDict, rStruct, vEntries, pErrors);
+	}
+
+}
+
+#endif // APAGO_PDFLibSchema_h__
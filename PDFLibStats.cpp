@@ -0,0 +1,381 @@
+/*
+ *  PDFLibStats.cpp
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#include <cstring>
+#include <iostream>
+#include <set>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+
+#include "PDFLibStats.h"
+
+#ifdef _MSC_VER
+#define PDFLWRAP_THREAD_LOCAL __declspec(thread)
+#else
+#define PDFLWRAP_THREAD_LOCAL __thread
+#endif
+
+
+namespace  {
+
+	using namespace PDFLibWrapper;
+
+	typedef boost::mutex Mutex;
+	typedef boost::unique_lock<Mutex> Lock;
+
+	typedef boost::atomic<boost::uint64_t> AtomicCount;
+
+	// Only the owning thread writes its block, so a relaxed load and store
+	// count without a locked instruction; snapshots read it from other
+	// threads, hence the atomics.
+	inline void
+	AddTo(AtomicCount &rCount, boost::uint64_t nValue)
+	{
+		rCount.store(rCount.load(boost::memory_order_relaxed) + nValue, boost::memory_order_relaxed);
+	}
+
+	struct ThreadHistogram  {
+		ThreadHistogram()  {
+			for (int i=0; i<LatencyHistogram::kBucketCount; i++)  {
+				m_anBuckets[i].store(0, boost::memory_order_relaxed);
+			}
+			m_nTotal.store(0, boost::memory_order_relaxed);
+		}
+
+		AtomicCount m_anBuckets[LatencyHistogram::kBucketCount];
+		AtomicCount m_nTotal;
+	};
+
+	struct ThreadStats  {
+		ThreadStats()  {
+			for (int i=0; i<kStatCounterCount; i++)  {
+				m_anCounters[i].store(0, boost::memory_order_relaxed);
+			}
+		}
+
+		AtomicCount m_anCounters[kStatCounterCount];
+		ThreadHistogram m_aHistograms[kStatTimerCount];
+	};
+
+	// sums of blocks, only used under the registry's lock
+	struct StatsTotals  {
+		StatsTotals()  { memset(m_anCounters, 0, sizeof(m_anCounters)); }
+
+		void Add(const ThreadStats &rStats)  {
+			for (int i=0; i<kStatCounterCount; i++)  {
+				m_anCounters[i] += rStats.m_anCounters[i].load(boost::memory_order_relaxed);
+			}
+			for (int i=0; i<kStatTimerCount; i++)  {
+				const ThreadHistogram &rHistogram = rStats.m_aHistograms[i];
+				boost::uint64_t anBuckets[LatencyHistogram::kBucketCount];
+				for (int nBucket=0; nBucket<LatencyHistogram::kBucketCount; nBucket++)  {
+					anBuckets[nBucket] = rHistogram.m_anBuckets[nBucket].load(boost::memory_order_relaxed);
+				}
+				m_aHistograms[i].Merge(anBuckets, rHistogram.m_nTotal.load(boost::memory_order_relaxed));
+			}
+		}
+
+		boost::uint64_t m_anCounters[kStatCounterCount];
+		LatencyHistogram m_aHistograms[kStatTimerCount];
+	};
+
+	void RetireThreadStats(ThreadStats *pStats);
+
+	// Created on first use and never destroyed, as Names are counted
+	// during static initialization and destruction.
+	struct StatsRegistry  {
+		StatsRegistry() : m_pThreadStats(RetireThreadStats)  { }
+
+		Mutex m_mtx;
+		boost::thread_specific_ptr<ThreadStats> m_pThreadStats;
+		std::set<ThreadStats *> m_setThreads;
+		// what threads that have ended counted
+		StatsTotals m_oRetired;
+		// taken at the last Reset
+		StatsTotals m_oBaseline;
+	};
+
+	StatsRegistry &
+	GetRegistry()
+	{
+		static StatsRegistry *pRegistry = new StatsRegistry;
+		return *pRegistry;
+	}
+
+	// zero-initialized, so Names are counted during static initialization
+	// too
+	boost::atomic<bool> g_bStatsDisabled;
+
+	// The block of the thread, for counting without a call into the thread
+	// library; m_pThreadStats only hands it to RetireThreadStats when the
+	// thread ends.
+	PDFLWRAP_THREAD_LOCAL ThreadStats *g_pThreadStats = NULL;
+
+	void
+	RetireThreadStats(ThreadStats *pStats)
+	{
+		StatsRegistry &rRegistry = GetRegistry();
+		Lock lck(rRegistry.m_mtx);
+		rRegistry.m_oRetired.Add(*pStats);
+		rRegistry.m_setThreads.erase(pStats);
+		if (g_pThreadStats == pStats)  {
+			g_pThreadStats = NULL;
+		}
+		delete pStats;
+	}
+
+	ThreadStats *
+	CreateThreadStats()
+	{
+		StatsRegistry &rRegistry = GetRegistry();
+		ThreadStats *pStats = new ThreadStats;
+		rRegistry.m_pThreadStats.reset(pStats);
+		Lock lck(rRegistry.m_mtx);
+		rRegistry.m_setThreads.insert(pStats);
+		g_pThreadStats = pStats;
+		return pStats;
+	}
+
+	inline ThreadStats &
+	GetThreadStats()
+	{
+		ThreadStats *pStats = g_pThreadStats;
+		return pStats ? *pStats : *CreateThreadStats();
+	}
+
+	void
+	SumThreadStats(StatsRegistry &rRegistry, StatsTotals &rSum)
+	{
+		rSum = rRegistry.m_oRetired;
+		for (std::set<ThreadStats *>::const_iterator it = rRegistry.m_setThreads.begin();
+			it != rRegistry.m_setThreads.end(); ++it)
+		{
+			rSum.Add(**it);
+		}
+	}
+
+	void
+	DumpHistogram(std::ostream &rOut, const std::string &sName, const LatencyHistogram &rHistogram)
+	{
+		rOut << "# TYPE " << sName << " histogram\n";
+		boost::uint64_t nCumulative = 0;
+		for (int i=0; i<LatencyHistogram::kBucketCount - 1; i++)  {
+			nCumulative += rHistogram.GetBucket(i);
+			rOut << sName << "_bucket{le=\"" << (double)((boost::uint64_t)1 << i) / 1e9 << "\"} "
+				<< nCumulative << "\n";
+		}
+		rOut << sName << "_bucket{le=\"+Inf\"} " << rHistogram.GetCount() << "\n";
+		rOut << sName << "_sum " << (double)rHistogram.GetTotal() / 1e9 << "\n";
+		rOut << sName << "_count " << rHistogram.GetCount() << "\n";
+	}
+
+}
+
+namespace PDFLibWrapper  {
+
+LatencyHistogram::LatencyHistogram()
+: m_nCount(0), m_nTotal(0)
+{
+	memset(m_anBuckets, 0, sizeof(m_anBuckets));
+}
+
+void
+LatencyHistogram::Add(boost::uint64_t nNanoseconds)
+{
+	++m_anBuckets[GetBucketOf(nNanoseconds)];
+	++m_nCount;
+	m_nTotal += nNanoseconds;
+}
+
+void
+LatencyHistogram::Merge(const LatencyHistogram &rOther)
+{
+	for (int i=0; i<kBucketCount; i++)  {
+		m_anBuckets[i] += rOther.m_anBuckets[i];
+	}
+	m_nCount += rOther.m_nCount;
+	m_nTotal += rOther.m_nTotal;
+}
+
+void
+LatencyHistogram::Merge(const boost::uint64_t *anBuckets, boost::uint64_t nTotal)
+{
+	for (int i=0; i<kBucketCount; i++)  {
+		m_anBuckets[i] += anBuckets[i];
+		m_nCount += anBuckets[i];
+	}
+	m_nTotal += nTotal;
+}
+
+void
+LatencyHistogram::Subtract(const LatencyHistogram &rOther)
+{
+	for (int i=0; i<kBucketCount; i++)  {
+		m_anBuckets[i] -= rOther.m_anBuckets[i];
+	}
+	m_nCount -= rOther.m_nCount;
+	m_nTotal -= rOther.m_nTotal;
+}
+
+int
+LatencyHistogram::GetBucketOf(boost::uint64_t nNanoseconds)
+{
+	int nBucket = 0;
+	while (nBucket < kBucketCount - 1 && nNanoseconds >= ((boost::uint64_t)1 << nBucket))  {
+		++nBucket;
+	}
+	return nBucket;
+}
+
+boost::uint64_t
+LatencyHistogram::GetPercentile(double dFraction) const
+{
+	if (m_nCount == 0)  {
+		return 0;
+	}
+	boost::uint64_t nWanted = (boost::uint64_t)(dFraction * m_nCount);
+	boost::uint64_t nCumulative = 0;
+	for (int i=0; i<kBucketCount; i++)  {
+		nCumulative += m_anBuckets[i];
+		if (nCumulative > nWanted || nCumulative == m_nCount)  {
+			return (boost::uint64_t)1 << i;
+		}
+	}
+	return 0;
+}
+
+
+StatsSnapshot::StatsSnapshot()
+{
+	memset(m_anCounters, 0, sizeof(m_anCounters));
+}
+
+const char *
+StatsSnapshot::GetName(StatCounter eCounter)
+{
+	static const char *aszNames[kStatCounterCount] =  {
+		"object_cache_hits", "object_cache_misses", "dict_cache_hits", "dict_cache_misses",
+		"name_lookups", "name_inserts", "name_lock_waits", "objects_created", "pdfl_errors"
+	};
+	return aszNames[eCounter];
+}
+
+const char *
+StatsSnapshot::GetName(StatTimer eTimer)
+{
+	static const char *aszNames[kStatTimerCount] =  {
+		"open", "get_object", "get_value", "name_lock_wait"
+	};
+	return aszNames[eTimer];
+}
+
+void
+StatsSnapshot::Dump(std::ostream &rOut) const
+{
+	for (int i=0; i<kStatCounterCount; i++)  {
+		std::string sName = std::string("pdflwrap_") + GetName((StatCounter)i) + "_total";
+		rOut << "# TYPE " << sName << " counter\n";
+		rOut << sName << " " << m_anCounters[i] << "\n";
+	}
+	for (int i=0; i<kStatTimerCount; i++)  {
+		DumpHistogram(rOut, std::string("pdflwrap_") + GetName((StatTimer)i) + "_seconds",
+			m_aHistograms[i]);
+	}
+	rOut.flush();
+}
+
+
+void
+Statistics::Count(StatCounter eCounter)
+{
+	if (!g_bStatsDisabled.load(boost::memory_order_relaxed))  {
+		AddTo(GetThreadStats().m_anCounters[eCounter], 1);
+	}
+}
+
+void
+Statistics::Record(StatTimer eTimer, boost::uint64_t nNanoseconds)
+{
+	if (!g_bStatsDisabled.load(boost::memory_order_relaxed))  {
+		ThreadHistogram &rHistogram = GetThreadStats().m_aHistograms[eTimer];
+		AddTo(rHistogram.m_anBuckets[LatencyHistogram::GetBucketOf(nNanoseconds)], 1);
+		AddTo(rHistogram.m_nTotal, nNanoseconds);
+	}
+}
+
+boost::uint64_t
+Statistics::Now()
+{
+#ifdef _WIN32
+	static LARGE_INTEGER nFrequency;
+	if (nFrequency.QuadPart == 0)  {
+		QueryPerformanceFrequency(&nFrequency);
+	}
+	LARGE_INTEGER nCounter;
+	QueryPerformanceCounter(&nCounter);
+	return (boost::uint64_t)((double)nCounter.QuadPart * 1e9 / nFrequency.QuadPart);
+#else
+	timespec tsNow;
+	clock_gettime(CLOCK_MONOTONIC, &tsNow);
+	return (boost::uint64_t)tsNow.tv_sec * 1000000000u + tsNow.tv_nsec;
+#endif
+}
+
+void
+Statistics::GetSnapshot(StatsSnapshot &rSnapshot)
+{
+	StatsRegistry &rRegistry = GetRegistry();
+	StatsTotals oSum;
+	Lock lck(rRegistry.m_mtx);
+	SumThreadStats(rRegistry, oSum);
+	for (int i=0; i<kStatCounterCount; i++)  {
+		rSnapshot.m_anCounters[i] = oSum.m_anCounters[i] - rRegistry.m_oBaseline.m_anCounters[i];
+	}
+	for (int i=0; i<kStatTimerCount; i++)  {
+		rSnapshot.m_aHistograms[i] = oSum.m_aHistograms[i];
+		rSnapshot.m_aHistograms[i].Subtract(rRegistry.m_oBaseline.m_aHistograms[i]);
+	}
+}
+
+void
+Statistics::Reset()
+{
+	// only the counting thread writes its block, so rather than clearing
+	// the blocks the current totals become the zero of later snapshots
+	StatsRegistry &rRegistry = GetRegistry();
+	Lock lck(rRegistry.m_mtx);
+	SumThreadStats(rRegistry, rRegistry.m_oBaseline);
+}
+
+void
+Statistics::Dump(std::ostream &rOut)
+{
+	StatsSnapshot oSnapshot;
+	GetSnapshot(oSnapshot);
+	oSnapshot.Dump(rOut);
+}
+
+void
+Statistics::SetEnabled(bool bEnabled)
+{
+	g_bStatsDisabled.store(!bEnabled, boost::memory_order_relaxed);
+}
+
+bool
+Statistics::IsEnabled()
+{
+	return !g_bStatsDisabled.load(boost::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,142 @@
+/*
+ *  PDFLibStats.h
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#ifndef APAGO_PDFLibStats_h__
+#define APAGO_PDFLibStats_h__
+
+#include <iosfwd>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace PDFLibWrapper  {
+
+	// Counters and latencies of the hot paths.  Every thread counts into a
+	// block of its own, so counting takes no lock; the blocks are summed up
+	// when a snapshot is taken.  Defining PDFLIB_NO_STATISTICS compiles the
+	// counting out of the wrapper; the snapshots are then all zero.
+
+	enum StatCounter  {
+		kStatObjectCacheHits,	// GetObject served from the Document's objects
+		kStatObjectCacheMisses,
+		kStatDictCacheHits,		// dictionary values already wrapped
+		kStatDictCacheMisses,
+		kStatNameLookups,
+		kStatNameInserts,
+		kStatNameLockWaits,		// Name::Set found the name table locked
+		kStatObjectsCreated,
+		kStatPDFLErrors,		// exceptions caught from the PDF Library
+		kStatCounterCount
+	};
+
+	// the cache hits of GetObject and GetValue are only counted, as
+	// reading the clock would take longer than they do
+	enum StatTimer  {
+		kStatOpen,
+		kStatGetObject,			// cache misses only
+		kStatGetValue,			// cache misses only
+		kStatNameLockWait,
+		kStatTimerCount
+	};
+
+	class LatencyHistogram  {
+	public:
+		// bucket i counts latencies below 2^i ns, the last one the rest
+		enum  { kBucketCount = 32 };
+
+		LatencyHistogram();
+
+		void Add(boost::uint64_t nNanoseconds);
+		void Merge(const LatencyHistogram &rOther);
+		// of kBucketCount counts, and the latencies they add up to
+		void Merge(const boost::uint64_t *anBuckets, boost::uint64_t nTotal);
+		void Subtract(const LatencyHistogram &rOther);
+
+		// the bucket Add counts nNanoseconds in
+		static int GetBucketOf(boost::uint64_t nNanoseconds);
+
+		boost::uint64_t GetCount() const  { return m_nCount; }
+		boost::uint64_t GetTotal() const  { return m_nTotal; }
+		boost::uint64_t GetBucket(int nBucket) const  { return m_anBuckets[nBucket]; }
+		// upper bound of the bucket the given fraction of the latencies is
+		// below, in ns
+		boost::uint64_t GetPercentile(double dFraction) const;
+
+	private:
+		boost::uint64_t m_anBuckets[kBucketCount];
+		boost::uint64_t m_nCount;
+		boost::uint64_t m_nTotal;
+	};
+
+	class StatsSnapshot  {
+	public:
+		StatsSnapshot();
+
+		boost::uint64_t GetCounter(StatCounter eCounter) const  { return m_anCounters[eCounter]; }
+		const LatencyHistogram &GetHistogram(StatTimer eTimer) const  { return m_aHistograms[eTimer]; }
+
+		static const char *GetName(StatCounter eCounter);
+		static const char *GetName(StatTimer eTimer);
+
+		// in the Prometheus text format, latencies in seconds
+		void Dump(std::ostream &rOut) const;
+
+	private:
+		boost::uint64_t m_anCounters[kStatCounterCount];
+		LatencyHistogram m_aHistograms[kStatTimerCount];
+
+		friend class Statistics;
+	};
+
+	class Statistics  {
+	public:
+		static void Count(StatCounter eCounter);
+		static void Record(StatTimer eTimer, boost::uint64_t nNanoseconds);
+
+		// monotonic, in ns
+		static boost::uint64_t Now();
+
+		// exact for threads that are done; threads still counting may be
+		// off by their latest few counts
+		static void GetSnapshot(StatsSnapshot &rSnapshot);
+		// snapshots count from here on
+		static void Reset();
+		static void Dump(std::ostream &rOut);
+
+		// on by default
+		static void SetEnabled(bool bEnabled);
+		static bool IsEnabled();
+	};
+
+	class ScopedStatTimer : private boost::noncopyable  {
+	public:
+		explicit ScopedStatTimer(StatTimer eTimer)
+			: m_eTimer(eTimer), m_nStart(Statistics::IsEnabled() ? Statistics::Now() : 0)
+		{ }
+		~ScopedStatTimer()  {
+			if (m_nStart)  {
+				Statistics::Record(m_eTimer, Statistics::Now() - m_nStart);
+			}
+		}
+
+	private:
+		StatTimer m_eTimer;
+		boost::uint64_t m_nStart;
+	};
+
+}
+
+#ifdef PDFLIB_NO_STATISTICS
+#define PDFLIB_STAT_COUNT(eCounter)  ((void)0)
+#define PDFLIB_STAT_TIME(eTimer)  ((void)0)
+#else
+#define PDFLIB_STAT_COUNT(eCounter)  ::PDFLibWrapper::Statistics::Count(::PDFLibWrapper::eCounter)
+#define PDFLIB_STAT_TIME(eTimer)  \
+	::PDFLibWrapper::ScopedStatTimer oStatTimer_##eTimer(::PDFLibWrapper::eTimer)
+#endif
+
+#endif // APAGO_PDFLibStats_h__
@@ -0,0 +1,352 @@
+/*
+ *  PDFLibText.cpp
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PDFLWRAP_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "PDFLibText.h"
+
+
+namespace  {
+
+	using namespace PDFLibWrapper;
+
+	const unsigned int kReplacement = 0xFFFD;
+	const unsigned int kEscape = 0x1B;
+
+	// 0x18 to 0x1F and 0x7F to 0xFF; the rest is ASCII, 0 where undefined
+	const unsigned short g_anPDFDocLow[8] =  {
+		0x02D8, 0x02C7, 0x02C6, 0x02D9, 0x02DD, 0x02DB, 0x02DA, 0x02DC
+	};
+	const unsigned short g_anPDFDocHigh[129] =  {
+		0,
+		0x2022, 0x2020, 0x2021, 0x2026, 0x2014, 0x2013, 0x0192, 0x2044,
+		0x2039, 0x203A, 0x2212, 0x2030, 0x201E, 0x201C, 0x201D, 0x2018,
+		0x2019, 0x201A, 0x2122, 0xFB01, 0xFB02, 0x0141, 0x0152, 0x0160,
+		0x0178, 0x017D, 0x0131, 0x0142, 0x0153, 0x0161, 0x017E, 0,
+		0x20AC, 0x00A1, 0x00A2, 0x00A3, 0x00A4, 0x00A5, 0x00A6, 0x00A7,
+		0x00A8, 0x00A9, 0x00AA, 0x00AB, 0x00AC, 0, 0x00AE, 0x00AF,
+		0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x00B4, 0x00B5, 0x00B6, 0x00B7,
+		0x00B8, 0x00B9, 0x00BA, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x00BF,
+		0x00C0, 0x00C1, 0x00C2, 0x00C3, 0x00C4, 0x00C5, 0x00C6, 0x00C7,
+		0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+		0x00D0, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x00D7,
+		0x00D8, 0x00D9, 0x00DA, 0x00DB, 0x00DC, 0x00DD, 0x00DE, 0x00DF,
+		0x00E0, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x00E7,
+		0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF,
+		0x00F0, 0x00F1, 0x00F2, 0x00F3, 0x00F4, 0x00F5, 0x00F6, 0x00F7,
+		0x00F8, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x00FD, 0x00FE, 0x00FF
+	};
+
+	inline char *
+	AppendUTF8(char *pOut, unsigned int nCode)
+	{
+		if (nCode < 0x80)  {
+			*pOut++ = (char)nCode;
+		} else if (nCode < 0x800)  {
+			*pOut++ = (char)(0xC0 | (nCode >> 6));
+			*pOut++ = (char)(0x80 | (nCode & 0x3F));
+		} else if (nCode < 0x10000)  {
+			*pOut++ = (char)(0xE0 | (nCode >> 12));
+			*pOut++ = (char)(0x80 | ((nCode >> 6) & 0x3F));
+			*pOut++ = (char)(0x80 | (nCode & 0x3F));
+		} else  {
+			*pOut++ = (char)(0xF0 | (nCode >> 18));
+			*pOut++ = (char)(0x80 | ((nCode >> 12) & 0x3F));
+			*pOut++ = (char)(0x80 | ((nCode >> 6) & 0x3F));
+			*pOut++ = (char)(0x80 | (nCode & 0x3F));
+		}
+		return pOut;
+	}
+
+	// The ASCII blocks at the start of the input, copied 16 bytes or 8 code
+	// units at a time; how much of the input they were.  PDFDocEncoding
+	// and UTF-8 blocks may have all of 0x00 to 0x7F except 0x18 to 0x1F and
+	// 0x7F, UTF-16 ones all but U+001B.
+
+#ifdef PDFLWRAP_SSE2
+
+	size_t
+	PDFDocBlocksSSE2(const unsigned char *pIn, size_t nLength, char *pOut)
+	{
+		const __m128i vBelowAccents = _mm_set1_epi8(0x17), vAboveAccents = _mm_set1_epi8(0x20);
+		const __m128i vDelete = _mm_set1_epi8(0x7F);
+		size_t nDone = 0;
+		while (nDone + 16 <= nLength)  {
+			__m128i v = _mm_loadu_si128((const __m128i *)(pIn + nDone));
+			// bytes from 0x80 are negative, so only the high bit catches them
+			__m128i vAccents = _mm_and_si128(_mm_cmpgt_epi8(v, vBelowAccents), _mm_cmplt_epi8(v, vAboveAccents));
+			__m128i vSpecial = _mm_or_si128(v, _mm_or_si128(vAccents, _mm_cmpeq_epi8(v, vDelete)));
+			if (_mm_movemask_epi8(vSpecial))  {
+				break;
+			}
+			_mm_storeu_si128((__m128i *)(pOut + nDone), v);
+			nDone += 16;
+		}
+		return nDone;
+	}
+
+	size_t
+	UTF8BlocksSSE2(const unsigned char *pIn, size_t nLength, char *pOut)
+	{
+		size_t nDone = 0;
+		while (nDone + 16 <= nLength)  {
+			__m128i v = _mm_loadu_si128((const __m128i *)(pIn + nDone));
+			if (_mm_movemask_epi8(v))  {
+				break;
+			}
+			_mm_storeu_si128((__m128i *)(pOut + nDone), v);
+			nDone += 16;
+		}
+		return nDone;
+	}
+
+	size_t
+	UTF16BlocksSSE2(const unsigned char *pIn, size_t nLength, char *pOut, size_t &nWritten)
+	{
+		const __m128i vNotASCII = _mm_set1_epi16((short)0xFF80), vEscape = _mm_set1_epi16(kEscape);
+		const __m128i vZero = _mm_setzero_si128();
+		size_t nDone = 0;
+		nWritten = 0;
+		while (nDone + 16 <= nLength)  {
+			__m128i v = _mm_loadu_si128((const __m128i *)(pIn + nDone));
+			// big to little endian
+			__m128i vUnits = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+			__m128i vASCII = _mm_cmpeq_epi16(_mm_and_si128(vUnits, vNotASCII), vZero);
+			__m128i vPlain = _mm_andnot_si128(_mm_cmpeq_epi16(vUnits, vEscape), vASCII);
+			if (_mm_movemask_epi8(vPlain) != 0xFFFF)  {
+				break;
+			}
+			_mm_storel_epi64((__m128i *)(pOut + nWritten), _mm_packus_epi16(vUnits, vUnits));
+			nDone += 16;
+			nWritten += 8;
+		}
+		return nDone;
+	}
+
+#endif // PDFLWRAP_SSE2
+
+	inline size_t
+	PDFDocBlocks(const unsigned char *pIn, size_t nLength, char *pOut)
+	{
+#ifdef PDFLWRAP_SSE2
+		return PDFDocBlocksSSE2(pIn, nLength, pOut);
+#else
+		return 0;
+#endif
+	}
+
+	inline size_t
+	UTF8Blocks(const unsigned char *pIn, size_t nLength, char *pOut)
+	{
+#ifdef PDFLWRAP_SSE2
+		return UTF8BlocksSSE2(pIn, nLength, pOut);
+#else
+		return 0;
+#endif
+	}
+
+	inline size_t
+	UTF16Blocks(const unsigned char *pIn, size_t nLength, char *pOut, size_t &nWritten)
+	{
+#ifdef PDFLWRAP_SSE2
+		return UTF16BlocksSSE2(pIn, nLength, pOut, nWritten);
+#else
+		nWritten = 0;
+		return 0;
+#endif
+	}
+
+	// at most 3 bytes of UTF-8 per byte
+	char *
+	DecodePDFDoc(const unsigned char *pIn, size_t nLength, char *pOut, bool &bValid)
+	{
+		size_t i = 0;
+		while (i < nLength)  {
+			size_t nBlock = PDFDocBlocks(pIn + i, nLength - i, pOut);
+			i += nBlock;
+			pOut += nBlock;
+			// up to the next block, or the end
+			size_t nEnd = (std::min)(nLength, i + 16);
+			for (; i<nEnd; i++)  {
+				unsigned int nByte = pIn[i], nCode = nByte;
+				if (nByte >= 0x18 && nByte < 0x20)  {
+					nCode = g_anPDFDocLow[nByte - 0x18];
+				} else if (nByte >= 0x7F)  {
+					nCode = g_anPDFDocHigh[nByte - 0x7F];
+					if (!nCode)  {
+						nCode = kReplacement;
+						bValid = false;
+					}
+				}
+				pOut = AppendUTF8(pOut, nCode);
+			}
+		}
+		return pOut;
+	}
+
+	// UTF-8 gets no longer by being checked
+	char *
+	DecodeUTF8(const unsigned char *pIn, size_t nLength, char *pOut, bool &bValid)
+	{
+		size_t i = 0;
+		while (i < nLength)  {
+			size_t nBlock = UTF8Blocks(pIn + i, nLength - i, pOut);
+			i += nBlock;
+			pOut += nBlock;
+			if (i == nLength)  {
+				break;
+			}
+
+			unsigned int nByte = pIn[i];
+			if (nByte < 0x80)  {
+				*pOut++ = (char)nByte;
+				i++;
+				continue;
+			}
+			if (nByte < 0xC2 || nByte > 0xF4)  {
+				pOut = AppendUTF8(pOut, kReplacement);
+				bValid = false;
+				i++;
+				continue;
+			}
+			size_t nFollowing = nByte >= 0xF0 ? 3 : nByte >= 0xE0 ? 2 : 1;
+			unsigned int nCode = nByte & (0x3F >> nFollowing);
+			size_t j = 1;
+			for (; j<=nFollowing && i+j<nLength && (pIn[i + j] & 0xC0) == 0x80; j++)  {
+				nCode = (nCode << 6) | (pIn[i + j] & 0x3F);
+			}
+			// overlong, surrogates, beyond U+10FFFF or cut short
+			static const unsigned int anMinimum[4] =  { 0, 0x80, 0x800, 0x10000 };
+			if (j <= nFollowing || nCode < anMinimum[nFollowing] ||
+				(nCode >= 0xD800 && nCode < 0xE000) || nCode > 0x10FFFF)
+			{
+				pOut = AppendUTF8(pOut, kReplacement);
+				bValid = false;
+				i += j;
+				continue;
+			}
+			memcpy(pOut, pIn + i, j);
+			pOut += j;
+			i += j;
+		}
+		return pOut;
+	}
+
+	// 3 bytes of UTF-8 per code unit at most:  a pair of surrogates is 4
+	char *
+	DecodeUTF16BE(const unsigned char *pIn, size_t nLength, char *pOut, bool &bValid)
+	{
+		bool bLanguage = false;
+		size_t i = 0;
+		while (i + 1 < nLength)  {
+			if (!bLanguage)  {
+				size_t nWritten;
+				i += UTF16Blocks(pIn + i, nLength - i, pOut, nWritten);
+				pOut += nWritten;
+				if (i + 1 >= nLength)  {
+					break;
+				}
+			}
+
+			unsigned int nCode = (pIn[i] << 8) | pIn[i + 1];
+			i += 2;
+			if (nCode == kEscape)  {
+				bLanguage = !bLanguage;
+				continue;
+			}
+			if (bLanguage)  {
+				continue;
+			}
+			if (nCode >= 0xD800 && nCode < 0xDC00 && i + 1 < nLength)  {
+				unsigned int nLow = (pIn[i] << 8) | pIn[i + 1];
+				if (nLow >= 0xDC00 && nLow < 0xE000)  {
+					nCode = 0x10000 + ((nCode - 0xD800) << 10) + (nLow - 0xDC00);
+					i += 2;
+				}
+			}
+			if (nCode >= 0xD800 && nCode < 0xE000)  {
+				nCode = kReplacement;
+				bValid = false;
+			}
+			pOut = AppendUTF8(pOut, nCode);
+		}
+		if (i < nLength)  {
+			pOut = AppendUTF8(pOut, kReplacement);
+			bValid = false;
+		}
+		return pOut;
+	}
+
+}
+
+namespace PDFLibWrapper  {
+
+TextEncoding
+GetTextEncoding(const char *pData, size_t nLength)
+{
+	const unsigned char *p = (const unsigned char *)pData;
+	if (nLength >= 2 && p[0] == 0xFE && p[1] == 0xFF)  {
+		return kTextUTF16BE;
+	}
+	if (nLength >= 3 && p[0] == 0xEF && p[1] == 0xBB && p[2] == 0xBF)  {
+		return kTextUTF8;
+	}
+	return kTextPDFDoc;
+}
+
+bool
+DecodeTextString(const char *pData, size_t nLength, std::string &sUTF8)
+{
+	const unsigned char *pIn = (const unsigned char *)pData;
+	bool bValid = true;
+	// written in place, into room for the longest result
+	sUTF8.resize(nLength * 3 + 1);
+	char *pStart = &sUTF8[0], *pEnd = pStart;
+	switch (GetTextEncoding(pData, nLength))  {
+		case kTextUTF16BE:
+			pEnd = DecodeUTF16BE(pIn + 2, nLength - 2, pStart, bValid);
+			break;
+		case kTextUTF8:
+			pEnd = DecodeUTF8(pIn + 3, nLength - 3, pStart, bValid);
+			break;
+		default:
+			pEnd = DecodePDFDoc(pIn, nLength, pStart, bValid);
+			break;
+	}
+	sUTF8.resize(pEnd - pStart);
+	return bValid;
+}
+
+bool
+GetText(Object &rObject, const Name &nmKey, std::string &sUTF8)
+{
+	std::string sText;
+	if (!rObject.Get(sText, nmKey))  {
+		return false;
+	}
+	DecodeTextString(sText, sUTF8);
+	return true;
+}
+
+bool
+GetText(Object &rObject, int nIndex, std::string &sUTF8)
+{
+	std::string sText;
+	if (!rObject.Get(sText, nIndex))  {
+		return false;
+	}
+	DecodeTextString(sText, sUTF8);
+	return true;
+}
+
+}
@@ -0,0 +1,49 @@
+/*
+ *  PDFLibText.h
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#ifndef APAGO_PDFLibText_h__
+#define APAGO_PDFLibText_h__
+
+#include <string>
+
+#include "PDFLibWrapper.h"
+
+namespace PDFLibWrapper  {
+
+	// Text strings as used for metadata, outlines, annotations and field
+	// names:  UTF-16BE behind the byte order mark FE FF, UTF-8 behind
+	// EF BB BF, or else PDFDocEncoding.  They are converted to UTF-8
+	// directly; runs of ASCII are copied in blocks.
+
+	enum TextEncoding  {
+		kTextPDFDoc,
+		kTextUTF16BE,
+		kTextUTF8
+	};
+
+	TextEncoding GetTextEncoding(const char *pData, size_t nLength);
+
+	// Replaces sUTF8 with the text, without its byte order mark and the
+	// language codes UTF-16 strings may have between two U+001B.  Bytes
+	// or code units that are invalid in the encoding, or undefined in
+	// PDFDocEncoding, become U+FFFD; false if there were any.
+	bool DecodeTextString(const char *pData, size_t nLength, std::string &sUTF8);
+
+	inline bool
+	DecodeTextString(const std::string &sText, std::string &sUTF8)
+	{
+		return DecodeTextString(sText.data(), sText.size(), sUTF8);
+	}
+
+	// the string under a key or at an index, as UTF-8; false if it is not
+	// a string
+	bool GetText(Object &rObject, const Name &nmKey, std::string &sUTF8);
+	bool GetText(Object &rObject, int nIndex, std::string &sUTF8);
+
+}
+
+#endif // APAGO_PDFLibText_h__
@@ -0,0 +1,291 @@
+/*
+ *  PDFLibTrace.cpp
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <boost/thread.hpp>
+
+#include "PDFLibTrace.h"
+
+
+namespace  {
+
+	using namespace PDFLibWrapper;
+
+	typedef boost::mutex Mutex;
+	typedef boost::unique_lock<Mutex> Lock;
+
+	// Only the recording thread adds to its buffer, so its lock is only
+	// ever waited for while the buffer is being written out.
+	struct ThreadTrace  {
+		explicit ThreadTrace(unsigned int nThread) : m_nThread(nThread), m_nDropped(0)  { }
+
+		Mutex m_mtx;
+		unsigned int m_nThread;
+		std::vector<TraceEvent> m_vEvents;
+		boost::uint64_t m_nDropped;
+	};
+
+	void RetireThreadTrace(ThreadTrace *pTrace);
+
+	// Created on first use and never destroyed, like the statistics.
+	struct TraceRegistry  {
+		TraceRegistry()
+			: m_pThreadTrace(RetireThreadTrace), m_nNextThread(1), m_nMaxEvents(0),
+			  m_nOrigin(0), m_nDropped(0)
+		{ }
+
+		Mutex m_mtx;
+		boost::thread_specific_ptr<ThreadTrace> m_pThreadTrace;
+		std::set<ThreadTrace *> m_setThreads;
+		// of threads that have ended, deleted once written
+		std::vector<ThreadTrace *> m_vRetired;
+		unsigned int m_nNextThread;
+		boost::atomic<size_t> m_nMaxEvents;
+		// timestamps are written relative to the first Start
+		boost::uint64_t m_nOrigin;
+		// by threads that have ended
+		boost::uint64_t m_nDropped;
+	};
+
+	TraceRegistry &
+	GetRegistry()
+	{
+		static TraceRegistry *pRegistry = new TraceRegistry;
+		return *pRegistry;
+	}
+
+	void
+	RetireThreadTrace(ThreadTrace *pTrace)
+	{
+		TraceRegistry &rRegistry = GetRegistry();
+		Lock lck(rRegistry.m_mtx);
+		rRegistry.m_setThreads.erase(pTrace);
+		rRegistry.m_nDropped += pTrace->m_nDropped;
+		pTrace->m_nDropped = 0;
+		if (pTrace->m_vEvents.empty())  {
+			delete pTrace;
+		} else  {
+			rRegistry.m_vRetired.push_back(pTrace);
+		}
+	}
+
+	ThreadTrace &
+	GetThreadTrace()
+	{
+		TraceRegistry &rRegistry = GetRegistry();
+		ThreadTrace *pTrace = rRegistry.m_pThreadTrace.get();
+		if (!pTrace)  {
+			Lock lck(rRegistry.m_mtx);
+			pTrace = new ThreadTrace(rRegistry.m_nNextThread++);
+			rRegistry.m_setThreads.insert(pTrace);
+			lck.unlock();
+			rRegistry.m_pThreadTrace.reset(pTrace);
+		}
+		return *pTrace;
+	}
+
+	unsigned long
+	GetProcessID()
+	{
+#ifdef _WIN32
+		return GetCurrentProcessId();
+#else
+		return (unsigned long)getpid();
+#endif
+	}
+
+	void
+	WriteString(std::ostream &rOut, const char *szText)
+	{
+		rOut << '"';
+		for (const char *p = szText; *p; p++)  {
+			if (*p == '"' || *p == '\\')  {
+				rOut << '\\' << *p;
+			} else if ((unsigned char)*p < 0x20)  {
+				char szEscape[8];
+				sprintf(szEscape, "\\u%04x", (unsigned char)*p);
+				rOut << szEscape;
+			} else  {
+				rOut << *p;
+			}
+		}
+		rOut << '"';
+	}
+
+	// in µs, as the format wants
+	void
+	WriteTime(std::ostream &rOut, boost::uint64_t nNanoseconds)
+	{
+		char szTime[32];
+		sprintf(szTime, "%llu.%03u", (unsigned long long)(nNanoseconds / 1000),
+			(unsigned int)(nNanoseconds % 1000));
+		rOut << szTime;
+	}
+
+	void
+	WriteEvents(std::ostream &rOut, unsigned long nProcess, unsigned int nThread,
+		boost::uint64_t nOrigin, const std::vector<TraceEvent> &vEvents, bool &bFirst)
+	{
+		std::vector<TraceEvent>::const_iterator it = vEvents.begin(), itEnd = vEvents.end();
+		for (; it != itEnd; ++it)  {
+			rOut << (bFirst ? "\n" : ",\n") << "{\"name\":";
+			WriteString(rOut, it->m_szName);
+			rOut << ",\"cat\":";
+			WriteString(rOut, it->m_szCategory);
+			rOut << ",\"ph\":\"X\",\"ts\":";
+			WriteTime(rOut, it->m_nStart > nOrigin ? it->m_nStart - nOrigin : 0);
+			rOut << ",\"dur\":";
+			WriteTime(rOut, it->m_nDuration);
+			rOut << ",\"pid\":" << nProcess << ",\"tid\":" << nThread;
+			if (it->m_nArg != TraceEvent::kNoArg)  {
+				rOut << ",\"args\":{\"id\":" << it->m_nArg << "}";
+			}
+			rOut << "}";
+			bFirst = false;
+		}
+	}
+
+}
+
+namespace PDFLibWrapper  {
+
+boost::atomic<bool> Tracer::s_bEnabled(false);
+
+void
+Tracer::Start(size_t nMaxEvents /*= 1024 * 1024*/)
+{
+	TraceRegistry &rRegistry = GetRegistry();
+	Lock lck(rRegistry.m_mtx);
+	rRegistry.m_nMaxEvents = nMaxEvents;
+	if (!rRegistry.m_nOrigin)  {
+		rRegistry.m_nOrigin = Statistics::Now();
+	}
+	rRegistry.m_nDropped = 0;
+	for (std::set<ThreadTrace *>::const_iterator it = rRegistry.m_setThreads.begin();
+		it != rRegistry.m_setThreads.end(); ++it)
+	{
+		Lock lckThread((*it)->m_mtx);
+		(*it)->m_nDropped = 0;
+	}
+	s_bEnabled.store(true, boost::memory_order_release);
+}
+
+void
+Tracer::Stop()
+{
+	s_bEnabled.store(false, boost::memory_order_release);
+}
+
+void
+Tracer::Record(const TraceEvent &rEvent)
+{
+	ThreadTrace &rTrace = GetThreadTrace();
+	size_t nMaxEvents = GetRegistry().m_nMaxEvents.load(boost::memory_order_relaxed);
+	Lock lck(rTrace.m_mtx);
+	if (rTrace.m_vEvents.size() < nMaxEvents)  {
+		rTrace.m_vEvents.push_back(rEvent);
+	} else  {
+		++rTrace.m_nDropped;
+	}
+}
+
+void
+Tracer::Write(std::ostream &rOut)
+{
+	TraceRegistry &rRegistry = GetRegistry();
+	unsigned long nProcess = GetProcessID();
+	bool bFirst = true;
+
+	// Taken out under the lock, a thread at a time, and written after it
+	// is released:  recording threads wait only for the swap, and
+	// registering ones not for the output at all.
+	std::vector<std::pair<unsigned int, std::vector<TraceEvent> > > vThreads;
+	std::vector<ThreadTrace *> vRetired;
+	boost::uint64_t nOrigin;
+	{
+		Lock lck(rRegistry.m_mtx);
+		nOrigin = rRegistry.m_nOrigin;
+		vThreads.resize(rRegistry.m_setThreads.size());
+		size_t nThread = 0;
+		for (std::set<ThreadTrace *>::const_iterator it = rRegistry.m_setThreads.begin();
+			it != rRegistry.m_setThreads.end(); ++it, ++nThread)
+		{
+			vThreads[nThread].first = (*it)->m_nThread;
+			Lock lckThread((*it)->m_mtx);
+			vThreads[nThread].second.swap((*it)->m_vEvents);
+		}
+		vRetired.swap(rRegistry.m_vRetired);
+	}
+
+	rOut << "{\"traceEvents\":[";
+	for (size_t i=0; i<vThreads.size(); i++)  {
+		WriteEvents(rOut, nProcess, vThreads[i].first, nOrigin, vThreads[i].second, bFirst);
+	}
+	for (size_t i=0; i<vRetired.size(); i++)  {
+		WriteEvents(rOut, nProcess, vRetired[i]->m_nThread, nOrigin, vRetired[i]->m_vEvents,
+			bFirst);
+		delete vRetired[i];
+	}
+	rOut << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	rOut.flush();
+}
+
+bool
+Tracer::Write(const std::string &sFileName)
+{
+	std::ofstream oOut(sFileName.c_str(), std::ios::out | std::ios::binary);
+	if (!oOut)  {
+		return false;
+	}
+	Write(oOut);
+	return oOut.good();
+}
+
+void
+Tracer::Clear()
+{
+	TraceRegistry &rRegistry = GetRegistry();
+	Lock lck(rRegistry.m_mtx);
+	for (std::set<ThreadTrace *>::const_iterator it = rRegistry.m_setThreads.begin();
+		it != rRegistry.m_setThreads.end(); ++it)
+	{
+		Lock lckThread((*it)->m_mtx);
+		std::vector<TraceEvent>().swap((*it)->m_vEvents);
+	}
+	for (size_t i=0; i<rRegistry.m_vRetired.size(); i++)  {
+		delete rRegistry.m_vRetired[i];
+	}
+	rRegistry.m_vRetired.clear();
+}
+
+boost::uint64_t
+Tracer::GetDropped()
+{
+	TraceRegistry &rRegistry = GetRegistry();
+	Lock lck(rRegistry.m_mtx);
+	boost::uint64_t nDropped = rRegistry.m_nDropped;
+	for (std::set<ThreadTrace *>::const_iterator it = rRegistry.m_setThreads.begin();
+		it != rRegistry.m_setThreads.end(); ++it)
+	{
+		Lock lckThread((*it)->m_mtx);
+		nDropped += (*it)->m_nDropped;
+	}
+	return nDropped;
+}
+
+}
@@ -0,0 +1,100 @@
+/*
+ *  PDFLibTrace.h
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#ifndef APAGO_PDFLibTrace_h__
+#define APAGO_PDFLibTrace_h__
+
+#include <iosfwd>
+#include <string>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+
+#include "PDFLibStats.h"
+
+namespace PDFLibWrapper  {
+
+	// Spans of what the wrapper spends its time on, written in the Chrome
+	// trace event format for chrome://tracing or Perfetto.  Off until
+	// Tracer::Start; while off a span costs a test of one flag.  Every thread
+	// records into a buffer of its own, collected by Tracer::Write.
+	// Defining PDFLIB_NO_TRACING compiles the spans out of the wrapper.
+
+	struct TraceEvent  {
+		enum  { kNoArg = -1 };
+
+		// static strings
+		const char *m_szName;
+		const char *m_szCategory;
+		// ns, from Statistics::Now
+		boost::uint64_t m_nStart;
+		boost::uint64_t m_nDuration;
+		// an object ID or the like, kNoArg if none
+		boost::int64_t m_nArg;
+	};
+
+	class Tracer  {
+	public:
+		// records from here on, each thread at most nMaxEvents not yet
+		// written; events beyond that are dropped
+		static void Start(size_t nMaxEvents = 1024 * 1024);
+		// recorded events are kept until written or cleared
+		static void Stop();
+		static bool IsEnabled()  { return s_bEnabled.load(boost::memory_order_relaxed); }
+
+		static void Record(const TraceEvent &rEvent);
+
+		// writes the events recorded so far as a JSON trace and drops them
+		static void Write(std::ostream &rOut);
+		static bool Write(const std::string &sFileName);
+		static void Clear();
+		// events dropped over full buffers since Start
+		static boost::uint64_t GetDropped();
+
+	private:
+		static boost::atomic<bool> s_bEnabled;
+	};
+
+	class ScopedTraceSpan : private boost::noncopyable  {
+	public:
+		ScopedTraceSpan(const char *szName, const char *szCategory,
+			boost::int64_t nArg = TraceEvent::kNoArg)
+		{
+			m_oEvent.m_szName = NULL;
+			if (Tracer::IsEnabled())  {
+				m_oEvent.m_szName = szName;
+				m_oEvent.m_szCategory = szCategory;
+				m_oEvent.m_nArg = nArg;
+				m_oEvent.m_nStart = Statistics::Now();
+			}
+		}
+		~ScopedTraceSpan()  {
+			if (m_oEvent.m_szName)  {
+				m_oEvent.m_nDuration = Statistics::Now() - m_oEvent.m_nStart;
+				Tracer::Record(m_oEvent);
+			}
+		}
+
+	private:
+		TraceEvent m_oEvent;
+	};
+
+}
+
+// one span per scope
+#ifdef PDFLIB_NO_TRACING
+#define PDFLIB_TRACE_SPAN(szName, szCategory)  ((void)0)
+#define PDFLIB_TRACE_SPAN_ARG(szName, szCategory, nArg)  ((void)0)
+#else
+#define PDFLIB_TRACE_SPAN(szName, szCategory)  \
+	::PDFLibWrapper::ScopedTraceSpan oTraceSpan(szName, szCategory)
+#define PDFLIB_TRACE_SPAN_ARG(szName, szCategory, nArg)  \
+	::PDFLibWrapper::ScopedTraceSpan oTraceSpan(szName, szCategory, nArg)
+#endif
+
+#endif // APAGO_PDFLibTrace_h__
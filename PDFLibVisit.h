@@ -0,0 +1,157 @@
+/*
+ *  PDFLibVisit.h
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#ifndef APAGO_PDFLibVisit_h__
+#define APAGO_PDFLibVisit_h__
+
+#include <string>
+#include <vector>
+
+#include "PDFLibWrapper.h"
+
+namespace PDFLibWrapper  {
+
+	// Dispatch on the type of values, once per value, to handlers that get
+	// the payload already taken out:  instead of GetType and then a Get for
+	// that type, which asks the backend twice and checks the type again.
+	// The elements of an array or the entries of a dictionary come from a
+	// single call to the backend, see Object::ExtractElements.
+	//
+	// A visitor derives from ValueVisitor and hides the handlers it wants.
+	// Nothing is virtual; the Visit functions are instantiated for the
+	// visitor, so the handlers are called directly and can be inlined.
+	//
+	//     struct IntegerSum : public ValueVisitor  {
+	//         IntegerSum() : m_nSum(0)  { }
+	//         void OnInteger(boost::int64_t nValue)  { m_nSum += nValue; }
+	//         boost::int64_t m_nSum;
+	//     };
+	//     IntegerSum oSum;
+	//     VisitElements(*pWidths, oSum);
+
+	struct ValueVisitor  {
+		void OnNull()  { }
+		void OnBoolean(bool)  { }
+		void OnInteger(boost::int64_t)  { }
+		void OnReal(double)  { }
+		void OnName(const Name &)  { }
+		void OnString(const std::string &)  { }
+		// the object, to look into with VisitElements or VisitEntries
+		void OnArray(const Object::Ptr &)  { }
+		void OnDict(const Object::Ptr &)  { }
+		void OnStream(const Object::Ptr &)  { }
+		// a value that could not be read
+		void OnUnknown()  { }
+
+		// before the value of each element, or each entry
+		void OnIndex(int)  { }
+		void OnKey(const Name &)  { }
+	};
+
+	template <class V>
+	inline void
+	VisitValue(const Object::Value &rValue, V &rVisitor)
+	{
+		switch (rValue.m_eType)  {
+			case Object::kNull:
+				rVisitor.OnNull();
+				break;
+			case Object::kBoolean:
+				rVisitor.OnBoolean(rValue.m_bBoolean);
+				break;
+			case Object::kInteger:
+				rVisitor.OnInteger(rValue.m_nInteger);
+				break;
+			case Object::kFixed:
+				rVisitor.OnReal(rValue.m_dReal);
+				break;
+			case Object::kName:
+				rVisitor.OnName(rValue.m_nmName);
+				break;
+			case Object::kString:
+				rVisitor.OnString(rValue.m_sString);
+				break;
+			case Object::kArray:
+				rVisitor.OnArray(rValue.m_pObject);
+				break;
+			case Object::kDict:
+				rVisitor.OnDict(rValue.m_pObject);
+				break;
+			case Object::kStream:
+				rVisitor.OnStream(rValue.m_pObject);
+				break;
+			default:
+				rVisitor.OnUnknown();
+				break;
+		}
+	}
+
+	// the value of pObject itself
+	template <class V>
+	inline bool
+	Visit(const Object::Ptr &pObject, V &rVisitor)
+	{
+		Object::Value oValue;
+		if (!Object::Extract(pObject, oValue))  {
+			return false;
+		}
+		VisitValue(oValue, rVisitor);
+		return true;
+	}
+
+	// vValues holds the values while they are visited; passing the same
+	// one to every call saves allocations, but a visitor going deeper from
+	// its handlers needs another for each level.  False if rArray is not
+	// an array.
+	template <class V>
+	inline bool
+	VisitElements(Object &rArray, V &rVisitor, std::vector<Object::Value> &vValues)
+	{
+		if (!rArray.ExtractElements(vValues))  {
+			return false;
+		}
+		for (size_t i=0; i<vValues.size(); i++)  {
+			rVisitor.OnIndex((int)i);
+			VisitValue(vValues[i], rVisitor);
+		}
+		return true;
+	}
+
+	template <class V>
+	inline bool
+	VisitElements(Object &rArray, V &rVisitor)
+	{
+		std::vector<Object::Value> vValues;
+		return VisitElements(rArray, rVisitor, vValues);
+	}
+
+	// in no set order; false if rDict is neither a dictionary nor a stream
+	template <class V>
+	inline bool
+	VisitEntries(Object &rDict, V &rVisitor, std::vector<Object::Entry> &vEntries)
+	{
+		if (!rDict.ExtractEntries(vEntries))  {
+			return false;
+		}
+		for (size_t i=0; i<vEntries.size(); i++)  {
+			rVisitor.OnKey(vEntries[i].m_nmKey);
+			VisitValue(vEntries[i].m_oValue, rVisitor);
+		}
+		return true;
+	}
+
+	template <class V>
+	inline bool
+	VisitEntries(Object &rDict, V &rVisitor)
+	{
+		std::vector<Object::Entry> vEntries;
+		return VisitEntries(rDict, rVisitor, vEntries);
+	}
+
+}
+
+#endif // APAGO_PDFLibVisit_h__
@@ -5,18 +5,44 @@
  *
  */
 
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <iostream>
+#include <map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include <boost/thread.hpp>
 #include <boost/thread/shared_mutex.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/assign/list_of.hpp>
+#include <boost/atomic.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
 
 #ifdef PDFLIB_USE_CONTENTS_PARSER
 #include "apago/ContentsParser.h"
 #endif // PDFLIB_USE_CONTENTS_PARSER
 
 #include "PDFLibWrapper.h"
+#include "PDFLibContent.h"
+#include "PDFLibStats.h"
+#include "PDFLibTrace.h"
+#include "PDFLibXRef.h"
 
 
 namespace  {
@@ -44,111 +70,1313 @@ namespace  {
 	typedef boost::ptr_vector<std::string> NameStringVector;
 	typedef std::map<std::string, Object::Type> TypeMap;
 
-	int g_nUnassignedToken = boost::integer_traits<unsigned int>::const_max;
-	Mutex g_mtxNameStrings;
-	NameStringMap g_mNameStrings;
-	NameStringVector g_vNameStrings;
-	TypeMap g_mTypeMap = boost::assign::map_list_of
-		("CosNull", Object::kNull)
-		("CosArray", Object::kArray)
-		("CosBoolean", Object::kBoolean)
-		("CosBool", Object::kBoolean)  // used in DVA
-		("CosDict", Object::kDict)
-		("CosFixed", Object::kFixed)
-		("CosInteger", Object::kInteger)
-		("CosName", Object::kName)
-		("CosNull", Object::kNull)
-		("CosStream", Object::kStream)
-		("CosString", Object::kString);
+	int g_nUnassignedToken = boost::integer_traits<unsigned int>::const_max;
+	Mutex g_mtxNameStrings;
+	NameStringMap g_mNameStrings;
+	NameStringVector g_vNameStrings;
+	TypeMap g_mTypeMap = boost::assign::map_list_of
+		("CosNull", Object::kNull)
+		("CosArray", Object::kArray)
+		("CosBoolean", Object::kBoolean)
+		("CosBool", Object::kBoolean)  // used in DVA
+		("CosDict", Object::kDict)
+		("CosFixed", Object::kFixed)
+		("CosInteger", Object::kInteger)
+		("CosName", Object::kName)
+		("CosNull", Object::kNull)
+		("CosStream", Object::kStream)
+		("CosString", Object::kString);
+
+	void
+	AppendNumber(std::string &sDest, long nValue)
+	{
+		char szDigits[24];
+		char *pDigit = szDigits + sizeof(szDigits);
+		unsigned long nRest = nValue < 0 ? 0ul - nValue : nValue;
+		do  {
+			*--pDigit = (char)('0' + nRest % 10);
+			nRest /= 10;
+		} while (nRest);
+		if (nValue < 0)  {
+			*--pDigit = '-';
+		}
+		sDest.append(pDigit, szDigits + sizeof(szDigits));
+	}
+
+	// Layout of a shared name table:  this header, the offsets of the names
+	// in the order they were interned, then the names, each its length
+	// followed by its characters.  Entries below m_nCount never change, so
+	// reading them takes no lock; appending one takes m_mtxAppend.  The
+	// process whose create_only open of the segment succeeds sizes it and
+	// sets up the rest, moving m_nState to kReady last; the others open it
+	// with open_only and wait for both.  Waiting for either, or for
+	// m_mtxAppend, gives up after SharedNameTable::kTimeoutMS; a process
+	// that times out while attached detaches, and IsSharedTable is false
+	// from then on.
+	struct SharedNameHeader  {
+		enum  { kMagic = 0x4e4c4450, kInitializing = 1, kReady = 2 };
+
+		boost::uint32_t m_nMagic;
+		boost::uint32_t m_nHeaderSize;
+		boost::atomic<boost::uint32_t> m_nState;
+		boost::uint32_t m_nMaxNames;
+		boost::uint32_t m_nPoolSize;
+		boost::uint32_t m_nPoolUsed;
+		boost::interprocess::interprocess_mutex m_mtxAppend;
+		boost::atomic<boost::uint32_t> m_nCount;
+	};
+
+#if BOOST_ATOMIC_INT32_LOCK_FREE != 2
+#error "the shared name table needs lock-free 32-bit atomics"
+#endif
+
+	class SharedNameTable  {
+	public:
+		typedef boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> Lock;
+
+		// A process that dies while holding the lock or initializing the
+		// segment would hold up the others for good; they give up on the
+		// table after this long instead.
+		enum  { kTimeoutMS = 2000 };
+
+		static SharedNameTable *Open(const std::string &sName, size_t nBytes)  {
+			SharedNameTable *pTable = NULL;
+			try  {
+				pTable = new SharedNameTable;
+				if (pTable->Map(sName, nBytes))  {
+					return pTable;
+				}
+			} catch (const boost::interprocess::interprocess_exception &)  {
+			}
+			delete pTable;
+			return NULL;
+		}
+
+		// the lock for Append; rLock.owns() is false if it timed out
+		void TryLock(Lock &rLock)  {
+			Lock(m_pHeader->m_mtxAppend, GetDeadline()).swap(rLock);
+		}
+
+		boost::uint32_t GetCount() const  {
+			return m_pHeader->m_nCount.load(boost::memory_order_acquire);
+		}
+
+		// of an entry below GetCount
+		void GetName(boost::uint32_t nIndex, std::string &sName) const  {
+			const char *pEntry = m_pPool + m_pOffsets[nIndex];
+			boost::uint32_t nLength;
+			memcpy(&nLength, pEntry, sizeof(nLength));
+			sName.assign(pEntry + sizeof(nLength), nLength);
+		}
+
+		// under the Lock of TryLock; false once the segment is full
+		bool Append(const std::string &sName)  {
+			boost::uint32_t nCount = m_pHeader->m_nCount.load(boost::memory_order_relaxed);
+			boost::uint32_t nLength = (boost::uint32_t)sName.size();
+			size_t nEntrySize = sizeof(nLength) + sName.size();
+			if (nCount >= m_pHeader->m_nMaxNames ||
+				m_pHeader->m_nPoolSize - m_pHeader->m_nPoolUsed < nEntrySize)
+			{
+				return false;
+			}
+			char *pEntry = m_pPool + m_pHeader->m_nPoolUsed;
+			memcpy(pEntry, &nLength, sizeof(nLength));
+			memcpy(pEntry + sizeof(nLength), sName.data(), sName.size());
+			m_pOffsets[nCount] = m_pHeader->m_nPoolUsed;
+			m_pHeader->m_nPoolUsed += (boost::uint32_t)nEntrySize;
+			m_pHeader->m_nCount.store(nCount + 1, boost::memory_order_release);
+			return true;
+		}
+
+	private:
+		SharedNameTable() : m_pHeader(NULL), m_pOffsets(NULL), m_pPool(NULL)  { }
+
+		static boost::posix_time::ptime GetDeadline()  {
+			return boost::posix_time::microsec_clock::universal_time() +
+				boost::posix_time::milliseconds((long)kTimeoutMS);
+		}
+
+		// The process that creates the segment sizes and initializes it;
+		// the others wait for it, and take the segment only at the size
+		// they asked for.
+		bool Map(const std::string &sName, size_t nBytes)  {
+			namespace bip = boost::interprocess;
+			bool bCreated = true;
+			try  {
+				bip::shared_memory_object(bip::create_only, sName.c_str(), bip::read_write).swap(m_oSegment);
+			} catch (const bip::interprocess_exception &)  {
+				bCreated = false;
+				bip::shared_memory_object(bip::open_only, sName.c_str(), bip::read_write).swap(m_oSegment);
+			}
+
+			boost::posix_time::ptime tmDeadline = GetDeadline();
+			bip::offset_t nSize = 0;
+			if (bCreated)  {
+				m_oSegment.truncate((bip::offset_t)nBytes);
+			} else  {
+				while (m_oSegment.get_size(nSize) && nSize == 0 &&
+					boost::posix_time::microsec_clock::universal_time() < tmDeadline)
+				{
+					boost::this_thread::yield();
+				}
+				if (nSize != (bip::offset_t)nBytes)  {
+					return false;
+				}
+			}
+			bip::mapped_region(m_oSegment, bip::read_write).swap(m_oRegion);
+			size_t nMapped = m_oRegion.get_size();
+			if (nMapped < sizeof(SharedNameHeader))  {
+				return false;
+			}
+
+			m_pHeader = static_cast<SharedNameHeader *>(m_oRegion.get_address());
+			boost::uint32_t nState;
+			if (bCreated)  {
+				m_pHeader->m_nState.store(SharedNameHeader::kInitializing, boost::memory_order_relaxed);
+				new (&m_pHeader->m_mtxAppend) bip::interprocess_mutex;
+				m_pHeader->m_nMagic = SharedNameHeader::kMagic;
+				m_pHeader->m_nHeaderSize = sizeof(SharedNameHeader);
+				// room for names of 28 characters on average
+				size_t nFree = (std::min)(nMapped - sizeof(SharedNameHeader),
+					(size_t)boost::integer_traits<boost::uint32_t>::const_max);
+				m_pHeader->m_nMaxNames = (boost::uint32_t)(nFree / 32);
+				m_pHeader->m_nPoolSize = (boost::uint32_t)(nFree - m_pHeader->m_nMaxNames * sizeof(boost::uint32_t));
+				m_pHeader->m_nPoolUsed = 0;
+				m_pHeader->m_nCount.store(0, boost::memory_order_relaxed);
+				nState = SharedNameHeader::kReady;
+				m_pHeader->m_nState.store(nState, boost::memory_order_release);
+			} else  {
+				while ((nState = m_pHeader->m_nState.load(boost::memory_order_acquire)) !=
+					SharedNameHeader::kReady &&
+					boost::posix_time::microsec_clock::universal_time() < tmDeadline)
+				{
+					boost::this_thread::yield();
+				}
+			}
+			// another build, or a creator that died
+			if (nState != SharedNameHeader::kReady ||
+				m_pHeader->m_nMagic != SharedNameHeader::kMagic ||
+				m_pHeader->m_nHeaderSize != sizeof(SharedNameHeader) ||
+				sizeof(SharedNameHeader) + m_pHeader->m_nMaxNames * sizeof(boost::uint32_t) +
+					(size_t)m_pHeader->m_nPoolSize > nMapped)
+			{
+				return false;
+			}
+			m_pOffsets = reinterpret_cast<boost::uint32_t *>(m_pHeader + 1);
+			m_pPool = reinterpret_cast<char *>(m_pOffsets + m_pHeader->m_nMaxNames);
+			return true;
+		}
+
+		boost::interprocess::shared_memory_object m_oSegment;
+		boost::interprocess::mapped_region m_oRegion;
+		SharedNameHeader *m_pHeader;
+		boost::uint32_t *m_pOffsets;
+		char *m_pPool;
+	};
+
+	// while attached, the tokens of this process are the indexes of the
+	// shared table, all its names up to GetCount in g_vNameStrings
+	SharedNameTable *g_pSharedNames = NULL;
+
+	// under g_mtxNameStrings, held exclusively
+	NameStringMap::iterator
+	InternLocalName(const std::string &sName, NameStringMap::iterator itHint)
+	{
+		StringPointerWrapper oNewString(sName);
+		unsigned int nToken = g_vNameStrings.size();
+		g_vNameStrings.push_back(oNewString.m_pString);
+		NameStringMap::mapped_type oValue(nToken, oNewString.m_pString);
+		return g_mNameStrings.insert(itHint, NameStringMap::value_type(oNewString, oValue));
+	}
+
+	// what other processes interned since
+	void
+	ImportSharedNames()
+	{
+		boost::uint32_t nCount = g_pSharedNames->GetCount();
+		std::string sName;
+		while (g_vNameStrings.size() < nCount)  {
+			g_pSharedNames->GetName((boost::uint32_t)g_vNameStrings.size(), sName);
+			InternLocalName(sName, g_mNameStrings.lower_bound(sName));
+		}
+	}
+
+	NameStringMap::iterator
+	InternSharedName(const std::string &sName)
+	{
+		ImportSharedNames();
+		NameStringMap::iterator itFind = g_mNameStrings.lower_bound(sName);
+		if (itFind != g_mNameStrings.end() && itFind->first == sName)  {
+			return itFind;
+		}
+		{
+			SharedNameTable::Lock lckAppend;
+			g_pSharedNames->TryLock(lckAppend);
+			if (lckAppend.owns())  {
+				ImportSharedNames();
+				itFind = g_mNameStrings.lower_bound(sName);
+				if (itFind != g_mNameStrings.end() && itFind->first == sName)  {
+					return itFind;
+				}
+				if (g_pSharedNames->Append(sName))  {
+					PDFLIB_STAT_COUNT(kStatNameInserts);
+					return InternLocalName(sName, itFind);
+				}
+			}
+		}
+		// full, or locked by a process that died:  from here on tokens are
+		// of this process only
+		delete g_pSharedNames;
+		g_pSharedNames = NULL;
+		PDFLIB_STAT_COUNT(kStatNameInserts);
+		return InternLocalName(sName, itFind);
+	}
+
+	class MemoryReader : public Reader  {
+	public:
+		MemoryReader(const Object::Buffer &pData, size_t nLength)
+			: m_pData(pData), m_nLength(nLength)
+		{ }
+
+		virtual boost::int64_t GetSize() const  { return m_nLength; }
+
+		virtual size_t ReadAt(boost::int64_t nOffset, void *pDest, size_t nBytes)  {
+			if (nOffset < 0 || (boost::uint64_t)nOffset >= m_nLength)  {
+				return 0;
+			}
+			nBytes = (std::min)(nBytes, m_nLength - (size_t)nOffset);
+			memcpy(pDest, m_pData.get() + nOffset, nBytes);
+			return nBytes;
+		}
+
+	private:
+		Object::Buffer m_pData;
+		size_t m_nLength;
+	};
+
+#ifdef _WIN32
+	class FileReader : public Reader  {
+	public:
+		FileReader(FILE *pFile) : m_pFile(pFile), m_nSize(0)  {
+			_fseeki64(m_pFile, 0, SEEK_END);
+			m_nSize = _ftelli64(m_pFile);
+		}
+		~FileReader()  { fclose(m_pFile); }
+
+		static FileReader *Open(const std::string &sFileName)  {
+			FILE *pFile = fopen(sFileName.c_str(), "rb");
+			return pFile ? new FileReader(pFile) : NULL;
+		}
+
+		virtual boost::int64_t GetSize() const  { return m_nSize; }
+
+		boost::int64_t GetCurrentSize()  {
+			boost::unique_lock<boost::mutex> lck(m_mtx);
+			_fseeki64(m_pFile, 0, SEEK_END);
+			return _ftelli64(m_pFile);
+		}
+
+		virtual size_t ReadAt(boost::int64_t nOffset, void *pDest, size_t nBytes)  {
+			boost::unique_lock<boost::mutex> lck(m_mtx);
+			if (_fseeki64(m_pFile, nOffset, SEEK_SET) != 0)  {
+				return 0;
+			}
+			return fread(pDest, 1, nBytes, m_pFile);
+		}
+
+	private:
+		boost::mutex m_mtx;
+		FILE *m_pFile;
+		boost::int64_t m_nSize;
+	};
+#else
+	class FileReader : public Reader  {
+	public:
+		FileReader(int nFile) : m_nFile(nFile), m_nSize(0)  {
+			struct stat oStat;
+			if (fstat(m_nFile, &oStat) == 0)  {
+				m_nSize = oStat.st_size;
+			}
+		}
+		~FileReader()  { close(m_nFile); }
+
+		static FileReader *Open(const std::string &sFileName)  {
+			int nFile = open(sFileName.c_str(), O_RDONLY);
+			return nFile >= 0 ? new FileReader(nFile) : NULL;
+		}
+
+		virtual boost::int64_t GetSize() const  { return m_nSize; }
+
+		boost::int64_t GetCurrentSize()  {
+			struct stat oStat;
+			return fstat(m_nFile, &oStat) == 0 ? oStat.st_size : 0;
+		}
+
+		virtual void Prefetch(boost::int64_t nOffset, size_t nBytes)  {
+#if defined(POSIX_FADV_WILLNEED)
+			posix_fadvise(m_nFile, nOffset, nBytes, POSIX_FADV_WILLNEED);
+#elif defined(F_RDADVISE)
+			struct radvisory oAdvice;
+			oAdvice.ra_offset = nOffset;
+			oAdvice.ra_count = (int)nBytes;
+			fcntl(m_nFile, F_RDADVISE, &oAdvice);
+#endif
+		}
+
+		virtual size_t ReadAt(boost::int64_t nOffset, void *pDest, size_t nBytes)  {
+			size_t nTotal = 0;
+			while (nTotal < nBytes)  {
+				ssize_t nRead = pread(m_nFile, (char *)pDest + nTotal,
+					nBytes - nTotal, nOffset + nTotal);
+				if (nRead < 0 && errno == EINTR)  {
+					continue;
+				}
+				if (nRead <= 0)  {
+					break;
+				}
+				nTotal += nRead;
+			}
+			return nTotal;
+		}
+
+	private:
+		int m_nFile;
+		boost::int64_t m_nSize;
+	};
+#endif
+
+	const size_t kLinearizationHeaderSize = 1024;
+
+	enum LinearizationHeader  {
+		kHeaderIncomplete,		// the dictionary may still be arriving
+		kHeaderLinearized,
+		kHeaderPlain
+	};
+
+	// the first object of the file must be the linearization dictionary;
+	// only a dictionary that ends within the data counts
+	LinearizationHeader
+	ParseLinearization(const char *pData, size_t nLength, LinearizationInfo &rInfo)
+	{
+		ContentTokenizer oTokenizer;
+		ContentToken tokCurrent;
+		oTokenizer.Open(pData, nLength);
+		bool bDict = false;
+		while (oTokenizer.Next(tokCurrent))  {
+			if (tokCurrent.GetType() == ContentToken::kDictBegin)  {
+				bDict = true;
+				break;
+			}
+			if (tokCurrent.GetType() != ContentToken::kInteger && !tokCurrent.Is("obj"))  {
+				return kHeaderPlain;
+			}
+		}
+		if (!bDict)  {
+			return kHeaderIncomplete;
+		}
+
+		LinearizationInfo oInfo;
+		bool bLinearized = false, bComplete = false;
+		double dValue;
+		std::string sKey;
+		while (oTokenizer.Next(tokCurrent))  {
+			if (tokCurrent.GetType() == ContentToken::kDictEnd)  {
+				bComplete = true;
+				break;
+			}
+			if (tokCurrent.GetType() != ContentToken::kName)  {
+				continue;
+			}
+			sKey.assign(tokCurrent.GetData(), tokCurrent.GetLength());
+			if (!oTokenizer.Next(tokCurrent))  {
+				break;
+			}
+			if (sKey == "H" && tokCurrent.GetType() == ContentToken::kArrayBegin)  {
+				if (oTokenizer.Next(tokCurrent) && tokCurrent.Get(dValue))  {
+					oInfo.m_nHintOffset = (boost::int64_t)dValue;
+				}
+				if (oTokenizer.Next(tokCurrent) && tokCurrent.Get(dValue))  {
+					oInfo.m_nHintLength = (boost::int64_t)dValue;
+				}
+				while (tokCurrent.GetType() != ContentToken::kArrayEnd &&
+					oTokenizer.Next(tokCurrent))
+				{
+				}
+			} else if (tokCurrent.Get(dValue))  {
+				if (sKey == "Linearized")  {
+					bLinearized = true;
+				} else if (sKey == "L")  {
+					oInfo.m_nFileLength = (boost::int64_t)dValue;
+				} else if (sKey == "O")  {
+					oInfo.m_nFirstPageObject = (Object::ID)dValue;
+				} else if (sKey == "E")  {
+					oInfo.m_nFirstPageEnd = (boost::int64_t)dValue;
+				} else if (sKey == "N")  {
+					oInfo.m_nPageCount = (int)dValue;
+				} else if (sKey == "T")  {
+					oInfo.m_nMainXRefOffset = (boost::int64_t)dValue;
+				}
+			}
+		}
+		if (!bComplete)  {
+			return kHeaderIncomplete;
+		}
+		if (!bLinearized || oInfo.m_nFileLength <= 0)  {
+			return kHeaderPlain;
+		}
+		rInfo = oInfo;
+		return kHeaderLinearized;
+	}
+
+	class GrowingFileReader : public RangeReader  {
+	public:
+		GrowingFileReader(FileReader *pFile, boost::int64_t nFinalSize,
+			unsigned int nTimeoutMS)
+			: m_pFile(pFile), m_nFinalSize(nFinalSize), m_nHeaderSize(-1),
+			  m_bHeaderDone(false), m_nLastSize(0), m_nTimeoutMS(nTimeoutMS)
+		{ }
+
+		virtual boost::int64_t GetSize() const  {
+			boost::int64_t nFinalSize = GetFinalSize();
+			return nFinalSize ? nFinalSize : m_pFile->GetCurrentSize();
+		}
+
+		virtual size_t ReadAt(boost::int64_t nOffset, void *pDest, size_t nBytes)  {
+			return m_pFile->ReadAt(nOffset, pDest, nBytes);
+		}
+
+		virtual bool IsAvailable(boost::int64_t nOffset, size_t nBytes) const  {
+			boost::int64_t nEnd = nOffset + nBytes;
+			boost::int64_t nFinalSize = GetFinalSize();
+			if (nFinalSize)  {
+				nEnd = (std::min)(nEnd, nFinalSize);
+			}
+			return nEnd <= m_pFile->GetCurrentSize();
+		}
+
+		// the writer decides what arrives when, but what is there can be
+		// read ahead
+		virtual void Request(boost::int64_t nOffset, size_t nBytes)  {
+			m_pFile->Prefetch(nOffset, nBytes);
+		}
+
+		virtual bool WaitForData()  {
+			const unsigned int nPollMS = 10;
+			for (unsigned int nWaited=0; nWaited<=m_nTimeoutMS; nWaited+=nPollMS)  {
+				boost::int64_t nFinalSize = GetFinalSize();
+				boost::int64_t nSize = m_pFile->GetCurrentSize();
+				boost::unique_lock<boost::mutex> lck(m_mtx);
+				if (nSize > m_nLastSize)  {
+					m_nLastSize = nSize;
+					return true;
+				}
+				if (nFinalSize && nSize >= nFinalSize)  {
+					return false;
+				}
+				lck.unlock();
+				boost::this_thread::sleep(boost::posix_time::milliseconds(nPollMS));
+			}
+			return false;
+		}
+
+	private:
+		// /L, once the whole linearization dictionary has been written; the
+		// header is parsed again only when the file has grown since
+		boost::int64_t GetFinalSize() const  {
+			boost::unique_lock<boost::mutex> lck(m_mtx);
+			if (m_nFinalSize || m_bHeaderDone)  {
+				return m_nFinalSize;
+			}
+			boost::int64_t nSize = m_pFile->GetCurrentSize();
+			if (nSize == m_nHeaderSize)  {
+				return 0;
+			}
+			m_nHeaderSize = nSize;
+
+			char szHeader[kLinearizationHeaderSize];
+			size_t nRead = m_pFile->ReadAt(0, szHeader, kLinearizationHeaderSize);
+			LinearizationInfo oInfo;
+			switch (ParseLinearization(szHeader, nRead, oInfo))  {
+				case kHeaderLinearized:
+					m_nFinalSize = oInfo.m_nFileLength;
+					m_bHeaderDone = true;
+					break;
+				case kHeaderPlain:
+					m_bHeaderDone = true;
+					break;
+				default:
+					// a dictionary not ending in the first 1024 bytes never will
+					m_bHeaderDone = nRead >= kLinearizationHeaderSize;
+					break;
+			}
+			return m_nFinalSize;
+		}
+
+		boost::scoped_ptr<FileReader> m_pFile;
+		mutable boost::mutex m_mtx;
+		mutable boost::int64_t m_nFinalSize;
+		// the file size the header was last parsed at
+		mutable boost::int64_t m_nHeaderSize;
+		mutable bool m_bHeaderDone;
+		boost::int64_t m_nLastSize;
+		unsigned int m_nTimeoutMS;
+	};
+
+	Document::Ptr g_pMasterDoc;
+	std::string g_sMasterName;
+
+	typedef std::map<std::string, Document::Ptr> BackendMap;
+
+	// backends register during static initialization, in no set order
+	BackendMap &
+	GetBackends()
+	{
+		static BackendMap mBackends;
+		return mBackends;
+	}
+
+	Document::ErrorSink g_fnErrorSink;
+	bool g_bAutoRegistered = PDFLibWrapper::Document::AutoRegister();
+}
+
+namespace PDFLibWrapper  {
+
+struct Document::Impl  {
+	Impl(const std::string &sFileName)
+		: m_sFileName(sFileName), m_pContentCache(new ContentCache),
+		  m_bXRefLoaded(false), m_nPendingBytes(0), m_nExpiredAt(0)
+	{ }
+
+	// the document's bytes, however it was opened
+	Reader::Ptr GetReader()  {
+		if (m_pReader)  {
+			return m_pReader;
+		}
+		if (!m_pFileReader && !m_sFileName.empty())  {
+			m_pFileReader = Reader::FromFile(m_sFileName);
+		}
+		return m_pFileReader;
+	}
+
+	std::string m_sFileName;
+	Reader::Ptr m_pReader;
+	Reader::Ptr m_pFileReader;
+	Object::Ptr m_pTrailer;
+	boost::shared_ptr<ContentCache> m_pContentCache;
+	XRefIndex::Ptr m_pXRefIndex;
+	bool m_bXRefLoaded;
+	ErrorLog m_oErrors;
+
+	struct PendingObject  {
+		int m_nDepth;
+		boost::int64_t m_nOffset;
+	};
+	// prefetched extents are shared by all objects in an object stream
+	struct PendingExtent  {
+		boost::int64_t m_nLength;
+		int m_nObjects;
+		// m_nLoaded of the stats when it was prefetched
+		unsigned long m_nIssued;
+	};
+
+	// The Reader doesn't say when a prefetch is done, so extents are
+	// taken as dropped once this many objects have been loaded without
+	// them; their bytes go back to the budget.  Looked for at most once
+	// per object loaded, when the budget is used up.
+	enum  { kPrefetchLifetime = 1024 };
+	void ExpirePending()  {
+		unsigned long nLoaded = m_oPrefetchStats.m_nLoaded;
+		if (m_nExpiredAt == nLoaded)  {
+			return;
+		}
+		m_nExpiredAt = nLoaded;
+		std::map<boost::int64_t, PendingExtent>::iterator itExtent = m_mPendingExtents.begin();
+		while (itExtent != m_mPendingExtents.end())  {
+			if (nLoaded - itExtent->second.m_nIssued < kPrefetchLifetime)  {
+				++itExtent;
+				continue;
+			}
+			m_nPendingBytes -= itExtent->second.m_nLength;
+			m_oPrefetchStats.m_nExpired += itExtent->second.m_nObjects;
+			m_mPendingExtents.erase(itExtent++);
+		}
+		std::map<Object::ID, PendingObject>::iterator itPending = m_mPending.begin();
+		while (itPending != m_mPending.end())  {
+			if (m_mPendingExtents.find(itPending->second.m_nOffset) == m_mPendingExtents.end())  {
+				m_mPending.erase(itPending++);
+			} else  {
+				++itPending;
+			}
+		}
+	}
+
+	PrefetchOptions m_oPrefetch;
+	PrefetchStats m_oPrefetchStats;
+	std::map<Object::ID, PendingObject> m_mPending;
+	std::map<boost::int64_t, PendingExtent> m_mPendingExtents;
+	boost::int64_t m_nPendingBytes;
+	unsigned long m_nExpiredAt;
+	std::vector<bool> m_vLoaded;
+};
+
+Name::Name(const char *szName /*= NULL*/)
+: m_nToken(g_nUnassignedToken), m_pString(NULL)
+{
+	if (szName)  {
+		Set(szName);
+	}
+}
+
+Name::Name(const std::string &sName)
+: m_nToken(g_nUnassignedToken), m_pString(NULL)
+{
+	Set(sName);
+}
+
+void
+Name::Set(const char *szName)
+{
+	Set(std::string(szName));
+}
+
+void
+Name::Set(const std::string &sName)
+{
+	PDFLIB_STAT_COUNT(kStatNameLookups);
+	ROLock lck(g_mtxNameStrings, boost::try_to_lock);
+	if (!lck.owns_lock())  {
+		PDFLIB_STAT_COUNT(kStatNameLockWaits);
+		PDFLIB_STAT_TIME(kStatNameLockWait);
+		lck.lock();
+	}
+	NameStringMap::iterator itFind = g_mNameStrings.lower_bound(sName);
+	if (itFind == g_mNameStrings.end() || itFind->first != sName)  {
+		RWLock lckWriting(lck);
+		if (g_pSharedNames)  {
+			itFind = InternSharedName(sName);
+		} else  {
+			PDFLIB_STAT_COUNT(kStatNameInserts);
+			itFind = InternLocalName(sName, itFind);
+		}
+	}
+	m_nToken = itFind->second.first;
+	m_pString = itFind->second.second;
+}
+
+bool
+Name::FromToken(unsigned int nToken, Name &nmName)
+{
+	ROLock lck(g_mtxNameStrings);
+	if (nToken >= g_vNameStrings.size() && g_pSharedNames)  {
+		RWLock lckWriting(lck);
+		ImportSharedNames();
+	}
+	if (nToken >= g_vNameStrings.size())  {
+		return false;
+	}
+	nmName.m_nToken = nToken;
+	nmName.m_pString = &g_vNameStrings[nToken];
+	return true;
+}
+
+bool
+Name::AttachSharedTable(const std::string &sName, size_t nBytes /*= 16 * 1024 * 1024*/)
+{
+	boost::unique_lock<Mutex> lck(g_mtxNameStrings);
+	if (g_pSharedNames)  {
+		return false;
+	}
+	SharedNameTable *pTable = SharedNameTable::Open(sName, nBytes);
+	if (!pTable)  {
+		return false;
+	}
+	bool bMatching = true;
+	{
+		SharedNameTable::Lock lckAppend;
+		pTable->TryLock(lckAppend);
+		bMatching = lckAppend.owns();
+		boost::uint32_t nCount = pTable->GetCount();
+		std::string sShared;
+		for (size_t i=0; bMatching && i<g_vNameStrings.size(); i++)  {
+			if (i < nCount)  {
+				pTable->GetName((boost::uint32_t)i, sShared);
+				bMatching = sShared == g_vNameStrings[i];
+			} else  {
+				bMatching = pTable->Append(g_vNameStrings[i]);
+			}
+		}
+	}
+	if (!bMatching)  {
+		delete pTable;
+		return false;
+	}
+	g_pSharedNames = pTable;
+	ImportSharedNames();
+	return true;
+}
+
+void
+Name::DetachSharedTable()
+{
+	boost::unique_lock<Mutex> lck(g_mtxNameStrings);
+	delete g_pSharedNames;
+	g_pSharedNames = NULL;
+}
+
+bool
+Name::IsSharedTable()
+{
+	boost::shared_lock<Mutex> lck(g_mtxNameStrings);
+	return g_pSharedNames != NULL;
+}
+
+bool
+Name::RemoveSharedTable(const std::string &sName)
+{
+	return boost::interprocess::shared_memory_object::remove(sName.c_str());
+}
+
+
+Reader::Ptr
+Reader::FromFile(const std::string &sFileName)
+{
+	return Reader::Ptr(FileReader::Open(sFileName));
+}
+
+Reader::Ptr
+Reader::FromMemory(const Object::Buffer &pData, size_t nLength)
+{
+	if (!pData)  {
+		return Reader::Ptr();
+	}
+	return Reader::Ptr(new MemoryReader(pData, nLength));
+}
+
+RangeReader::Ptr
+RangeReader::FromGrowingFile(const std::string &sFileName,
+	boost::int64_t nFinalSize /*= 0*/, unsigned int nTimeoutMS /*= 30000*/)
+{
+	FileReader *pFile = FileReader::Open(sFileName);
+	if (!pFile)  {
+		return RangeReader::Ptr();
+	}
+	return RangeReader::Ptr(new GrowingFileReader(pFile, nFinalSize, nTimeoutMS));
+}
+
+
+bool
+LinearizationInfo::Read(Reader &rReader, LinearizationInfo &rInfo)
+{
+	RangeReader *pRangeReader = dynamic_cast<RangeReader *>(&rReader);
+	if (pRangeReader)  {
+		while (!pRangeReader->IsAvailable(0, kLinearizationHeaderSize))  {
+			pRangeReader->Request(0, kLinearizationHeaderSize);
+			if (!pRangeReader->WaitForData())  {
+				break;
+			}
+		}
+	}
+
+	char szHeader[kLinearizationHeaderSize];
+	size_t nRead = rReader.ReadAt(0, szHeader, kLinearizationHeaderSize);
+
+	// a linearized file that was updated afterwards is no longer linearized
+	LinearizationInfo oInfo;
+	if (ParseLinearization(szHeader, nRead, oInfo) != kHeaderLinearized ||
+		(!pRangeReader && rReader.GetSize() != oInfo.m_nFileLength))
+	{
+		return false;
+	}
+
+	rInfo = oInfo;
+	return true;
+}
+
+
+struct ErrorLog::Impl  {
+	Impl(size_t nCapacity)
+		: m_aSlots(new Slot[nCapacity]), m_nCapacity(nCapacity), m_nNext(0)
+	{ }
+
+	// record n is being written while the state is 2n + 1 and complete
+	// when it is 2n + 2
+	struct Slot  {
+		Slot() : m_nState(0)  { }
+		boost::atomic<boost::uint64_t> m_nState;
+		ErrorRecord m_oRecord;
+	};
+
+	boost::scoped_array<Slot> m_aSlots;
+	size_t m_nCapacity;
+	boost::atomic<boost::uint64_t> m_nNext;
+};
+
+ErrorLog::ErrorLog(size_t nCapacity /*= 256*/)
+: m_pImpl(new Impl((std::max)(nCapacity, (size_t)1)))
+{
+}
+
+void
+ErrorLog::Add(ErrorRecord &rRecord)
+{
+	boost::uint64_t nSequence = m_pImpl->m_nNext.fetch_add(1, boost::memory_order_relaxed);
+	rRecord.m_nSequence = nSequence;
+	Impl::Slot &rSlot = m_pImpl->m_aSlots[nSequence % m_pImpl->m_nCapacity];
+	// Writers a lap apart can get the same slot; one at a time claims it,
+	// from the even state of an older record.  A record already lapped by
+	// a newer one is dropped.
+	boost::uint64_t nClaimed = 2 * nSequence + 1;
+	boost::uint64_t nState = rSlot.m_nState.load(boost::memory_order_relaxed);
+	for (;;)  {
+		if (nState >= nClaimed)  {
+			return;
+		}
+		if (nState & 1)  {
+			boost::this_thread::yield();
+			nState = rSlot.m_nState.load(boost::memory_order_relaxed);
+			continue;
+		}
+		if (rSlot.m_nState.compare_exchange_weak(nState, nClaimed, boost::memory_order_relaxed))  {
+			break;
+		}
+	}
+	boost::atomic_thread_fence(boost::memory_order_release);
+	rSlot.m_oRecord = rRecord;
+	rSlot.m_nState.store(2 * nSequence + 2, boost::memory_order_release);
+}
+
+void
+ErrorLog::Get(ErrorList &vRecords, boost::uint64_t nFrom /*= 0*/) const
+{
+	vRecords.clear();
+	boost::uint64_t nEnd = m_pImpl->m_nNext.load(boost::memory_order_acquire);
+	boost::uint64_t nBegin = nEnd > m_pImpl->m_nCapacity ? nEnd - m_pImpl->m_nCapacity : 0;
+	for (boost::uint64_t n=(std::max)(nBegin, nFrom); n<nEnd; n++)  {
+		const Impl::Slot &rSlot = m_pImpl->m_aSlots[n % m_pImpl->m_nCapacity];
+		// records still being written or already overwritten are skipped
+		if (rSlot.m_nState.load(boost::memory_order_acquire) != 2 * n + 2)  {
+			continue;
+		}
+		ErrorRecord oRecord = rSlot.m_oRecord;
+		boost::atomic_thread_fence(boost::memory_order_acquire);
+		if (rSlot.m_nState.load(boost::memory_order_relaxed) == 2 * n + 2)  {
+			vRecords.push_back(oRecord);
+		}
+	}
+}
+
+boost::uint64_t
+ErrorLog::GetCount() const
+{
+	return m_pImpl->m_nNext.load(boost::memory_order_acquire);
+}
+
+
+Document::Document(const std::string &sFileName)
+: m_pImpl(new Impl(sFileName))
+{
+}
+
+Document::Ptr
+Document::Open(const std::string &sFileName)
+{
+	PDFLIB_STAT_TIME(kStatOpen);
+	PDFLIB_TRACE_SPAN("Document::Open", "document");
+	Document::Ptr pNew(g_pMasterDoc->ClonePtr());
+
+	if (!pNew->OpenFile(sFileName))  {
+		pNew.reset();
+	} else  {
+		pNew->m_pImpl->m_sFileName = sFileName;
+	}
+
+	return pNew;
+}
+
+Document::Ptr
+Document::Open(const Object::Buffer &pData, size_t nLength)
+{
+	return Open(Reader::FromMemory(pData, nLength));
+}
+
+Document::Ptr
+Document::Open(const Reader::Ptr &pReader)
+{
+	PDFLIB_STAT_TIME(kStatOpen);
+	PDFLIB_TRACE_SPAN("Document::Open", "document");
+	Document::Ptr pNew;
+	if (pReader)  {
+		// ask for the whole first-page section up front, so it can arrive
+		// in one piece
+		RangeReader *pRangeReader = dynamic_cast<RangeReader *>(pReader.get());
+		LinearizationInfo oInfo;
+		if (pRangeReader && LinearizationInfo::Read(*pReader, oInfo))  {
+			pRangeReader->Request(0, (size_t)oInfo.m_nFirstPageEnd);
+			if (oInfo.m_nHintLength > 0)  {
+				pRangeReader->Request(oInfo.m_nHintOffset, (size_t)oInfo.m_nHintLength);
+			}
+		}
+
+		pNew = g_pMasterDoc->ClonePtr();
+		if (!pNew->OpenReader(pReader))  {
+			pNew.reset();
+		} else  {
+			pNew->m_pImpl->m_pReader = pReader;
+		}
+	}
+
+	return pNew;
+}
+
+Document::Ptr
+Document::Reopen() const
+{
+	Document::Ptr pNew;
+	if (m_pImpl->m_pReader)  {
+		pNew = Open(m_pImpl->m_pReader);
+	} else if (!m_pImpl->m_sFileName.empty())  {
+		pNew = Open(m_pImpl->m_sFileName);
+	}
+	if (pNew)  {
+		pNew->m_pImpl->m_pContentCache = m_pImpl->m_pContentCache;
+		pNew->m_pImpl->m_pXRefIndex = m_pImpl->m_pXRefIndex;
+		pNew->m_pImpl->m_bXRefLoaded = m_pImpl->m_bXRefLoaded;
+	}
+	return pNew;
+}
+
+bool
+Document::GetLinearization(LinearizationInfo &rInfo) const
+{
+	Reader::Ptr pReader = m_pImpl->GetReader();
+	return pReader && LinearizationInfo::Read(*pReader, rInfo);
+}
+
+void
+Document::SetPrefetch(const PrefetchOptions &oOptions)
+{
+	m_pImpl->m_oPrefetch = oOptions;
+}
 
-	Document::Ptr g_pMasterDoc;
-	std::string g_sMasterName;
-	bool g_bAutoRegistered = PDFLibWrapper::Document::AutoRegister();
+const PrefetchOptions &
+Document::GetPrefetch() const
+{
+	return m_pImpl->m_oPrefetch;
 }
 
-namespace PDFLibWrapper  {
+const PrefetchStats &
+Document::GetPrefetchStats() const
+{
+	return m_pImpl->m_oPrefetchStats;
+}
 
-struct Document::Impl  {
-	Impl(const std::string &sFileName) : m_sFileName(sFileName)  { }
-	std::string m_sFileName;
-	Object::Ptr m_pTrailer;
-};
+const ErrorLog &
+Document::GetErrorLog() const
+{
+	return m_pImpl->m_oErrors;
+}
 
-Name::Name(const char *szName /*= NULL*/)
-: m_nToken(g_nUnassignedToken), m_pString(NULL)
+bool
+Document::GetErrorMessage(long, std::string &) const
 {
-	if (szName)  {
-		Set(szName);
-	}
+	return false;
 }
 
-Name::Name(const std::string &sName)
-: m_nToken(g_nUnassignedToken), m_pString(NULL)
+void
+Document::SetErrorSink(const ErrorSink &fnSink)
 {
-	Set(sName);
+	g_fnErrorSink = fnSink;
 }
 
 void
-Name::Set(const char *szName)
+Document::WriteErrorToStderr(const Document *pDoc, const ErrorRecord &rError)
 {
-	Set(std::string(szName));
+	std::string sLine = rError.m_szOperation;
+	std::string sMessage;
+	const Document *pMessageDoc = pDoc ? pDoc : g_pMasterDoc.get();
+	if (pMessageDoc && pMessageDoc->GetErrorMessage(rError.m_nCode, sMessage))  {
+		sLine += ":  " + sMessage;
+	}
+	if (rError.m_nID != Object::kInvalidID)  {
+		sLine += " (object ";
+		AppendNumber(sLine, rError.m_nID);
+		sLine += ")";
+	}
+	if (rError.m_nmKey.IsValid())  {
+		sLine += " at /" + rError.m_nmKey.GetString();
+	} else if (rError.m_nIndex >= 0)  {
+		sLine += " at [";
+		AppendNumber(sLine, rError.m_nIndex);
+		sLine += "]";
+	}
+	// in one piece, so lines of different threads don't mix
+	sLine += "\n";
+	std::cerr << sLine << std::flush;
 }
 
 void
-Name::Set(const std::string &sName)
+Document::ReportError(const Document *pDoc, ErrorRecord &rError)
 {
-	ROLock lck(g_mtxNameStrings);
-	NameStringMap::iterator itFind = g_mNameStrings.lower_bound(sName);
-	if (itFind == g_mNameStrings.end() || itFind->first != sName)  {
-		RWLock lckWriting(lck);
-		StringPointerWrapper oNewString(sName);
-		m_pString = oNewString.m_pString;
-		m_nToken = g_vNameStrings.size();
-		g_vNameStrings.push_back(oNewString.m_pString);
-		NameStringMap::mapped_type oValue(m_nToken, m_pString);
-		itFind = g_mNameStrings.insert(itFind,
-			NameStringMap::value_type(oNewString, oValue));
+	if (pDoc)  {
+		pDoc->m_pImpl->m_oErrors.Add(rError);
+	}
+	if (g_fnErrorSink)  {
+		g_fnErrorSink(pDoc, rError);
+	}
+}
+
+void
+Document::OnObjectLoaded(const Object::Ptr &pObject)
+{
+	Impl &rImpl = *m_pImpl;
+	if (rImpl.m_oPrefetch.m_nDepth <= 0 || !pObject || !pObject->IsIndirect())  {
+		return;
+	}
+	PrefetchStats &rStats = rImpl.m_oPrefetchStats;
+	++rStats.m_nLoaded;
+
+	Object::ID nID = pObject->GetID();
+	if (nID >= 0)  {
+		if ((size_t)nID >= rImpl.m_vLoaded.size())  {
+			rImpl.m_vLoaded.resize(nID + 1, false);
+		}
+		rImpl.m_vLoaded[nID] = true;
+	}
+
+	// objects that were prefetched themselves only look as far ahead as
+	// their depth allows
+	int nDepth = rImpl.m_oPrefetch.m_nDepth;
+	std::map<Object::ID, Impl::PendingObject>::iterator itPending = rImpl.m_mPending.find(nID);
+	if (itPending != rImpl.m_mPending.end())  {
+		++rStats.m_nHits;
+		nDepth = itPending->second.m_nDepth;
+		std::map<boost::int64_t, Impl::PendingExtent>::iterator itExtent =
+			rImpl.m_mPendingExtents.find(itPending->second.m_nOffset);
+		if (itExtent != rImpl.m_mPendingExtents.end() && --itExtent->second.m_nObjects == 0)  {
+			rImpl.m_nPendingBytes -= itExtent->second.m_nLength;
+			rImpl.m_mPendingExtents.erase(itExtent);
+		}
+		rImpl.m_mPending.erase(itPending);
+	}
+	if (nDepth <= 0)  {
+		return;
+	}
+	PDFLIB_TRACE_SPAN_ARG("Prefetch", "traverse", nID);
+
+	std::vector<Object::ID> vRefs;
+	XRefIndex::Ptr pIndex;
+	Reader::Ptr pReader;
+	if (!pObject->GetReferences(vRefs) || vRefs.empty() ||
+		!(pIndex = GetXRefIndex()) || !(pReader = rImpl.GetReader()))
+	{
+		return;
+	}
+
+	std::vector<Object::ID> vWanted;
+	std::vector<Object::ID>::const_iterator itRef = vRefs.begin(), itEndRefs = vRefs.end();
+	for (; itRef != itEndRefs; ++itRef)  {
+		if (*itRef < 0 ||
+			((size_t)*itRef < rImpl.m_vLoaded.size() && rImpl.m_vLoaded[*itRef]) ||
+			rImpl.m_mPending.find(*itRef) != rImpl.m_mPending.end())
+		{
+			continue;
+		}
+		Impl::PendingObject oPending;
+		boost::int64_t nLength;
+		if (!pIndex->GetExtent(*itRef, oPending.m_nOffset, nLength))  {
+			continue;
+		}
+		std::map<boost::int64_t, Impl::PendingExtent>::iterator itExtent =
+			rImpl.m_mPendingExtents.find(oPending.m_nOffset);
+		if (itExtent == rImpl.m_mPendingExtents.end())  {
+			const boost::int64_t nBudget = (boost::int64_t)rImpl.m_oPrefetch.m_nByteBudget;
+			if (rImpl.m_nPendingBytes + nLength > nBudget)  {
+				rImpl.ExpirePending();
+				if (rImpl.m_nPendingBytes + nLength > nBudget)  {
+					++rStats.m_nOverBudget;
+					continue;
+				}
+			}
+			Impl::PendingExtent oExtent;
+			oExtent.m_nLength = nLength;
+			oExtent.m_nObjects = 0;
+			oExtent.m_nIssued = rStats.m_nLoaded;
+			itExtent = rImpl.m_mPendingExtents.insert(
+				std::make_pair(oPending.m_nOffset, oExtent)).first;
+			rImpl.m_nPendingBytes += nLength;
+			rStats.m_nBytes += nLength;
+		}
+		++itExtent->second.m_nObjects;
+		oPending.m_nDepth = nDepth - 1;
+		rImpl.m_mPending[*itRef] = oPending;
+		vWanted.push_back(*itRef);
+		++rStats.m_nIssued;
+	}
+
+	XRefIndex::RunList vRuns;
+	pIndex->Plan(vWanted, vRuns);
+	XRefIndex::RunList::const_iterator itRun = vRuns.begin(), itEndRuns = vRuns.end();
+	for (; itRun != itEndRuns; ++itRun)  {
+		if (itRun->m_nLength > 0)  {
+			pReader->Prefetch(itRun->m_nOffset, (size_t)itRun->m_nLength);
+		}
+	}
+}
+
+XRefIndex::Ptr
+Document::GetXRefIndex() const
+{
+	if (!m_pImpl->m_bXRefLoaded)  {
+		m_pImpl->m_bXRefLoaded = true;
+		Reader::Ptr pReader = m_pImpl->GetReader();
+		if (pReader)  {
+			m_pImpl->m_pXRefIndex = XRefIndex::Load(*pReader, *this);
+		}
+	}
+	return m_pImpl->m_pXRefIndex;
+}
+
+bool
+Document::GetObjects(const std::vector<Object::ID> &vIDs, ObjectList &vObjects) const
+{
+	PDFLIB_TRACE_SPAN("Document::GetObjects", "object");
+	vObjects.assign(vIDs.size(), Object::Ptr());
+
+	XRefIndex::RunList vRuns;
+	XRefIndex::Ptr pIndex = GetXRefIndex();
+	if (pIndex)  {
+		pIndex->Plan(vIDs, vRuns);
 	} else  {
-		m_nToken = itFind->second.first;
-		m_pString = itFind->second.second;
+		vRuns.resize(1);
+		vRuns[0].m_nOffset = vRuns[0].m_nLength = 0;
+		for (size_t i=0; i<vIDs.size(); i++)  {
+			vRuns[0].m_vRequests.push_back(i);
+		}
+	}
+
+	// read each run front to back before PDFL parses its objects, so the
+	// disk sees a few long reads instead of a seek per object; bytes in
+	// memory need no warming, and a download just gets told what's next
+	Reader::Ptr pReader = m_pImpl->GetReader();
+	RangeReader *pRangeReader = dynamic_cast<RangeReader *>(pReader.get());
+	bool bWarm = pReader && !pRangeReader && !dynamic_cast<MemoryReader *>(pReader.get());
+	std::vector<char> vScratch;
+	XRefIndex::RunList::const_iterator itRun = vRuns.begin(), itEndRuns = vRuns.end();
+	if (pRangeReader)  {
+		for (; itRun != itEndRuns; ++itRun)  {
+			if (itRun->m_nLength > 0)  {
+				pRangeReader->Request(itRun->m_nOffset, (size_t)itRun->m_nLength);
+			}
+		}
+		itRun = vRuns.begin();
+	}
+
+	bool bAll = true;
+	for (; itRun != itEndRuns; ++itRun)  {
+		if (bWarm && itRun->m_nLength > 0)  {
+			const size_t nChunk = 1024 * 1024;
+			vScratch.resize((std::min)((boost::int64_t)nChunk, itRun->m_nLength));
+			for (boost::int64_t nDone=0; nDone<itRun->m_nLength; nDone+=nChunk)  {
+				size_t nWant = (size_t)(std::min)((boost::int64_t)nChunk, itRun->m_nLength - nDone);
+				if (pReader->ReadAt(itRun->m_nOffset + nDone, &vScratch[0], nWant) < nWant)  {
+					break;
+				}
+			}
+		}
+		std::vector<size_t>::const_iterator itRequest = itRun->m_vRequests.begin(),
+			itEndRequests = itRun->m_vRequests.end();
+		while (itRequest != itEndRequests)  {
+			if (!GetObject(vIDs[*itRequest], vObjects[*itRequest]))  {
+				bAll = false;
+			}
+			++itRequest;
+		}
 	}
+	return bAll;
 }
 
+ContentCache &
+Document::GetContentCache() const
+{
+	return *m_pImpl->m_pContentCache;
+}
 
-Document::Document(const std::string &sFileName)
-: m_pImpl(new Impl(sFileName))
+int
+Document::GetPageCount() const
 {
+	Object::Ptr pCatalog, pPages;
+	int nCount;
+	if (GetCatalog(pCatalog) && pCatalog->Get(pPages, "Pages") &&
+		pPages->Get(nCount, "Count") && nCount > 0)
+	{
+		return nCount;
+	}
+	return 0;
 }
 
-Document::Ptr
-Document::Open(const std::string &sFileName)
+bool
+Document::GetPage(int nIndex, Object::Ptr &pPage) const
 {
-	Document::Ptr pNew(g_pMasterDoc->ClonePtr());
+	const int nMaxDepth = 64;
 
-	if (!pNew->OpenFile(sFileName))  {
-		pNew.reset();
+	Object::Ptr pCatalog, pNode, pKids, pKid;
+	if (nIndex < 0 || !GetCatalog(pCatalog) || !pCatalog->Get(pNode, "Pages"))  {
+		return false;
 	}
 
-	return pNew;
+	int nDepth = 0, nCount;
+	while (nDepth++ < nMaxDepth)  {
+		if (!pNode->Get(pKids, "Kids") || pKids->GetType() != Object::kArray)  {
+			break;
+		}
+		bool bDescended = false;
+		int nKids = pKids->GetLength();
+		for (int i=0; i<nKids && !bDescended; i++)  {
+			if (!pKids->Get(pKid, i) || pKid->GetType() != Object::kDict)  {
+				continue;
+			}
+			if (pKid->HasKey("Kids"))  {
+				if (!pKid->Get(nCount, "Count") || nCount < 0)  {
+					nCount = 0;
+				}
+				if (nIndex < nCount)  {
+					pNode = pKid;
+					bDescended = true;
+				} else  {
+					nIndex -= nCount;
+				}
+			} else if (nIndex == 0)  {
+				pPage = pKid;
+				return true;
+			} else  {
+				--nIndex;
+			}
+		}
+		if (!bDescended)  {
+			break;
+		}
+	}
+
+	return false;
 }
 
 bool
-Document::GetTrailer(Object::Ptr &pTrailer) const
+Document::GetTrailer(Object::Ptr &) const
 {
 #ifdef PDFLIB_USE_CONTENTS_PARSER
 	if (!m_pImpl->m_pTrailer && IsValid())  {
-		std::ifstream is(m_pImpl->m_sFileName.c_str());
+		std::ifstream is(m_pImpl->m_sFileName.c_str(), std::ios_base::in | std::ios_base::binary);
 		if (is)  {
-			const int nBufferIncrease = 16;
+			const size_t nBufferIncrease = 16;
 			is.seekg(0, std::ios_base::end);
-			std::ifstream::pos_type nSize = is.tellg(), nPos;
-			long long nXRefPos;
+			std::streamoff nSize = is.tellg(), nPos;
+			boost::int64_t nXRefPos;
 			std::vector<char> vBuffer;
-			int nBufSize = nBufferIncrease;
+			size_t nBufSize = nBufferIncrease;
 			bool bFound = false, bFoundEOF = false, bFoundXRef = false;
 			char *pFirst, *pCurrent, *pEnd;
 			while (!bFoundXRef && !is.fail())  {
-				vBuffer.resize((std::min<std::ifstream::pos_type>)(nSize, nBufSize));
+				vBuffer.resize((size_t)(std::min)(nSize, (std::streamoff)nBufSize));
 				nPos = nSize;
 				nPos -= vBuffer.size();
 				is.seekg(nPos);
@@ -184,11 +1412,11 @@ Document::GetTrailer(Object::Ptr &pTrailer) const
 						}
 						bFoundXRef = true;
 						if (nXRefPos < nPos)  {
-							nXRefPos -= nBufSize;
+							nXRefPos -= (boost::int64_t)nBufSize;
 							if (nXRefPos < 0)  {
 								nXRefPos = 0;
 							}
-							is.seekg(nXRefPos);
+							is.seekg((std::streamoff)nXRefPos);
 							pFirst = &vBuffer[0];
 							is.read(pFirst, vBuffer.size());
 							is.clear();
@@ -228,13 +1456,32 @@ Document::GetTrailer(Object::Ptr &pTrailer) const
 bool
 Document::Register(const std::string &sName, const Ptr &pDoc)
 {
+	if (!pDoc || !GetBackends().insert(std::make_pair(sName, pDoc)).second)  {
+		return false;
+	}
 	if (!g_pMasterDoc)  {
 		g_sMasterName = sName;
 		g_pMasterDoc = pDoc;
-		return true;
 	}
+	return true;
+}
 
-	return false;
+bool
+Document::SelectBackend(const std::string &sName)
+{
+	BackendMap::const_iterator itFind = GetBackends().find(sName);
+	if (itFind == GetBackends().end())  {
+		return false;
+	}
+	g_sMasterName = sName;
+	g_pMasterDoc = itFind->second;
+	return true;
+}
+
+const std::string &
+Document::GetBackend()
+{
+	return g_sMasterName;
 }
 
 
@@ -274,17 +1521,22 @@ Object::GetTypeName(const Type &eType, std::string &sName)
 
 
 void
-Object::GetObjectDescription(std::string &sDesc, Path &vPath, bool bNeedParent,
+Object::GetObjectDescription(std::string &sDesc, const Path &vPath, bool bNeedParent,
 	bool bFullPath /*= false*/)
 
 {
 	sDesc.clear();
+	if (vPath.empty())  {
+		return;
+	}
 	Path::const_iterator itSelect = vPath.begin();
 	if (!bFullPath)  {
 		bool bFoundIndirect = false;
 		itSelect = vPath.end();
 		--itSelect;
-		while (bNeedParent && itSelect->m_nObjectID == kInvalidID)  {
+		while (bNeedParent && itSelect->m_nObjectID == kInvalidID &&
+			itSelect != vPath.begin())
+		{
 			if (bFoundIndirect)  {
 				bNeedParent = false;
 			}
@@ -295,27 +1547,24 @@ Object::GetObjectDescription(std::string &sDesc, Path &vPath, bool bNeedParent,
 		}
 	}
 
-	char szTemp[100];
 	const PDFLibWrapper::Name *pName;
-	Object *pLastObj = NULL, *pObj;
+	const long *pIndex;
+	ID nLastID = kInvalidID;
 	bool bFirst = true;
 	while (itSelect != vPath.end())  {
-		pObj = itSelect->m_pObject;
-		if (pLastObj != pObj)  {
-			pLastObj = pObj;
+		// a step that stays within the same indirect object adds nothing
+		if (bFirst || !itSelect->IsIndirect() || itSelect->m_nObjectID != nLastID)  {
+			nLastID = itSelect->m_nObjectID;
 			if (!bFirst)  {
-				pName = itSelect->GetName();
-				if (pName)  {
+				if ((pName = itSelect->GetName()) != NULL)  {
 					if (pName->IsValid())  {
 						sDesc += " /";
 						sDesc += pName->GetString();
 					}
-				} else  {
-					long nIndex = *itSelect->GetIndex();
-					if (nIndex >= 0)  {
-						sprintf(szTemp, "[%ld]", nIndex);
-						sDesc += szTemp;
-					}
+				} else if ((pIndex = itSelect->GetIndex()) != NULL)  {
+					sDesc += '[';
+					AppendNumber(sDesc, *pIndex);
+					sDesc += ']';
 				}
 			} else  {
 				bFirst = false;
@@ -323,11 +1572,12 @@ Object::GetObjectDescription(std::string &sDesc, Path &vPath, bool bNeedParent,
 			if (!sDesc.empty())  {
 				sDesc += ' ';
 			}
-			if (!pObj)  {
+			if (!itSelect->IsPresent())  {
 				sDesc += " (object not present)";
-			} else if (pObj->IsIndirect())  {
-				sprintf(szTemp, "(Object %ld)", pObj->GetID());
-				sDesc += szTemp;
+			} else if (itSelect->IsIndirect())  {
+				sDesc += "(Object ";
+				AppendNumber(sDesc, itSelect->m_nObjectID);
+				sDesc += ')';
 			} else  {
 				sDesc += "(Object)";
 			}
@@ -336,6 +1586,285 @@ Object::GetObjectDescription(std::string &sDesc, Path &vPath, bool bNeedParent,
 	}
 }
 
+
+struct PathTable::Impl  {
+	struct Node  {
+		Node(Index nParent, const Object::PathElement &rElement)
+			: m_nParent(nParent), m_oElement(rElement)
+		{ }
+		Index m_nParent;
+		Object::PathElement m_oElement;
+	};
+
+	struct NodeKey  {
+		NodeKey(Index nParent, const Object::PathElement &rElement)
+			: m_nParent(nParent), m_nKey(rElement.m_nmKey.GetToken()),
+			  m_nIndex(rElement.m_nIndex), m_nObjectID(rElement.m_nObjectID),
+			  m_bPresent(rElement.m_bPresent)
+		{ }
+		bool operator==(const NodeKey &rOther) const  {
+			return m_nParent == rOther.m_nParent && m_nKey == rOther.m_nKey &&
+				m_nIndex == rOther.m_nIndex && m_nObjectID == rOther.m_nObjectID &&
+				m_bPresent == rOther.m_bPresent;
+		}
+		friend std::size_t hash_value(const NodeKey &rKey)  {
+			std::size_t nHash = 0;
+			boost::hash_combine(nHash, rKey.m_nParent);
+			boost::hash_combine(nHash, rKey.m_nKey);
+			boost::hash_combine(nHash, rKey.m_nIndex);
+			boost::hash_combine(nHash, rKey.m_nObjectID);
+			return nHash;
+		}
+
+		Index m_nParent;
+		unsigned int m_nKey;
+		long m_nIndex;
+		Object::ID m_nObjectID;
+		bool m_bPresent;
+	};
+	typedef boost::unordered_map<NodeKey, Index> NodeMap;
+
+	std::vector<Node> m_vNodes;
+	NodeMap m_mNodes;
+	// nodes of the path interned last, root first
+	std::vector<Index> m_vLastPath;
+};
+
+PathTable::PathTable()
+: m_pImpl(new Impl)
+{
+}
+
+PathTable::~PathTable()
+{
+}
+
+PathTable::Index
+PathTable::Intern(const Object::Path &vPath)
+{
+	std::vector<Impl::Node> &vNodes = m_pImpl->m_vNodes;
+	std::vector<Index> &vLastPath = m_pImpl->m_vLastPath;
+
+	Index nParent = kNoNode;
+	size_t nDepth = 0;
+	while (nDepth < vPath.size() && nDepth < vLastPath.size() &&
+		vNodes[vLastPath[nDepth]].m_oElement == vPath[nDepth])
+	{
+		nParent = vLastPath[nDepth++];
+	}
+	vLastPath.resize(nDepth);
+
+	while (nDepth < vPath.size())  {
+		Impl::NodeKey oKey(nParent, vPath[nDepth]);
+		Impl::NodeMap::const_iterator itFind = m_pImpl->m_mNodes.find(oKey);
+		if (itFind != m_pImpl->m_mNodes.end())  {
+			nParent = itFind->second;
+		} else  {
+			vNodes.push_back(Impl::Node(nParent, vPath[nDepth]));
+			nParent = vNodes.size() - 1;
+			m_pImpl->m_mNodes.insert(Impl::NodeMap::value_type(oKey, nParent));
+		}
+		vLastPath.push_back(nParent);
+		++nDepth;
+	}
+
+	return nParent;
+}
+
+void
+PathTable::GetPath(Index nNode, Object::Path &vPath) const
+{
+	vPath.clear();
+	while (nNode != kNoNode && nNode < m_pImpl->m_vNodes.size())  {
+		const Impl::Node &rNode = m_pImpl->m_vNodes[nNode];
+		vPath.push_back(rNode.m_oElement);
+		nNode = rNode.m_nParent;
+	}
+	std::reverse(vPath.begin(), vPath.end());
+}
+
+size_t
+PathTable::GetNodeCount() const
+{
+	return m_pImpl->m_vNodes.size();
+}
+
+void
+PathRef::GetPath(Object::Path &vPath) const
+{
+	if (IsValid())  {
+		m_pTable->GetPath(m_nNode, vPath);
+	} else  {
+		vPath.clear();
+	}
+}
+
+void
+PathRef::GetDescription(std::string &sDesc, bool bNeedParent /*= true*/,
+	bool bFullPath /*= false*/) const
+{
+	Object::Path vPath;
+	GetPath(vPath);
+	Object::GetObjectDescription(sDesc, vPath, bNeedParent, bFullPath);
+}
+
+namespace  {
+
+	template <class Key>
+	bool
+	GetInt64(Object &rObject, boost::int64_t &nValue, Key oKey)
+	{
+		int nInt;
+		double dReal;
+		if (rObject.Get(nInt, oKey))  {
+			nValue = nInt;
+			return true;
+		}
+		if (rObject.Get(dReal, oKey) && dReal == floor(dReal))  {
+			nValue = (boost::int64_t)dReal;
+			return true;
+		}
+		return false;
+	}
+
+	template <class T>
+	bool
+	GetElement(Object &rObject, T &rValue, int nIndex)
+	{
+		return rObject.Get(rValue, nIndex);
+	}
+
+	bool
+	GetElement(Object &rObject, double &dValue, int nIndex)
+	{
+		int nValue;
+		if (rObject.Get(nValue, nIndex))  {
+			dValue = nValue;
+			return true;
+		}
+		return rObject.Get(dValue, nIndex);
+	}
+
+	// an element at a time, for backends without a faster way
+	template <class T>
+	bool
+	GetEachElement(Object &rObject, T *pValues, size_t nMaxCount, size_t &nCount)
+	{
+		size_t nLength = (std::max)(rObject.GetLength(), 0);
+		for (nCount=0; nCount<nLength && nCount<nMaxCount; nCount++)  {
+			if (!GetElement(rObject, pValues[nCount], (int)nCount))  {
+				return false;
+			}
+		}
+		return nLength <= nMaxCount;
+	}
+
+}
+
+bool
+Object::Get(boost::int64_t &nValue, int nIndex /*= 0*/)
+{
+	return GetInt64(*this, nValue, nIndex);
+}
+
+bool
+Object::Get(boost::int64_t &nValue, const char *szKey)
+{
+	return GetInt64(*this, nValue, szKey);
+}
+
+bool
+Object::Get(boost::int64_t &nValue, const Name &nmKey)
+{
+	return GetInt64<const Name &>(*this, nValue, nmKey);
+}
+
+bool
+Object::GetElements(int *pValues, size_t nMaxCount, size_t &nCount)
+{
+	return GetEachElement(*this, pValues, nMaxCount, nCount);
+}
+
+bool
+Object::GetElements(double *pValues, size_t nMaxCount, size_t &nCount)
+{
+	return GetEachElement(*this, pValues, nMaxCount, nCount);
+}
+
+bool
+Object::GetElements(Name *pValues, size_t nMaxCount, size_t &nCount)
+{
+	return GetEachElement(*this, pValues, nMaxCount, nCount);
+}
+
+bool
+Object::Extract(const Ptr &pObject, Value &rValue)
+{
+	if (!pObject)  {
+		rValue.m_eType = kUnknown;
+		return false;
+	}
+	rValue.m_eType = pObject->GetType();
+	rValue.m_pObject.reset();
+	switch (rValue.m_eType)  {
+		case kNull:
+			return true;
+		case kBoolean:
+			return pObject->Get(rValue.m_bBoolean);
+		case kInteger:
+			return pObject->Get(rValue.m_nInteger);
+		case kFixed:
+			return pObject->Get(rValue.m_dReal);
+		case kName:
+			return pObject->Get(rValue.m_nmName);
+		case kString:
+			return pObject->Get(rValue.m_sString);
+		case kArray:
+		case kDict:
+		case kStream:
+			rValue.m_pObject = pObject;
+			return true;
+		default:
+			return false;
+	}
+}
+
+// an element at a time, for backends without a faster way
+bool
+Object::ExtractElements(std::vector<Value> &vValues)
+{
+	if (m_eType != kArray)  {
+		return false;
+	}
+	vValues.resize((std::max)(GetLength(), 0));
+	Object::Ptr pElement;
+	for (size_t i=0; i<vValues.size(); i++)  {
+		pElement.reset();
+		Get(pElement, (int)i);
+		Extract(pElement, vValues[i]);
+	}
+	return true;
+}
+
+bool
+Object::ExtractEntries(std::vector<Entry> &vEntries)
+{
+	NameSet setKeys;
+	if ((m_eType != kDict && m_eType != kStream) || !GetKeys(setKeys))  {
+		return false;
+	}
+	vEntries.resize(setKeys.size());
+	Object::Ptr pValue;
+	std::vector<Entry>::iterator itEntry = vEntries.begin();
+	for (NameSet::const_iterator it = setKeys.begin(); it != setKeys.end(); ++it, ++itEntry)  {
+		itEntry->m_nmKey = *it;
+		pValue.reset();
+		Get(pValue, *it);
+		Extract(pValue, itEntry->m_oValue);
+	}
+	return true;
+}
+
 std::string
 Object::GetString()
 {
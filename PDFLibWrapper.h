@@ -8,15 +8,18 @@
 #ifndef APAGO_PDFLibWrapper_h__
 #define APAGO_PDFLibWrapper_h__
 
+#include <algorithm>
 #include <istream>
 #include <set>
 #include <vector>
 #include <string>
 
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
 #include <boost/integer_traits.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/shared_array.hpp>
-#include <boost/variant.hpp>
+#include <boost/noncopyable.hpp>
 
 namespace PDFLibWrapper  {
 
@@ -58,6 +61,32 @@ namespace PDFLibWrapper  {
 
 		bool IsValid() const  { return m_pString != NULL; }
 		const std::string &GetString() const  { return *m_pString; }
+		// small, dense and stable for the life of the process; with a shared
+		// name table also the same in every process attached to it
+		unsigned int GetToken() const  { return m_nToken; }
+		// the name of a token handed out in this process or, while attached,
+		// in any process attached to the same shared name table
+		static bool FromToken(unsigned int nToken, Name &nmName);
+
+		// Interns names in the shared memory segment sName, created with
+		// nBytes if it does not exist yet, so that worker processes agree on
+		// the tokens and exchange or persist them with their results.  Names
+		// are only ever appended to the segment; looking one up that another
+		// process interned takes no interprocess lock.  The names this
+		// process interned before attaching, static ones included, must match
+		// the first names in the segment, and those it lacks are appended;
+		// so attach before interning names of documents.  False if they do
+		// not match, the segment exists with another size, or it cannot be
+		// mapped.  A process that died holding the segment's lock makes the
+		// others detach after two seconds, with tokens of their own from
+		// then on.
+		static bool AttachSharedTable(const std::string &sName, size_t nBytes = 16 * 1024 * 1024);
+		// New names get tokens of this process only after detaching, or once
+		// the segment is full.
+		static void DetachSharedTable();
+		static bool IsSharedTable();
+		// removes the segment once no process needs it anymore
+		static bool RemoveSharedTable(const std::string &sName);
 
 		bool operator==(const Name &nmOther) const
 		{ return m_nToken == nmOther.m_nToken; }
@@ -89,6 +118,8 @@ namespace PDFLibWrapper  {
 	typedef std::set<Name> NameSet;
 
 	class Document;
+	class ContentCache;
+	class XRefIndex;
 
 	class Object
 	{
@@ -99,23 +130,61 @@ namespace PDFLibWrapper  {
 		typedef boost::shared_array<const unsigned char> Buffer;
 		typedef boost::shared_ptr<std::istream> Stream;
 		typedef long ID;
-		typedef boost::variant<long, Name> Selector;
+		// One step of the way from the root to an object:  the key or index
+		// under which it was found, and what it was.  Recording one is cheap;
+		// it only becomes text in GetObjectDescription.
 		struct PathElement  {
-			PathElement(const Selector &oSelector = Name(),
-				Object *pObject = NULL, ID nID = Object::kInvalidID)
-				: m_pObject(pObject), m_oWayToThis(oSelector),
-				m_nObjectID(pObject ? pObject->GetID() : nID)
+			PathElement(const Name &nmKey = Name(), const Object *pObject = NULL,
+				ID nID = Object::kInvalidID)
+				: m_nmKey(nmKey), m_nIndex(-1),
+				m_nObjectID(pObject ? pObject->GetID() : nID),
+				m_bPresent(pObject != NULL)
 			{
 			}
-			const Name *GetName() const  { return boost::get<Name>(&m_oWayToThis); }
-			const long *GetIndex() const  { return boost::get<long>(&m_oWayToThis); }
+			PathElement(long nIndex, const Object *pObject = NULL,
+				ID nID = Object::kInvalidID)
+				: m_nIndex(nIndex),
+				m_nObjectID(pObject ? pObject->GetID() : nID),
+				m_bPresent(pObject != NULL)
+			{
+			}
+			const Name *GetName() const  { return m_nIndex < 0 ? &m_nmKey : NULL; }
+			const long *GetIndex() const  { return m_nIndex >= 0 ? &m_nIndex : NULL; }
+			bool IsPresent() const  { return m_bPresent; }
+			bool IsIndirect() const  { return m_nObjectID != Object::kInvalidID; }
+
+			bool operator==(const PathElement &rOther) const  {
+				return m_nmKey == rOther.m_nmKey && m_nIndex == rOther.m_nIndex &&
+					m_nObjectID == rOther.m_nObjectID && m_bPresent == rOther.m_bPresent;
+			}
+			bool operator!=(const PathElement &rOther) const  { return !(*this == rOther); }
 
-			Object *m_pObject; // TEMPORARY
-			Selector m_oWayToThis;
+			Name m_nmKey;
+			long m_nIndex;
 			ID m_nObjectID;
+			bool m_bPresent;
 		};
 		typedef std::vector<PathElement> Path;
 
+		// A value with its payload already taken out:  the number, name or
+		// string of a scalar, the object of an array, dictionary or stream.
+		// See PDFLibVisit.h.
+		struct Value  {
+			Value() : m_eType(kUnknown), m_bBoolean(false), m_nInteger(0), m_dReal(0)  { }
+
+			Type m_eType;
+			bool m_bBoolean;
+			boost::int64_t m_nInteger;
+			double m_dReal;
+			Name m_nmName;
+			std::string m_sString;
+			Ptr m_pObject;
+		};
+		struct Entry  {
+			Name m_nmKey;
+			Value m_oValue;
+		};
+
 		enum  { kInvalidID = -1 };
 
 		virtual Document *GetDoc() const = 0;
@@ -128,6 +197,7 @@ namespace PDFLibWrapper  {
 		virtual bool IsIndirect() const = 0;
 		virtual ID GetID() const = 0;
 
+		// number of elements of an array, 1 for anything else
 		virtual int GetLength() const = 0;
 
 		virtual bool GetKeys(NameSet &setKeys) = 0;
@@ -179,9 +249,59 @@ namespace PDFLibWrapper  {
 		virtual bool Get(Buffer &oValue, const Name &nmKey) = 0;
 		virtual bool Get(Stream &oValue, const Name &nmKey) = 0;
 
+		// integers that may not fit into an int, like lengths and offsets
+		// in large files; integral reals are accepted too
+		virtual bool Get(boost::int64_t &nValue, int nIndex = 0);
+		virtual bool Get(boost::int64_t &nValue, const char *szKey);
+		virtual bool Get(boost::int64_t &nValue, const std::string &sKey)  { return Get(nValue, sKey.c_str()); }
+		virtual bool Get(boost::int64_t &nValue, const Name &nmKey);
+
+		// the data of a stream as stored in the file, decrypted but with
+		// its filters not yet applied
+		virtual bool GetEncoded(Stream &)  { return false; }
+
+		// IDs of the indirect objects this one refers to, directly or
+		// through direct dictionaries and arrays, without loading them
+		virtual bool GetReferences(std::vector<ID> &)  { return false; }
+
+		// The elements of an array in one call, or the value itself for
+		// anything else:  up to nMaxCount of them into pValues, nCount set to
+		// how many were converted.  False at the first element of another
+		// type, or if there are more than nMaxCount.  Integers are taken as
+		// doubles, since arrays like /Widths mix them with reals.
+		virtual bool GetElements(int *pValues, size_t nMaxCount, size_t &nCount);
+		virtual bool GetElements(double *pValues, size_t nMaxCount, size_t &nCount);
+		virtual bool GetElements(Name *pValues, size_t nMaxCount, size_t &nCount);
+
+		// the same into a vector of ints, doubles or Names, sized to the
+		// elements converted
+		template <class T>
+		bool GetArray(std::vector<T> &vValues)  {
+			vValues.resize((std::max)(GetLength(), 0));
+			size_t nCount = 0;
+			bool bComplete = vValues.empty() || GetElements(&vValues[0], vValues.size(), nCount);
+			vValues.resize(nCount);
+			return bComplete;
+		}
+		template <class T>
+		bool GetArray(std::vector<T> &vValues, const Name &nmKey)  {
+			Object::Ptr pArray;
+			vValues.clear();
+			return Get(pArray, nmKey) && pArray && pArray->GetArray(vValues);
+		}
+
+		// All elements of an array, or all entries of a dictionary or stream
+		// in no set order, with their values taken out in one call; false
+		// for other types.  The vectors are resized to fit, so reusing them
+		// saves allocating for every call.
+		virtual bool ExtractElements(std::vector<Value> &vValues);
+		virtual bool ExtractEntries(std::vector<Entry> &vEntries);
+		// of pObject itself, with a Get for its type
+		static bool Extract(const Ptr &pObject, Value &rValue);
+
 		std::string GetString();
 
-		static void GetObjectDescription(std::string &sDesc, Path &vPath,
+		static void GetObjectDescription(std::string &sDesc, const Path &vPath,
 			bool bNeedParent, bool bFullPath = false);
 
 	protected:
@@ -193,20 +313,233 @@ namespace PDFLibWrapper  {
 
 	typedef std::vector<Object::Ptr> ObjectList;
 
+	// Interned paths:  each distinct (parent, step) pair is stored once, so
+	// paths recorded for many findings share their common prefixes.  Paths
+	// that repeat the previously interned one are matched without lookups.
+	// Interning is not thread-safe; reading is.
+	class PathTable : private boost::noncopyable  {
+	public:
+		typedef boost::shared_ptr<PathTable> Ptr;
+		typedef unsigned int Index;
+		enum  { kNoNode = 0xffffffff };
+
+		PathTable();
+		~PathTable();
+
+		Index Intern(const Object::Path &vPath);
+		void GetPath(Index nNode, Object::Path &vPath) const;
+		size_t GetNodeCount() const;
+
+		struct Impl;
+
+	private:
+		boost::shared_ptr<Impl> m_pImpl;
+	};
+
+	class PathRef  {
+	public:
+		PathRef() : m_nNode(PathTable::kNoNode)  { }
+		PathRef(const PathTable::Ptr &pTable, PathTable::Index nNode)
+			: m_pTable(pTable), m_nNode(nNode)
+		{ }
+
+		bool IsValid() const  { return m_pTable && m_nNode != PathTable::kNoNode; }
+		void GetPath(Object::Path &vPath) const;
+		void GetDescription(std::string &sDesc, bool bNeedParent = true,
+			bool bFullPath = false) const;
+
+	private:
+		PathTable::Ptr m_pTable;
+		PathTable::Index m_nNode;
+	};
+
+	// Random-access source of the bytes of a PDF.  ReadAt may be called
+	// from several threads at once.
+	class Reader  {
+	public:
+		typedef boost::shared_ptr<Reader> Ptr;
+
+		virtual ~Reader()  { }
+
+		virtual boost::int64_t GetSize() const = 0;
+		// returns the number of bytes read, short only at the end of the data
+		virtual size_t ReadAt(boost::int64_t nOffset, void *pDest, size_t nBytes) = 0;
+		// a hint that a range will be read soon; must not block
+		virtual void Prefetch(boost::int64_t, size_t)  { }
+
+		static Ptr FromFile(const std::string &sFileName);
+		static Ptr FromMemory(const Object::Buffer &pData, size_t nLength);
+	};
+
+	// A Reader whose data arrives over time, e.g. a download in progress.
+	// GetSize is the final size; reading what isn't there yet is an error,
+	// and Request tells the source which ranges are wanted next.
+	class RangeReader : public Reader  {
+	public:
+		typedef boost::shared_ptr<RangeReader> Ptr;
+
+		virtual bool IsAvailable(boost::int64_t nOffset, size_t nBytes) const = 0;
+		virtual void Request(boost::int64_t nOffset, size_t nBytes) = 0;
+		// blocks until more data has arrived; false if none will
+		virtual bool WaitForData() = 0;
+
+		virtual void Prefetch(boost::int64_t nOffset, size_t nBytes)  { Request(nOffset, nBytes); }
+
+		// a file that another process is still writing; without a final
+		// size, it is taken from the linearization dictionary
+		static Ptr FromGrowingFile(const std::string &sFileName,
+			boost::int64_t nFinalSize = 0, unsigned int nTimeoutMS = 30000);
+	};
+
+	struct LinearizationInfo  {
+		LinearizationInfo()
+			: m_nFileLength(0), m_nHintOffset(0), m_nHintLength(0),
+			  m_nFirstPageObject(Object::kInvalidID), m_nFirstPageEnd(0),
+			  m_nPageCount(0), m_nMainXRefOffset(0)
+		{ }
+
+		// reads the linearization dictionary from the first 1024 bytes
+		static bool Read(Reader &rReader, LinearizationInfo &rInfo);
+
+		boost::int64_t m_nFileLength;			// /L
+		boost::int64_t m_nHintOffset;			// /H
+		boost::int64_t m_nHintLength;
+		Object::ID m_nFirstPageObject;			// /O
+		boost::int64_t m_nFirstPageEnd;			// /E
+		int m_nPageCount;						// /N
+		boost::int64_t m_nMainXRefOffset;		// /T
+	};
+
+	struct PrefetchOptions  {
+		PrefetchOptions() : m_nDepth(0), m_nByteBudget(4 * 1024 * 1024)  { }
+
+		// levels of references followed from a loaded object; 0 turns
+		// prefetching off
+		int m_nDepth;
+		// bytes announced to the Reader but not yet used; prefetches not
+		// used within the next 1024 objects loaded stop counting
+		size_t m_nByteBudget;
+	};
+
+	struct PrefetchStats  {
+		PrefetchStats()
+			: m_nLoaded(0), m_nIssued(0), m_nHits(0), m_nOverBudget(0), m_nExpired(0),
+			  m_nBytes(0)
+		{ }
+
+		// indirect objects loaded while prefetching was on
+		unsigned long m_nLoaded;
+		// objects prefetched, and how many of them were loaded later
+		unsigned long m_nIssued;
+		unsigned long m_nHits;
+		// objects not prefetched because of the byte budget
+		unsigned long m_nOverBudget;
+		// objects prefetched but not loaded in time, whose bytes were
+		// given back to the budget
+		unsigned long m_nExpired;
+		boost::int64_t m_nBytes;
+	};
+
+	// An error the backend ran into; where known, the object and the key
+	// or index being read.  Turned into text only when asked for, with
+	// Document::GetErrorMessage.
+	struct ErrorRecord  {
+		ErrorRecord()
+			: m_nSequence(0), m_nCode(0), m_szOperation(""), m_nID(Object::kInvalidID),
+			  m_nIndex(-1)
+		{ }
+
+		// counts the errors of a Document from 0
+		boost::uint64_t m_nSequence;
+		long m_nCode;
+		// a static string
+		const char *m_szOperation;
+		Object::ID m_nID;
+		Name m_nmKey;
+		long m_nIndex;
+	};
+	typedef std::vector<ErrorRecord> ErrorList;
+
+	// Ring of the latest errors.  Adding and reading take no lock, so a
+	// damaged file reporting thousands of errors doesn't hold up other
+	// threads; the oldest records are overwritten.
+	class ErrorLog : private boost::noncopyable  {
+	public:
+		explicit ErrorLog(size_t nCapacity = 256);
+
+		// sets the sequence number of rRecord
+		void Add(ErrorRecord &rRecord);
+		// the records still in the ring with a sequence number of at
+		// least nFrom, oldest first
+		void Get(ErrorList &vRecords, boost::uint64_t nFrom = 0) const;
+		// all records ever added, including those overwritten
+		boost::uint64_t GetCount() const;
+
+		struct Impl;
+
+	private:
+		boost::shared_ptr<Impl> m_pImpl;
+	};
+
 	class Document
 	{
 	public:
 		typedef boost::shared_ptr<Document> Ptr;
 
 		static Ptr Open(const std::string &sFileName);
+		static Ptr Open(const Object::Buffer &pData, size_t nLength);
+		static Ptr Open(const Reader::Ptr &pReader);
 
 		virtual bool IsValid() const = 0;
 
 		virtual PDFVersion GetVersion() const = 0;
+		bool GetLinearization(LinearizationInfo &rInfo) const;
 		virtual bool GetTrailer(Object::Ptr &pTrailer) const;
 		virtual bool GetCatalog(Object::Ptr &pCatalog) const = 0;
-
+		virtual bool GetObject(Object::ID, Object::Ptr &) const  { return false; }
+		// Resolves many objects at once, in file order rather than in the
+		// order asked for, reading neighbouring objects in one sweep.
+		// Objects that can't be resolved are left empty.
+		bool GetObjects(const std::vector<Object::ID> &vIDs, ObjectList &vObjects) const;
+		// empty if the cross-reference data can't be read
+		boost::shared_ptr<const XRefIndex> GetXRefIndex() const;
+
+		virtual int GetPageCount() const;
+		virtual bool GetPage(int nIndex, Object::Ptr &pPage) const;
+
+		Ptr Reopen() const;
+
+		ContentCache &GetContentCache() const;
+
+		// Whenever an indirect object is loaded, the objects it refers to
+		// are announced to the Reader, so their bytes arrive while the
+		// caller is still busy with this one.
+		void SetPrefetch(const PrefetchOptions &oOptions);
+		const PrefetchOptions &GetPrefetch() const;
+		const PrefetchStats &GetPrefetchStats() const;
+
+		// errors the backend reported while working on this Document
+		const ErrorLog &GetErrorLog() const;
+		// text for the code of an ErrorRecord
+		virtual bool GetErrorMessage(long nCode, std::string &sMessage) const;
+
+		// Called on the reporting thread for every error, with the Document
+		// it happened in if there is one.  Errors aren't written anywhere
+		// by default; to be set before any Document is opened.
+		typedef boost::function<void (const Document *pDoc, const ErrorRecord &rError)> ErrorSink;
+		static void SetErrorSink(const ErrorSink &fnSink);
+		// a sink writing errors to std::cerr
+		static void WriteErrorToStderr(const Document *pDoc, const ErrorRecord &rError);
+		// for the backends:  logs the error with pDoc, if any, and passes it
+		// to the sink
+		static void ReportError(const Document *pDoc, ErrorRecord &rError);
+
+		// Backends register a prototype under a name; the first one
+		// registered opens documents until another is selected.  Not to be
+		// changed while documents are being opened.
 		static bool Register(const std::string &sName, const Ptr &pDoc);
+		static bool SelectBackend(const std::string &sName);
+		static const std::string &GetBackend();
 		static bool AutoRegister();
 
 		struct Impl;
@@ -220,6 +553,10 @@ namespace PDFLibWrapper  {
 		virtual Document::Ptr ClonePtr() const = 0;
 
 		virtual bool OpenFile(const std::string &sFileName) = 0;
+		virtual bool OpenReader(const Reader::Ptr &)  { return false; }
+
+		// backends call this for every indirect object they load
+		void OnObjectLoaded(const Object::Ptr &pObject);
 
 		boost::shared_ptr<Impl> m_pImpl;
 	};
@@ -0,0 +1,484 @@
+/*
+ *  PDFLibXRef.cpp
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <set>
+#include <streambuf>
+#include <istream>
+
+#include "PDFLibXRef.h"
+#include "PDFLibContent.h"
+#include "PDFLibMemory.h"
+#include "PDFLibTrace.h"
+
+
+namespace  {
+
+	using namespace PDFLibWrapper;
+
+	// sequential reading through a Reader, starting anywhere in the file
+	class ReaderBuf : public std::streambuf  {
+	public:
+		ReaderBuf(Reader &rReader, boost::int64_t nOffset)
+			: m_rReader(rReader), m_nPos(nOffset), m_vBuffer(16 * 1024)
+		{ }
+
+	protected:
+		virtual int_type underflow()  {
+			if (gptr() < egptr())  {
+				return traits_type::to_int_type(*gptr());
+			}
+			size_t nRead = m_rReader.ReadAt(m_nPos, &m_vBuffer[0], m_vBuffer.size());
+			if (nRead == 0)  {
+				return traits_type::eof();
+			}
+			m_nPos += nRead;
+			setg(&m_vBuffer[0], &m_vBuffer[0], &m_vBuffer[0] + nRead);
+			return traits_type::to_int_type(*gptr());
+		}
+
+	private:
+		Reader &m_rReader;
+		boost::int64_t m_nPos;
+		std::vector<char> m_vBuffer;
+	};
+
+	class ReaderStream : public std::istream  {
+	public:
+		ReaderStream(Reader &rReader, boost::int64_t nOffset)
+			: std::istream(NULL), m_oBuf(rReader, nOffset)
+		{
+			rdbuf(&m_oBuf);
+		}
+	private:
+		ReaderBuf m_oBuf;
+	};
+
+	bool
+	GetNumber(const ContentToken &tok, boost::int64_t &nValue)
+	{
+		double dValue;
+		if (!tok.Get(dValue))  {
+			return false;
+		}
+		nValue = (boost::int64_t)dValue;
+		return true;
+	}
+
+	struct PlanItem  {
+		boost::int64_t m_nOffset;
+		boost::int64_t m_nEnd;
+		unsigned int m_nIndex;
+		size_t m_nRequest;
+
+		bool operator<(const PlanItem &rOther) const  {
+			if (m_nOffset != rOther.m_nOffset)  {
+				return m_nOffset < rOther.m_nOffset;
+			}
+			if (m_nIndex != rOther.m_nIndex)  {
+				return m_nIndex < rOther.m_nIndex;
+			}
+			return m_nRequest < rOther.m_nRequest;
+		}
+	};
+
+}
+
+namespace PDFLibWrapper  {
+
+class XRefLoader  {
+public:
+	XRefLoader(Reader &rReader, const Document &rDoc, XRefIndex &rIndex)
+		: m_rReader(rReader), m_rDoc(rDoc), m_rIndex(rIndex), m_nMaxID(0)
+	{ }
+
+	bool Load();
+
+private:
+	bool FindStartXRef(boost::int64_t &nOffset);
+	bool LoadSection(boost::int64_t nOffset);
+	bool LoadTable(ContentTokenizer &oTokenizer);
+	bool LoadTrailer(ContentTokenizer &oTokenizer);
+	bool LoadStream(Object::ID nID);
+	void Set(boost::int64_t nID, const XRefIndex::Entry &rEntry);
+
+	Reader &m_rReader;
+	const Document &m_rDoc;
+	XRefIndex &m_rIndex;
+	// newer sections are read first, so entries already set are kept
+	std::vector<bool> m_vSet;
+	// entries above it are skipped rather than grown to
+	boost::int64_t m_nMaxID;
+	std::deque<boost::int64_t> m_dqPending;
+	std::set<boost::int64_t> m_setSeen;
+};
+
+bool
+XRefLoader::Load()
+{
+	m_rIndex.m_nFileSize = m_rReader.GetSize();
+	// every object takes at least a byte of the file, even if only in an
+	// xref stream
+	m_nMaxID = (std::min)(m_rIndex.m_nFileSize, (boost::int64_t)MemoryDoc::kMaxID);
+
+	boost::int64_t nStart;
+	if (!FindStartXRef(nStart))  {
+		return false;
+	}
+	m_dqPending.push_back(nStart);
+	while (!m_dqPending.empty())  {
+		boost::int64_t nOffset = m_dqPending.front();
+		m_dqPending.pop_front();
+		if (nOffset <= 0 || nOffset >= m_rIndex.m_nFileSize ||
+			!m_setSeen.insert(nOffset).second)
+		{
+			continue;
+		}
+		if (!LoadSection(nOffset))  {
+			return false;
+		}
+		m_rIndex.m_vOffsets.push_back(nOffset);
+	}
+
+	std::vector<XRefIndex::Entry>::const_iterator itEntry = m_rIndex.m_vEntries.begin(),
+		itEndEntries = m_rIndex.m_vEntries.end();
+	while (itEntry != itEndEntries)  {
+		if (itEntry->m_eType == XRefIndex::Entry::kInFile)  {
+			m_rIndex.m_vOffsets.push_back(itEntry->m_nOffset);
+		}
+		++itEntry;
+	}
+	std::sort(m_rIndex.m_vOffsets.begin(), m_rIndex.m_vOffsets.end());
+	m_rIndex.m_vOffsets.erase(
+		std::unique(m_rIndex.m_vOffsets.begin(), m_rIndex.m_vOffsets.end()),
+		m_rIndex.m_vOffsets.end());
+	return true;
+}
+
+bool
+XRefLoader::FindStartXRef(boost::int64_t &nOffset)
+{
+	const char szKeyword[] = "startxref";
+	const size_t nKeyword = sizeof(szKeyword) - 1;
+
+	char szTail[1024];
+	boost::int64_t nTailStart = (std::max)(m_rIndex.m_nFileSize - (boost::int64_t)sizeof(szTail),
+		(boost::int64_t)0);
+	size_t nTail = m_rReader.ReadAt(nTailStart, szTail, sizeof(szTail));
+	for (size_t i=nTail; i>=nKeyword; i--)  {
+		if (memcmp(szTail + i - nKeyword, szKeyword, nKeyword) == 0)  {
+			ContentTokenizer oTokenizer;
+			ContentToken tokOffset;
+			oTokenizer.Open(szTail + i, nTail - i);
+			return oTokenizer.Next(tokOffset) && GetNumber(tokOffset, nOffset);
+		}
+	}
+	return false;
+}
+
+bool
+XRefLoader::LoadSection(boost::int64_t nOffset)
+{
+	ContentTokenizer oTokenizer;
+	if (!oTokenizer.Open(Object::Stream(new ReaderStream(m_rReader, nOffset))))  {
+		return false;
+	}
+
+	ContentToken tokFirst, tokGeneration, tokObj;
+	if (!oTokenizer.Next(tokFirst))  {
+		return false;
+	}
+	if (tokFirst.Is("xref"))  {
+		return LoadTable(oTokenizer) && LoadTrailer(oTokenizer);
+	}
+
+	// "n g obj" of a cross-reference stream
+	boost::int64_t nID;
+	if (!GetNumber(tokFirst, nID) || !oTokenizer.Next(tokGeneration) ||
+		!oTokenizer.Next(tokObj) || !tokObj.Is("obj"))
+	{
+		return false;
+	}
+	return LoadStream((Object::ID)nID);
+}
+
+bool
+XRefLoader::LoadTable(ContentTokenizer &oTokenizer)
+{
+	ContentToken tokCurrent;
+	boost::int64_t nFirst, nCount, nOffset, nGeneration;
+	while (oTokenizer.Next(tokCurrent) && !tokCurrent.Is("trailer"))  {
+		if (!GetNumber(tokCurrent, nFirst) || !oTokenizer.Next(tokCurrent) ||
+			!GetNumber(tokCurrent, nCount) || nFirst < 0 || nCount < 0)
+		{
+			return false;
+		}
+		for (boost::int64_t i=0; i<nCount; i++)  {
+			if (!oTokenizer.Next(tokCurrent) || !GetNumber(tokCurrent, nOffset) ||
+				!oTokenizer.Next(tokCurrent) || !GetNumber(tokCurrent, nGeneration) ||
+				!oTokenizer.Next(tokCurrent))
+			{
+				return false;
+			}
+			XRefIndex::Entry oEntry;
+			if (tokCurrent.Is("n"))  {
+				oEntry.m_eType = XRefIndex::Entry::kInFile;
+				oEntry.m_nOffset = nOffset;
+			}
+			Set(nFirst + i, oEntry);
+		}
+	}
+	return tokCurrent.Is("trailer");
+}
+
+bool
+XRefLoader::LoadTrailer(ContentTokenizer &oTokenizer)
+{
+	ContentToken tokCurrent;
+	if (!oTokenizer.Next(tokCurrent) || tokCurrent.GetType() != ContentToken::kDictBegin)  {
+		return false;
+	}
+
+	boost::int64_t nPrev = 0, nXRefStm = 0;
+	int nDepth = 1;
+	while (nDepth > 0 && oTokenizer.Next(tokCurrent))  {
+		switch (tokCurrent.GetType())  {
+			case ContentToken::kDictBegin:
+			case ContentToken::kArrayBegin:
+				++nDepth;
+				break;
+			case ContentToken::kDictEnd:
+			case ContentToken::kArrayEnd:
+				--nDepth;
+				break;
+			case ContentToken::kName:
+				if (nDepth == 1)  {
+					if (tokCurrent.Is("Prev"))  {
+						if (oTokenizer.Next(tokCurrent))  {
+							GetNumber(tokCurrent, nPrev);
+						}
+					} else if (tokCurrent.Is("XRefStm"))  {
+						if (oTokenizer.Next(tokCurrent))  {
+							GetNumber(tokCurrent, nXRefStm);
+						}
+					}
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	// in a hybrid file, the stream comes before the older sections
+	if (nXRefStm > 0)  {
+		m_dqPending.push_front(nXRefStm);
+		if (nPrev > 0)  {
+			m_dqPending.insert(m_dqPending.begin() + 1, nPrev);
+		}
+	} else if (nPrev > 0)  {
+		m_dqPending.push_front(nPrev);
+	}
+	return true;
+}
+
+bool
+XRefLoader::LoadStream(Object::ID nID)
+{
+	Object::Ptr pXRef, pW, pIndex;
+	Object::Stream pStream;
+	if (!m_rDoc.GetObject(nID, pXRef) || !pXRef || pXRef->GetType() != Object::kStream ||
+		!pXRef->Get(pW, "W") || !pW || pW->GetLength() != 3 || !pXRef->Get(pStream) || !pStream)
+	{
+		return false;
+	}
+
+	int anWidths[3];
+	for (int i=0; i<3; i++)  {
+		if (!pW->Get(anWidths[i], i) || anWidths[i] < 0 || anWidths[i] > 8)  {
+			return false;
+		}
+	}
+	const size_t nEntrySize = anWidths[0] + anWidths[1] + anWidths[2];
+	if (nEntrySize == 0)  {
+		return false;
+	}
+
+	std::vector<boost::int64_t> vSubsections;
+	if (pXRef->Get(pIndex, "Index") && pIndex)  {
+		for (int i=0; i+1<pIndex->GetLength(); i+=2)  {
+			boost::int64_t nFirst, nCount;
+			if (pIndex->Get(nFirst, i) && pIndex->Get(nCount, i + 1))  {
+				vSubsections.push_back(nFirst);
+				vSubsections.push_back(nCount);
+			}
+		}
+	} else  {
+		boost::int64_t nSize;
+		if (!pXRef->Get(nSize, "Size"))  {
+			return false;
+		}
+		vSubsections.push_back(0);
+		vSubsections.push_back(nSize);
+	}
+
+	std::vector<unsigned char> vEntry(nEntrySize);
+	for (size_t nSub=0; nSub+1<vSubsections.size(); nSub+=2)  {
+		for (boost::int64_t i=0; i<vSubsections[nSub + 1]; i++)  {
+			if (pStream->rdbuf()->sgetn((char *)&vEntry[0], nEntrySize) != (std::streamsize)nEntrySize)  {
+				return true;
+			}
+			boost::int64_t anFields[3] = { 1, 0, 0 };
+			const unsigned char *pField = &vEntry[0];
+			for (int nField=0; nField<3; nField++)  {
+				if (anWidths[nField] > 0)  {
+					anFields[nField] = 0;
+				}
+				for (int nByte=0; nByte<anWidths[nField]; nByte++)  {
+					anFields[nField] = (anFields[nField] << 8) | *pField++;
+				}
+			}
+			XRefIndex::Entry oEntry;
+			if (anFields[0] == 1)  {
+				oEntry.m_eType = XRefIndex::Entry::kInFile;
+				oEntry.m_nOffset = anFields[1];
+			} else if (anFields[0] == 2)  {
+				oEntry.m_eType = XRefIndex::Entry::kInStream;
+				oEntry.m_nContainer = (Object::ID)anFields[1];
+				oEntry.m_nIndex = (unsigned int)anFields[2];
+			}
+			Set(vSubsections[nSub] + i, oEntry);
+		}
+	}
+
+	boost::int64_t nPrev;
+	if (pXRef->Get(nPrev, "Prev"))  {
+		m_dqPending.push_front(nPrev);
+	}
+	return true;
+}
+
+void
+XRefLoader::Set(boost::int64_t nID, const XRefIndex::Entry &rEntry)
+{
+	if (nID < 0)  {
+		return;
+	}
+	// the index is sized by the numbers the file gives, so a broken or
+	// hostile one mustn't take it anywhere the file couldn't fill
+	if (nID > m_nMaxID)  {
+		m_rIndex.m_nSkipped++;
+		return;
+	}
+	if ((size_t)nID >= m_vSet.size())  {
+		m_vSet.resize(nID + 1, false);
+		m_rIndex.m_vEntries.resize(nID + 1);
+	}
+	if (!m_vSet[nID])  {
+		m_vSet[nID] = true;
+		m_rIndex.m_vEntries[nID] = rEntry;
+	}
+}
+
+
+XRefIndex::Ptr
+XRefIndex::Load(Reader &rReader, const Document &rDoc)
+{
+	PDFLIB_TRACE_SPAN("XRefIndex::Load", "xref");
+	boost::shared_ptr<XRefIndex> pIndex(new XRefIndex);
+	XRefLoader oLoader(rReader, rDoc, *pIndex);
+	if (!oLoader.Load())  {
+		return Ptr();
+	}
+	return pIndex;
+}
+
+bool
+XRefIndex::GetEntry(Object::ID nID, Entry &rEntry) const
+{
+	if (nID < 0 || (size_t)nID >= m_vEntries.size() ||
+		m_vEntries[nID].m_eType == Entry::kFree)
+	{
+		return false;
+	}
+	rEntry = m_vEntries[nID];
+	return true;
+}
+
+bool
+XRefIndex::GetExtent(Object::ID nID, boost::int64_t &nOffset, boost::int64_t &nLength) const
+{
+	Entry oEntry;
+	if (!GetEntry(nID, oEntry))  {
+		return false;
+	}
+	if (oEntry.m_eType == Entry::kInStream &&
+		(!GetEntry(oEntry.m_nContainer, oEntry) || oEntry.m_eType != Entry::kInFile))
+	{
+		return false;
+	}
+
+	nOffset = oEntry.m_nOffset;
+	std::vector<boost::int64_t>::const_iterator itNext =
+		std::upper_bound(m_vOffsets.begin(), m_vOffsets.end(), nOffset);
+	nLength = (itNext != m_vOffsets.end() ? *itNext : m_nFileSize) - nOffset;
+	return nLength >= 0;
+}
+
+void
+XRefIndex::Plan(const std::vector<Object::ID> &vIDs, RunList &vRuns,
+	size_t nMaxGap /*= 64 * 1024*/, size_t nMaxRun /*= 4 * 1024 * 1024*/) const
+{
+	vRuns.clear();
+
+	std::vector<PlanItem> vItems;
+	vItems.reserve(vIDs.size());
+	std::vector<size_t> vUnknown;
+	for (size_t i=0; i<vIDs.size(); i++)  {
+		PlanItem oItem;
+		boost::int64_t nLength;
+		if (GetExtent(vIDs[i], oItem.m_nOffset, nLength))  {
+			oItem.m_nEnd = oItem.m_nOffset + nLength;
+			oItem.m_nIndex = m_vEntries[vIDs[i]].m_nIndex;
+			oItem.m_nRequest = i;
+			vItems.push_back(oItem);
+		} else  {
+			vUnknown.push_back(i);
+		}
+	}
+	std::sort(vItems.begin(), vItems.end());
+
+	std::vector<PlanItem>::const_iterator itItem = vItems.begin(),
+		itEndItems = vItems.end();
+	while (itItem != itEndItems)  {
+		if (vRuns.empty() ||
+			itItem->m_nOffset > vRuns.back().m_nOffset + vRuns.back().m_nLength + (boost::int64_t)nMaxGap ||
+			itItem->m_nEnd - vRuns.back().m_nOffset > (boost::int64_t)nMaxRun)
+		{
+			vRuns.push_back(Run());
+			vRuns.back().m_nOffset = itItem->m_nOffset;
+			vRuns.back().m_nLength = 0;
+		}
+		Run &rRun = vRuns.back();
+		rRun.m_nLength = (std::max)(rRun.m_nLength, itItem->m_nEnd - rRun.m_nOffset);
+		rRun.m_vRequests.push_back(itItem->m_nRequest);
+		++itItem;
+	}
+
+	std::vector<size_t>::const_iterator itUnknown = vUnknown.begin(),
+		itEndUnknown = vUnknown.end();
+	while (itUnknown != itEndUnknown)  {
+		vRuns.push_back(Run());
+		vRuns.back().m_nOffset = 0;
+		vRuns.back().m_nLength = 0;
+		vRuns.back().m_vRequests.push_back(*itUnknown);
+		++itUnknown;
+	}
+}
+
+}
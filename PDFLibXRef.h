@@ -0,0 +1,79 @@
+/*
+ *  PDFLibXRef.h
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#ifndef APAGO_PDFLibXRef_h__
+#define APAGO_PDFLibXRef_h__
+
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "PDFLibWrapper.h"
+
+namespace PDFLibWrapper  {
+
+	// Where every object of a file lives, read from its cross-reference
+	// tables and streams (following /Prev and /XRefStm).  Only used to
+	// plan reads:  the objects themselves still come from the Document.
+	class XRefIndex : private boost::noncopyable  {
+	public:
+		typedef boost::shared_ptr<const XRefIndex> Ptr;
+
+		struct Entry  {
+			enum Type { kFree, kInFile, kInStream };
+
+			Entry() : m_eType(kFree), m_nOffset(0), m_nContainer(Object::kInvalidID), m_nIndex(0)  { }
+
+			Type m_eType;
+			boost::int64_t m_nOffset;
+			// the object stream holding a kInStream object
+			Object::ID m_nContainer;
+			unsigned int m_nIndex;
+		};
+
+		// bytes to read for some of the requested objects, and which ones
+		struct Run  {
+			boost::int64_t m_nOffset;
+			boost::int64_t m_nLength;
+			std::vector<size_t> m_vRequests;
+		};
+		typedef std::vector<Run> RunList;
+
+		// xref streams are decoded through pDoc
+		static Ptr Load(Reader &rReader, const Document &rDoc);
+
+		size_t GetSize() const  { return m_vEntries.size(); }
+		// entries dropped for numbers beyond what the file could hold
+		size_t GetSkipped() const  { return m_nSkipped; }
+		bool GetEntry(Object::ID nID, Entry &rEntry) const;
+		// file range of an object, up to the start of the next one; for
+		// objects in object streams, that of their container
+		bool GetExtent(Object::ID nID, boost::int64_t &nOffset, boost::int64_t &nLength) const;
+
+		// Sorts the objects by file position and merges neighbours less
+		// than nMaxGap apart into runs of up to nMaxRun bytes.  Objects the
+		// index doesn't know get a run of their own, with no bytes.
+		void Plan(const std::vector<Object::ID> &vIDs, RunList &vRuns,
+			size_t nMaxGap = 64 * 1024, size_t nMaxRun = 4 * 1024 * 1024) const;
+
+	private:
+		XRefIndex() : m_nFileSize(0), m_nSkipped(0)  { }
+
+		std::vector<Entry> m_vEntries;
+		// start of every object and xref section, ascending
+		std::vector<boost::int64_t> m_vOffsets;
+		boost::int64_t m_nFileSize;
+		size_t m_nSkipped;
+
+		friend class XRefLoader;
+	};
+
+}
+
+#endif // APAGO_PDFLibXRef_h__
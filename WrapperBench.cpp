@@ -0,0 +1,1034 @@
+/*
+ *  WrapperBench.cpp
+ *
+ *  Copyright (c) 2014-2015, Apago, Inc. All rights reserved.
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <zlib.h>
+
+#include "PDFLibWrapper.h"
+#include "PDFLibPreflight.h"
+#include "PDFLibFilters.h"
+#include "PDFLibMemory.h"
+#include "PDFLibText.h"
+#include "PDFLibTrace.h"
+#include "PDFLibVisit.h"
+
+using namespace PDFLibWrapper;
+
+namespace  {
+
+	class Stopwatch  {
+	public:
+		Stopwatch() : m_tmStart(Now())  { }
+		double Elapsed() const  {
+			return (Now() - m_tmStart).total_microseconds() / 1e6;
+		}
+	private:
+		static boost::posix_time::ptime Now()  {
+			return boost::posix_time::microsec_clock::universal_time();
+		}
+		boost::posix_time::ptime m_tmStart;
+	};
+
+	// a typical cheap check:  looks at one key of every dictionary it is
+	// interested in
+	class KeyCheckRule : public Rule  {
+	public:
+		KeyCheckRule(const std::string &sName, const Name &nmKey, bool bWantDicts)
+			: Rule(sName), m_nChecked(0), m_nmKey(nmKey), m_bWantDicts(bWantDicts)
+		{ }
+
+		virtual void GetInterests(RuleInterests &rInterests) const  {
+			rInterests.AddKey(m_nmKey);
+			if (m_bWantDicts)  {
+				rInterests.AddType(Object::kDict);
+			}
+		}
+
+		virtual void Check(RuleContext &rContext)  {
+			++m_nChecked;
+			Name nmValue;
+			if (rContext.GetObject()->Get(nmValue, m_nmKey) && !nmValue.IsValid())  {
+				rContext.Report("invalid name");
+			}
+		}
+
+		unsigned long m_nChecked;
+
+	private:
+		Name m_nmKey;
+		bool m_bWantDicts;
+	};
+
+	Rule::Ptr
+	MakeRule(int nIndex)
+	{
+		static const char *aszKeys[] =  {
+			"Type", "Subtype", "Resources", "Contents", "MediaBox", "Font",
+			"XObject", "Filter", "Length", "BaseFont", "Encoding", "Parent",
+			"Kids", "Annots", "ColorSpace", "ExtGState", "Width", "Height",
+			"BitsPerComponent", "FontDescriptor"
+		};
+		const int nKeys = sizeof(aszKeys) / sizeof(aszKeys[0]);
+		char szName[32];
+		sprintf(szName, "rule%d", nIndex);
+		return Rule::Ptr(new KeyCheckRule(szName, aszKeys[nIndex % nKeys], nIndex % 4 == 0));
+	}
+
+	double
+	TimeRules(const Document::Ptr &pDoc, int nRules, int nPasses, size_t &nFindings)
+	{
+		Stopwatch oTimer;
+		nFindings = 0;
+		for (int nPass=0; nPass<nPasses; nPass++)  {
+			RuleEngine oEngine;
+			for (int i=0; i<nRules; i++)  {
+				oEngine.AddRule(MakeRule(nPass * nRules + i));
+			}
+			// a fresh document each pass, so nothing is served from the
+			// object caches of a previous one
+			Document::Ptr pPassDoc = pDoc->Reopen();
+			FindingList vFindings;
+			oEngine.Run(pPassDoc ? pPassDoc : pDoc, vFindings);
+			nFindings += vFindings.size();
+		}
+		return oTimer.Elapsed();
+	}
+
+	void
+	ReportPrefetch(const Document::Ptr &pDoc, int nDepth)
+	{
+		Document::Ptr pPassDoc = pDoc->Reopen();
+		if (!pPassDoc)  {
+			return;
+		}
+		PrefetchOptions oOptions;
+		oOptions.m_nDepth = nDepth;
+		pPassDoc->SetPrefetch(oOptions);
+
+		Stopwatch oTimer;
+		RuleEngine oEngine;
+		oEngine.AddRule(MakeRule(0));
+		FindingList vFindings;
+		oEngine.Run(pPassDoc, vFindings);
+		double dElapsed = oTimer.Elapsed();
+
+		const PrefetchStats &rStats = pPassDoc->GetPrefetchStats();
+		std::cout << "preflight, prefetch depth " << nDepth << ":         " << dElapsed
+			<< " s  (" << rStats.m_nHits << " of " << rStats.m_nIssued << " prefetched used, "
+			<< rStats.m_nLoaded << " loaded, " << rStats.m_nOverBudget << " over budget, "
+			<< rStats.m_nExpired << " expired, " << rStats.m_nBytes << " bytes)" << std::endl;
+	}
+
+	// data that looks like a scanned page: smooth with some noise
+	void
+	MakeImageData(std::vector<unsigned char> &vData, size_t nSize)
+	{
+		vData.resize(nSize);
+		srand(1);
+		unsigned char nValue = 128;
+		for (size_t i=0; i<nSize; i++)  {
+			nValue += (unsigned char)(rand() % 7 - 3);
+			vData[i] = nValue;
+		}
+	}
+
+	void
+	EncodeASCIIHex(const std::vector<unsigned char> &vData, std::string &sEncoded)
+	{
+		static const char szDigits[] = "0123456789ABCDEF";
+		sEncoded.clear();
+		for (size_t i=0; i<vData.size(); i++)  {
+			sEncoded += szDigits[vData[i] >> 4];
+			sEncoded += szDigits[vData[i] & 15];
+			if (i % 32 == 31)  {
+				sEncoded += '\n';
+			}
+		}
+		sEncoded += '>';
+	}
+
+	void
+	EncodeASCII85(const std::vector<unsigned char> &vData, std::string &sEncoded)
+	{
+		sEncoded.clear();
+		size_t nLine = 0;
+		for (size_t i=0; i+4<=vData.size(); i+=4)  {
+			unsigned int nTuple = (vData[i] << 24) | (vData[i + 1] << 16) | (vData[i + 2] << 8) | vData[i + 3];
+			char szGroup[5];
+			for (int j=4; j>=0; j--)  {
+				szGroup[j] = (char)('!' + nTuple % 85);
+				nTuple /= 85;
+			}
+			sEncoded.append(szGroup, 5);
+			if (++nLine == 15)  {
+				sEncoded += '\n';
+				nLine = 0;
+			}
+		}
+		sEncoded += "~>";
+	}
+
+	void
+	EncodePNGRows(const std::vector<unsigned char> &vData, int nType, size_t nRowBytes,
+		size_t nPixelBytes, std::string &sEncoded)
+	{
+		sEncoded.clear();
+		for (size_t nRow=0; nRow+nRowBytes<=vData.size(); nRow+=nRowBytes)  {
+			sEncoded += (char)nType;
+			for (size_t i=0; i<nRowBytes; i++)  {
+				size_t nPos = nRow + i;
+				int nLeft = i >= nPixelBytes ? vData[nPos - nPixelBytes] : 0;
+				int nUp = nRow > 0 ? vData[nPos - nRowBytes] : 0;
+				int nUpLeft = nRow > 0 && i >= nPixelBytes ? vData[nPos - nRowBytes - nPixelBytes] : 0;
+				int nPredicted = 0;
+				if (nType == 1)  {
+					nPredicted = nLeft;
+				} else if (nType == 2)  {
+					nPredicted = nUp;
+				} else if (nType == 3)  {
+					nPredicted = (nLeft + nUp) / 2;
+				} else if (nType == 4)  {
+					int p = nLeft + nUp - nUpLeft;
+					int pa = abs(p - nLeft), pb = abs(p - nUp), pc = abs(p - nUpLeft);
+					nPredicted = pa <= pb && pa <= pc ? nLeft : pb <= pc ? nUp : nUpLeft;
+				}
+				sEncoded += (char)(vData[nPos] - nPredicted);
+			}
+		}
+	}
+
+	enum BenchFilter  { kBenchHex, kBenchASCII85, kBenchPredictor };
+
+	bool
+	RunFilter(BenchFilter eFilter, const std::string &sEncoded, const FilterParams &oParams,
+		std::vector<char> &vOutput)
+	{
+		vOutput.clear();
+		switch (eFilter)  {
+			case kBenchHex:
+				return DecodeASCIIHex(sEncoded.data(), sEncoded.size(), vOutput);
+			case kBenchASCII85:
+				return DecodeASCII85(sEncoded.data(), sEncoded.size(), vOutput);
+			default:
+				vOutput.assign(sEncoded.begin(), sEncoded.end());
+				return ApplyPredictor(oParams, vOutput);
+		}
+	}
+
+	// every implementation against the scalar one, in MB of output per second
+	void
+	ReportFilter(const char *szName, BenchFilter eFilter, const std::string &sEncoded,
+		const FilterParams &oParams, int nPasses)
+	{
+		SetFilterImpl(kFilterScalar);
+		std::vector<char> vReference, vOutput;
+		RunFilter(eFilter, sEncoded, oParams, vReference);
+
+		std::cout << szName;
+		for (int nImpl=kFilterScalar; nImpl<=kFilterAVX2; nImpl++)  {
+			FilterImpl eImpl = (FilterImpl)nImpl;
+			if (!SetFilterImpl(eImpl))  {
+				continue;
+			}
+			Stopwatch oTimer;
+			for (int nPass=0; nPass<nPasses; nPass++)  {
+				RunFilter(eFilter, sEncoded, oParams, vOutput);
+			}
+			double dElapsed = oTimer.Elapsed();
+			std::cout << "  " << GetFilterImplName(eImpl) << " "
+				<< (double)vOutput.size() * nPasses / (1024 * 1024) / dElapsed << " MB/s";
+			if (vOutput != vReference)  {
+				std::cout << " (MISMATCH)";
+			}
+		}
+		std::cout << std::endl;
+	}
+
+	// inflating into a growing buffer against a single call with the
+	// size known, as from /DL or the image dimensions
+	void
+	ReportFlate(const std::vector<unsigned char> &vData, int nPasses)
+	{
+		uLongf nCompressed = compressBound(vData.size());
+		std::vector<char> vCompressed(nCompressed);
+		compress((Bytef *)&vCompressed[0], &nCompressed, &vData[0], vData.size());
+
+		std::vector<char> vOutput;
+		std::cout << "FlateDecode:           ";
+		for (int nHint=0; nHint<2; nHint++)  {
+			Stopwatch oTimer;
+			for (int nPass=0; nPass<nPasses; nPass++)  {
+				// a fresh buffer each pass, as for a stream just read
+				std::vector<char>().swap(vOutput);
+				DecodeFlate(&vCompressed[0], nCompressed, vOutput, nHint ? vData.size() : 0);
+			}
+			double dElapsed = oTimer.Elapsed();
+			std::cout << (nHint ? "  size known " : "  streaming ")
+				<< (double)vOutput.size() * nPasses / (1024 * 1024) / dElapsed << " MB/s";
+			if (vOutput.size() != vData.size() || memcmp(&vOutput[0], &vData[0], vData.size()) != 0)  {
+				std::cout << " (MISMATCH)";
+			}
+		}
+		std::cout << std::endl;
+	}
+
+	// text strings the length of titles and field names, mostly ASCII
+	// with an accented letter now and then, in each encoding
+	void
+	ReportText(int nPasses)
+	{
+		static const char *aszNames[] =  { "PDFDocEncoding", "UTF-16BE", "UTF-8" };
+		const int nStrings = 100000;
+		for (int nEncoding=kTextPDFDoc; nEncoding<=kTextUTF8; nEncoding++)  {
+			std::vector<std::string> vStrings(nStrings);
+			size_t nBytes = 0;
+			srand(1);
+			for (int i=0; i<nStrings; i++)  {
+				std::string &rText = vStrings[i];
+				rText = nEncoding == kTextUTF16BE ? "\xFE\xFF" : nEncoding == kTextUTF8 ? "\xEF\xBB\xBF" : "";
+				int nLength = 16 + rand() % 48;
+				for (int j=0; j<nLength; j++)  {
+					bool bAccent = rand() % 32 == 0;
+					unsigned char c = bAccent ? 0xE9 : (unsigned char)('a' + rand() % 26);
+					if (nEncoding == kTextUTF16BE)  {
+						rText += '\0';
+						rText += (char)c;
+					} else if (nEncoding == kTextUTF8 && bAccent)  {
+						rText += "\xC3\xA9";
+					} else  {
+						rText += (char)c;
+					}
+				}
+				nBytes += rText.size();
+			}
+
+			std::string sUTF8;
+			size_t nInvalid = 0;
+			Stopwatch oTimer;
+			for (int nPass=0; nPass<nPasses; nPass++)  {
+				for (int i=0; i<nStrings; i++)  {
+					nInvalid += !DecodeTextString(vStrings[i], sUTF8);
+				}
+			}
+			double dElapsed = oTimer.Elapsed();
+			char szName[64];
+			sprintf(szName, "Text %-15s:  ", aszNames[nEncoding]);
+			std::cout << szName << (double)nBytes * nPasses / (1024 * 1024) / dElapsed << " MB/s";
+			if (nInvalid)  {
+				std::cout << " (INVALID)";
+			}
+			std::cout << std::endl;
+		}
+	}
+
+	// Shape of a synthetic document for -corpus.  Every filler object
+	// holds dictionaries nested m_nDepth deep and refers to two more, so a
+	// traversal from the catalog reaches them all.
+	struct CorpusShape  {
+		CorpusShape()
+			: m_nObjects(10000), m_nPages(100), m_nDepth(4), m_nStreamSize(4096),
+			  m_bObjectStreams(false), m_bXRefStream(false)
+		{ }
+
+		int m_nObjects;
+		int m_nPages;
+		int m_nDepth;
+		// bytes in the content stream of each page
+		int m_nStreamSize;
+		// fillers packed into object streams; needs an xref stream
+		bool m_bObjectStreams;
+		bool m_bXRefStream;
+	};
+
+	// fillers per object stream
+	const int kObjectsPerStream = 100;
+
+	void
+	AppendFiller(std::string &sPDF, const CorpusShape &oShape, int nFiller, int nFirstFiller)
+	{
+		char szBuf[256];
+		sprintf(szBuf, "<< /Type /Filler /Index %d /Name /N%d /Key%d %d /Values [%d %d.5 (text %d) true null]",
+			nFiller, nFiller, nFiller % 64, nFiller, nFiller, nFiller, nFiller);
+		sPDF += szBuf;
+		std::string sKids;
+		for (int nKid=2*nFiller+1; nKid<=2*nFiller+2 && nKid<oShape.m_nObjects; nKid++)  {
+			sprintf(szBuf, " %d 0 R", nFirstFiller + nKid);
+			sKids += szBuf;
+		}
+		if (!sKids.empty())  {
+			sPDF += " /Kids [" + sKids + " ]";
+		}
+		for (int nLevel=1; nLevel<=oShape.m_nDepth; nLevel++)  {
+			sprintf(szBuf, " /Child << /Level %d /Box [0 0 %d %d]", nLevel, nLevel, nFiller);
+			sPDF += szBuf;
+		}
+		for (int nLevel=0; nLevel<=oShape.m_nDepth; nLevel++)  {
+			sPDF += " >>";
+		}
+	}
+
+	void
+	AppendObject(std::string &sPDF, int nID, const std::string &sBody,
+		std::vector<boost::int64_t> &vOffsets)
+	{
+		char szBuf[32];
+		sprintf(szBuf, "%d 0 obj\n", nID);
+		vOffsets[nID] = sPDF.size();
+		sPDF += szBuf;
+		sPDF += sBody;
+		sPDF += "\nendobj\n";
+	}
+
+	void
+	AppendStream(std::string &sPDF, int nID, const std::string &sDict, const std::string &sData,
+		std::vector<boost::int64_t> &vOffsets)
+	{
+		char szBuf[32];
+		sprintf(szBuf, " /Length %lu >>\nstream\n", (unsigned long)sData.size());
+		AppendObject(sPDF, nID, "<< " + sDict + szBuf + sData + "\nendstream", vOffsets);
+	}
+
+	// Objects 1 and 2 are the catalog and the page tree, 3 the font, then
+	// the pages, their contents, the fillers, the object streams and the
+	// xref stream.
+	void
+	GenerateCorpusPDF(const CorpusShape &oShape, std::string &sPDF)
+	{
+		const int nPages = oShape.m_nPages, nFillers = oShape.m_nObjects;
+		const bool bXRefStream = oShape.m_bXRefStream || oShape.m_bObjectStreams;
+		const int nFirstPage = 4, nFirstContents = nFirstPage + nPages;
+		const int nFirstFiller = nFirstContents + nPages;
+		const int nFirstObjStm = nFirstFiller + nFillers;
+		const int nObjStms = oShape.m_bObjectStreams ?
+			(nFillers + kObjectsPerStream - 1) / kObjectsPerStream : 0;
+		const int nXRef = nFirstObjStm + nObjStms;
+		const int nSize = nXRef + (bXRefStream ? 1 : 0);
+		std::vector<boost::int64_t> vOffsets(nSize, 0);
+		char szBuf[256];
+
+		sPDF = bXRefStream ? "%PDF-1.5\n%\xE2\xE3\xCF\xD3\n" : "%PDF-1.4\n%\xE2\xE3\xCF\xD3\n";
+
+		std::string sBody = "<< /Type /Catalog /Pages 2 0 R";
+		if (nFillers > 0)  {
+			sprintf(szBuf, " /Fillers %d 0 R", nFirstFiller);
+			sBody += szBuf;
+		}
+		AppendObject(sPDF, 1, sBody + " >>", vOffsets);
+
+		sprintf(szBuf, "<< /Type /Pages /Count %d /Kids [", nPages);
+		sBody = szBuf;
+		for (int i=0; i<nPages; i++)  {
+			sprintf(szBuf, " %d 0 R", nFirstPage + i);
+			sBody += szBuf;
+		}
+		AppendObject(sPDF, 2, sBody + " ] >>", vOffsets);
+		// widths as a font program would have them, a few of them fractional
+		sBody = "<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica /FirstChar 32 /LastChar 255 /Widths [";
+		for (int nChar=32; nChar<=255; nChar++)  {
+			sprintf(szBuf, nChar % 7 ? " %d" : " %d.5", 250 + nChar * 37 % 500);
+			sBody += szBuf;
+		}
+		AppendObject(sPDF, 3, sBody + " ] >>", vOffsets);
+
+		std::string sContents;
+		for (int nOp=0; (int)sContents.size()<oShape.m_nStreamSize; nOp++)  {
+			sprintf(szBuf, "BT /F1 12 Tf 72 %d Td (Line %d) Tj ET\nq 1 0 0 1 %d 10 cm 0 0 50 50 re f Q\n",
+				700 - nOp % 60 * 10, nOp, nOp % 500);
+			sContents += szBuf;
+		}
+		sContents.resize(oShape.m_nStreamSize, '\n');
+		for (int i=0; i<nPages; i++)  {
+			sprintf(szBuf, "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] "
+				"/Resources << /Font << /F1 3 0 R >> >> /Contents %d 0 R >>", nFirstContents + i);
+			AppendObject(sPDF, nFirstPage + i, szBuf, vOffsets);
+			AppendStream(sPDF, nFirstContents + i, "", sContents, vOffsets);
+		}
+
+		if (!oShape.m_bObjectStreams)  {
+			for (int i=0; i<nFillers; i++)  {
+				sBody.clear();
+				AppendFiller(sBody, oShape, i, nFirstFiller);
+				AppendObject(sPDF, nFirstFiller + i, sBody, vOffsets);
+			}
+		}
+		for (int nStm=0; nStm<nObjStms; nStm++)  {
+			std::string sHeader, sObjects;
+			int nFirst = nStm * kObjectsPerStream;
+			int nCount = (std::min)(kObjectsPerStream, nFillers - nFirst);
+			for (int i=0; i<nCount; i++)  {
+				sprintf(szBuf, "%d %lu ", nFirstFiller + nFirst + i, (unsigned long)sObjects.size());
+				sHeader += szBuf;
+				AppendFiller(sObjects, oShape, nFirst + i, nFirstFiller);
+				sObjects += "\n";
+			}
+			sprintf(szBuf, "/Type /ObjStm /N %d /First %lu", nCount, (unsigned long)sHeader.size());
+			AppendStream(sPDF, nFirstObjStm + nStm, szBuf, sHeader + sObjects, vOffsets);
+		}
+
+		if (!bXRefStream)  {
+			boost::int64_t nXRefOffset = sPDF.size();
+			sprintf(szBuf, "xref\n0 %d\n0000000000 65535 f \n", nSize);
+			sPDF += szBuf;
+			for (int nID=1; nID<nSize; nID++)  {
+				sprintf(szBuf, "%010lld 00000 n \n", (long long)vOffsets[nID]);
+				sPDF += szBuf;
+			}
+			sprintf(szBuf, "trailer\n<< /Size %d /Root 1 0 R >>\nstartxref\n%lld\n%%%%EOF\n",
+				nSize, (long long)nXRefOffset);
+			sPDF += szBuf;
+			return;
+		}
+
+		// type, offset or object stream, generation or index:  1, 4 and 2 bytes
+		vOffsets[nXRef] = sPDF.size();
+		std::string sEntries;
+		for (int nID=0; nID<nSize; nID++)  {
+			unsigned char aEntry[7] = { 1, 0, 0, 0, 0, 0, 0 };
+			boost::uint64_t nField2 = vOffsets[nID], nField3 = 0;
+			if (nID == 0)  {
+				aEntry[0] = 0;
+				nField3 = 65535;
+			} else if (oShape.m_bObjectStreams && nID >= nFirstFiller && nID < nFirstObjStm)  {
+				aEntry[0] = 2;
+				nField2 = nFirstObjStm + (nID - nFirstFiller) / kObjectsPerStream;
+				nField3 = (nID - nFirstFiller) % kObjectsPerStream;
+			}
+			for (int i=0; i<4; i++)  {
+				aEntry[1 + i] = (unsigned char)(nField2 >> (8 * (3 - i)));
+			}
+			aEntry[5] = (unsigned char)(nField3 >> 8);
+			aEntry[6] = (unsigned char)nField3;
+			sEntries.append((const char *)aEntry, sizeof(aEntry));
+		}
+		sprintf(szBuf, "/Type /XRef /Size %d /W [1 4 2] /Root 1 0 R", nSize);
+		AppendStream(sPDF, nXRef, szBuf, sEntries, vOffsets);
+		sprintf(szBuf, "startxref\n%lld\n%%%%EOF\n", (long long)vOffsets[nXRef]);
+		sPDF += szBuf;
+	}
+
+	struct CorpusResults  {
+		CorpusResults()
+			: m_dOpenMs(0), m_dObjectsPerSecond(0), m_dKeysPerSecond(0),
+			  m_dNameInsertsPerSecond(0), m_dNameLookupsPerSecond(0), m_dTraversalSeconds(0),
+			  m_dWidthsPerSecond(0), m_dBulkWidthsPerSecond(0), m_dGetValuesPerSecond(0),
+			  m_dVisitValuesPerSecond(0), m_nObjectsResolved(0)
+		{ }
+
+		double m_dOpenMs;
+		double m_dObjectsPerSecond;
+		double m_dKeysPerSecond;
+		double m_dNameInsertsPerSecond;
+		double m_dNameLookupsPerSecond;
+		double m_dTraversalSeconds;
+		// /Widths elements read one by one, and with GetArray
+		double m_dWidthsPerSecond;
+		double m_dBulkWidthsPerSecond;
+		// values below the objects, read with GetType and Get, and visited
+		double m_dGetValuesPerSecond;
+		double m_dVisitValuesPerSecond;
+		long m_nObjectsResolved;
+	};
+
+	// Names live as long as the process, so every run interns names no
+	// earlier run has seen.
+	void
+	TimeNames(int nNames, CorpusResults &oResults)
+	{
+		static int nRun = 0;
+		std::vector<std::string> vNames(nNames);
+		for (int i=0; i<nNames; i++)  {
+			char szName[32];
+			sprintf(szName, "Bench%d_%d", nRun, i);
+			vNames[i] = szName;
+		}
+		++nRun;
+
+		Stopwatch oInsert;
+		for (int i=0; i<nNames; i++)  {
+			Name nmName(vNames[i]);
+		}
+		oResults.m_dNameInsertsPerSecond = nNames / oInsert.Elapsed();
+
+		const int nPasses = 10;
+		Stopwatch oLookup;
+		for (int nPass=0; nPass<nPasses; nPass++)  {
+			for (int i=0; i<nNames; i++)  {
+				Name nmName(vNames[i]);
+			}
+		}
+		oResults.m_dNameLookupsPerSecond = (double)nNames * nPasses / oLookup.Elapsed();
+	}
+
+	// the font of the corpus is object 3
+	bool
+	TimeWidths(const Document::Ptr &pDoc, CorpusResults &oResults)
+	{
+		Object::Ptr pFont, pWidths;
+		if (!pDoc->GetObject(3, pFont) || !pFont || !pFont->Get(pWidths, "Widths") || !pWidths)  {
+			return false;
+		}
+
+		const int nPasses = 10000;
+		const int nLength = pWidths->GetLength();
+		double dSum = 0, dBulkSum = 0;
+		Stopwatch oSingle;
+		for (int nPass=0; nPass<nPasses; nPass++)  {
+			for (int i=0; i<nLength; i++)  {
+				int nWidth;
+				double dWidth;
+				if (pWidths->Get(nWidth, i))  {
+					dSum += nWidth;
+				} else if (pWidths->Get(dWidth, i))  {
+					dSum += dWidth;
+				}
+			}
+		}
+		oResults.m_dWidthsPerSecond = (double)nLength * nPasses / oSingle.Elapsed();
+
+		std::vector<double> vWidths;
+		Stopwatch oBulk;
+		for (int nPass=0; nPass<nPasses; nPass++)  {
+			pWidths->GetArray(vWidths);
+			for (size_t i=0; i<vWidths.size(); i++)  {
+				dBulkSum += vWidths[i];
+			}
+		}
+		oResults.m_dBulkWidthsPerSecond = (double)nLength * nPasses / oBulk.Elapsed();
+		return dSum == dBulkSum;
+	}
+
+	// Values in and below an object, not following references; the
+	// integers are summed so that both ways of reading can be compared.
+	struct ValueTally  {
+		ValueTally() : m_nValues(0), m_nSum(0)  { }
+
+		long m_nValues;
+		boost::int64_t m_nSum;
+	};
+
+	void TallyWithGet(const Object::Ptr &pObject, ValueTally &rTally);
+
+	void
+	TallyChildWithGet(const Object::Ptr &pChild, ValueTally &rTally)
+	{
+		if (!pChild)  {
+			++rTally.m_nValues;
+		} else if (pChild->IsIndirect())  {
+			++rTally.m_nValues;
+		} else  {
+			TallyWithGet(pChild, rTally);
+		}
+	}
+
+	// the way PrintInfo in WrapperTest.cpp does it
+	void
+	TallyWithGet(const Object::Ptr &pObject, ValueTally &rTally)
+	{
+		++rTally.m_nValues;
+		switch (pObject->GetType())  {
+			case Object::kBoolean:  {
+				bool bValue;
+				pObject->Get(bValue);
+				break;
+			}
+			case Object::kInteger:  {
+				int nValue;
+				if (pObject->Get(nValue))  {
+					rTally.m_nSum += nValue;
+				}
+				break;
+			}
+			case Object::kFixed:  {
+				double dValue;
+				pObject->Get(dValue);
+				break;
+			}
+			case Object::kName:  {
+				Name nmValue;
+				pObject->Get(nmValue);
+				break;
+			}
+			case Object::kString:  {
+				std::string sValue;
+				pObject->Get(sValue);
+				break;
+			}
+			case Object::kArray:  {
+				int nLength = pObject->GetLength();
+				for (int i=0; i<nLength; i++)  {
+					Object::Ptr pElement;
+					pObject->Get(pElement, i);
+					TallyChildWithGet(pElement, rTally);
+				}
+				break;
+			}
+			case Object::kDict:
+			case Object::kStream:  {
+				NameSet setKeys;
+				pObject->GetKeys(setKeys);
+				for (NameSet::const_iterator it = setKeys.begin(); it != setKeys.end(); ++it)  {
+					Object::Ptr pValue;
+					pObject->Get(pValue, *it);
+					TallyChildWithGet(pValue, rTally);
+				}
+				break;
+			}
+			default:
+				break;
+		}
+	}
+
+	class TallyVisitor : public ValueVisitor  {
+	public:
+		explicit TallyVisitor(ValueTally &rTally) : m_rTally(rTally), m_nDepth(0)  { }
+
+		void OnNull()  { ++m_rTally.m_nValues; }
+		void OnBoolean(bool)  { ++m_rTally.m_nValues; }
+		void OnInteger(boost::int64_t nValue)  { ++m_rTally.m_nValues; m_rTally.m_nSum += nValue; }
+		void OnReal(double)  { ++m_rTally.m_nValues; }
+		void OnName(const Name &)  { ++m_rTally.m_nValues; }
+		void OnString(const std::string &)  { ++m_rTally.m_nValues; }
+		void OnArray(const Object::Ptr &pArray)  { OnChild(pArray); }
+		void OnDict(const Object::Ptr &pDict)  { OnChild(pDict); }
+		void OnStream(const Object::Ptr &pStream)  { OnChild(pStream); }
+		void OnUnknown()  { ++m_rTally.m_nValues; }
+
+		void Tally(const Object::Ptr &pObject)  {
+			++m_rTally.m_nValues;
+			// values of every level, reused from object to object; a deque, so
+			// that adding a level leaves those being visited where they are
+			if (m_dqLevels.size() <= m_nDepth)  {
+				m_dqLevels.resize(m_nDepth + 1);
+			}
+			Level &rLevel = m_dqLevels[m_nDepth++];
+			if (pObject->GetType() == Object::kArray)  {
+				VisitElements(*pObject, *this, rLevel.m_vValues);
+			} else  {
+				VisitEntries(*pObject, *this, rLevel.m_vEntries);
+			}
+			--m_nDepth;
+		}
+
+	private:
+		struct Level  {
+			std::vector<Object::Value> m_vValues;
+			std::vector<Object::Entry> m_vEntries;
+		};
+
+		void OnChild(const Object::Ptr &pChild)  {
+			if (pChild->IsIndirect())  {
+				++m_rTally.m_nValues;
+			} else  {
+				Tally(pChild);
+			}
+		}
+
+		ValueTally &m_rTally;
+		std::deque<Level> m_dqLevels;
+		size_t m_nDepth;
+	};
+
+	bool
+	TimeValues(const std::vector<Object::Ptr> &vObjects, CorpusResults &oResults)
+	{
+		const int nPasses = 5;
+		ValueTally oGetTally, oVisitTally;
+
+		Stopwatch oGet;
+		for (int nPass=0; nPass<nPasses; nPass++)  {
+			for (size_t i=0; i<vObjects.size(); i++)  {
+				TallyWithGet(vObjects[i], oGetTally);
+			}
+		}
+		oResults.m_dGetValuesPerSecond = oGetTally.m_nValues / oGet.Elapsed();
+
+		TallyVisitor oVisitor(oVisitTally);
+		Stopwatch oVisit;
+		for (int nPass=0; nPass<nPasses; nPass++)  {
+			for (size_t i=0; i<vObjects.size(); i++)  {
+				if (vObjects[i]->GetType() == Object::kArray || vObjects[i]->GetType() == Object::kDict ||
+					vObjects[i]->GetType() == Object::kStream)
+				{
+					oVisitor.Tally(vObjects[i]);
+				} else  {
+					TallyWithGet(vObjects[i], oVisitTally);
+				}
+			}
+		}
+		oResults.m_dVisitValuesPerSecond = oVisitTally.m_nValues / oVisit.Elapsed();
+		return oGetTally.m_nValues == oVisitTally.m_nValues && oGetTally.m_nSum == oVisitTally.m_nSum;
+	}
+
+	bool
+	RunCorpus(const std::string &sPDF, CorpusResults &oResults)
+	{
+		Object::Buffer pData((const unsigned char *)memcpy(new unsigned char[sPDF.size()],
+			sPDF.data(), sPDF.size()));
+
+		const int nOpens = 20;
+		Document::Ptr pDoc;
+		Stopwatch oOpen;
+		for (int i=0; i<nOpens; i++)  {
+			pDoc = Document::Open(pData, sPDF.size());
+			if (!pDoc || !pDoc->IsValid())  {
+				return false;
+			}
+		}
+		oResults.m_dOpenMs = oOpen.Elapsed() * 1000 / nOpens;
+
+		// each object once, from a document that hasn't loaded any
+		Document::Ptr pPassDoc = Document::Open(pData, sPDF.size());
+		std::vector<Object::Ptr> vObjects;
+		Stopwatch oResolve;
+		for (Object::ID nID=1; ; nID++)  {
+			Object::Ptr pObject;
+			if (!pPassDoc->GetObject(nID, pObject) || !pObject)  {
+				break;
+			}
+			vObjects.push_back(pObject);
+		}
+		oResults.m_nObjectsResolved = (long)vObjects.size();
+		oResults.m_dObjectsPerSecond = vObjects.size() / oResolve.Elapsed();
+
+		size_t nKeys = 0;
+		Stopwatch oKeys;
+		for (size_t i=0; i<vObjects.size(); i++)  {
+			NameSet setKeys;
+			if (vObjects[i]->GetKeys(setKeys))  {
+				nKeys += setKeys.size();
+			}
+		}
+		oResults.m_dKeysPerSecond = nKeys / oKeys.Elapsed();
+
+		TimeNames(100000, oResults);
+		if (!TimeWidths(pPassDoc, oResults) || !TimeValues(vObjects, oResults))  {
+			return false;
+		}
+
+		size_t nFindings;
+		oResults.m_dTraversalSeconds = TimeRules(pDoc, 1, 1, nFindings);
+		return true;
+	}
+
+	void
+	WriteCorpusJSON(std::ostream &rOut, const CorpusShape &oShape, size_t nBytes,
+		const CorpusResults &oResults)
+	{
+		rOut << "{\n  \"backend\": \"" << Document::GetBackend() << "\",\n  \"shape\": {"
+			<< "\"objects\": " << oShape.m_nObjects
+			<< ", \"pages\": " << oShape.m_nPages
+			<< ", \"depth\": " << oShape.m_nDepth
+			<< ", \"stream_size\": " << oShape.m_nStreamSize
+			<< ", \"object_streams\": " << (oShape.m_bObjectStreams ? "true" : "false")
+			<< ", \"xref_stream\": " << (oShape.m_bXRefStream || oShape.m_bObjectStreams ? "true" : "false")
+			<< ", \"bytes\": " << nBytes << "},\n"
+			<< "  \"results\": {"
+			<< "\"open_ms\": " << oResults.m_dOpenMs
+			<< ", \"objects_resolved\": " << oResults.m_nObjectsResolved
+			<< ", \"objects_per_s\": " << oResults.m_dObjectsPerSecond
+			<< ", \"keys_per_s\": " << oResults.m_dKeysPerSecond
+			<< ", \"name_inserts_per_s\": " << oResults.m_dNameInsertsPerSecond
+			<< ", \"name_lookups_per_s\": " << oResults.m_dNameLookupsPerSecond
+			<< ", \"traversal_s\": " << oResults.m_dTraversalSeconds
+			<< ", \"widths_per_s\": " << oResults.m_dWidthsPerSecond
+			<< ", \"bulk_widths_per_s\": " << oResults.m_dBulkWidthsPerSecond
+			<< ", \"get_values_per_s\": " << oResults.m_dGetValuesPerSecond
+			<< ", \"visit_values_per_s\": " << oResults.m_dVisitValuesPerSecond
+			<< "}\n}\n";
+	}
+
+	int
+	RunCorpusBench(int argc, char **argv)
+	{
+		CorpusShape oShape;
+		const char *szJSON = NULL, *szSave = NULL;
+		// the in-memory backend measures the wrapper without any PDF library
+		Document::Register("Memory", Document::Ptr(new MemoryDoc));
+		for (int i=2; i<argc; i++)  {
+			std::string sArg = argv[i];
+			bool bHasValue = i + 1 < argc;
+			if (sArg == "-objstm")  {
+				oShape.m_bObjectStreams = true;
+			} else if (sArg == "-xrefstm")  {
+				oShape.m_bXRefStream = true;
+			} else if (sArg == "-objects" && bHasValue)  {
+				oShape.m_nObjects = atoi(argv[++i]);
+			} else if (sArg == "-pages" && bHasValue)  {
+				oShape.m_nPages = atoi(argv[++i]);
+			} else if (sArg == "-depth" && bHasValue)  {
+				oShape.m_nDepth = atoi(argv[++i]);
+			} else if (sArg == "-stream-size" && bHasValue)  {
+				oShape.m_nStreamSize = atoi(argv[++i]);
+			} else if (sArg == "-json" && bHasValue)  {
+				szJSON = argv[++i];
+			} else if (sArg == "-save" && bHasValue)  {
+				szSave = argv[++i];
+			} else if (sArg == "-backend" && bHasValue)  {
+				if (!Document::SelectBackend(argv[++i]))  {
+					std::cerr << "Unknown backend " << argv[i] << std::endl;
+					return 1;
+				}
+			} else  {
+				std::cerr << "Unknown or incomplete option " << sArg << std::endl;
+				return 1;
+			}
+		}
+		if (oShape.m_nObjects < 0 || oShape.m_nPages < 0 || oShape.m_nDepth < 0 ||
+			oShape.m_nStreamSize < 0)
+		{
+			std::cerr << "Counts and sizes can't be negative" << std::endl;
+			return 1;
+		}
+
+		std::string sPDF;
+		GenerateCorpusPDF(oShape, sPDF);
+		if (szSave)  {
+			std::ofstream oOut(szSave, std::ios::out | std::ios::binary);
+			if (!oOut.write(sPDF.data(), sPDF.size()))  {
+				std::cerr << "Error writing " << szSave << std::endl;
+				return 1;
+			}
+		}
+
+		CorpusResults oResults;
+		if (!RunCorpus(sPDF, oResults))  {
+			std::cerr << "Error opening the generated document" << std::endl;
+			return 1;
+		}
+
+		std::cout << "backend:               " << Document::GetBackend() << std::endl;
+		std::cout << "document:              " << sPDF.size() << " bytes" << std::endl;
+		std::cout << "open:                  " << oResults.m_dOpenMs << " ms" << std::endl;
+		std::cout << "object resolution:     " << oResults.m_dObjectsPerSecond << " objects/s  ("
+			<< oResults.m_nObjectsResolved << " objects)" << std::endl;
+		std::cout << "key enumeration:       " << oResults.m_dKeysPerSecond << " keys/s" << std::endl;
+		std::cout << "name interning:        " << oResults.m_dNameInsertsPerSecond << " inserts/s  "
+			<< oResults.m_dNameLookupsPerSecond << " lookups/s" << std::endl;
+		std::cout << "traversal:             " << oResults.m_dTraversalSeconds << " s" << std::endl;
+		std::cout << "width arrays:          " << oResults.m_dWidthsPerSecond << " elements/s  "
+			<< oResults.m_dBulkWidthsPerSecond << " in bulk  ("
+			<< oResults.m_dBulkWidthsPerSecond / oResults.m_dWidthsPerSecond << "x)" << std::endl;
+		std::cout << "values:                " << oResults.m_dGetValuesPerSecond << " values/s  "
+			<< oResults.m_dVisitValuesPerSecond << " visited  ("
+			<< oResults.m_dVisitValuesPerSecond / oResults.m_dGetValuesPerSecond << "x)" << std::endl;
+
+		if (szJSON)  {
+			std::ofstream oOut(szJSON);
+			WriteCorpusJSON(oOut, oShape, sPDF.size(), oResults);
+			if (!oOut)  {
+				std::cerr << "Error writing " << szJSON << std::endl;
+				return 1;
+			}
+		}
+		return 0;
+	}
+
+	int
+	RunDecodeBench()
+	{
+		const size_t nSize = 16 * 1024 * 1024;
+		const int nPasses = 5;
+		FilterImpl eBest = GetFilterImpl();
+
+		std::vector<unsigned char> vData;
+		MakeImageData(vData, nSize);
+		std::string sEncoded;
+		FilterParams oParams;
+
+		ReportFlate(vData, nPasses);
+
+		EncodeASCIIHex(vData, sEncoded);
+		ReportFilter("ASCIIHexDecode:        ", kBenchHex, sEncoded, oParams, nPasses);
+		EncodeASCII85(vData, sEncoded);
+		ReportFilter("ASCII85Decode:         ", kBenchASCII85, sEncoded, oParams, nPasses);
+
+		static const char *aszTypes[] =  { "None", "Sub", "Up", "Average", "Paeth" };
+		for (int nColors=3; nColors<=4; nColors++)  {
+			oParams.m_nPredictor = 15;
+			oParams.m_nColors = nColors;
+			oParams.m_nColumns = 2400;
+			for (int nType=1; nType<=4; nType++)  {
+				EncodePNGRows(vData, nType, nColors * oParams.m_nColumns, nColors, sEncoded);
+				char szName[64];
+				sprintf(szName, "PNG %-7s, %d colors: ", aszTypes[nType], nColors);
+				ReportFilter(szName, kBenchPredictor, sEncoded, oParams, nPasses);
+			}
+		}
+
+		ReportText(nPasses);
+
+		SetFilterImpl(eBest);
+		return 0;
+	}
+
+}
+
+
+int main(int argc, char **argv)
+{
+	if (argc == 2 && strcmp(argv[1], "-decode") == 0)  {
+		return RunDecodeBench();
+	}
+	if (argc >= 2 && strcmp(argv[1], "-corpus") == 0)  {
+		return RunCorpusBench(argc, argv);
+	}
+	// spans of the whole run, for chrome://tracing or Perfetto
+	const char *szTrace = NULL;
+	if (argc == 4 && strcmp(argv[2], "-trace") == 0)  {
+		szTrace = argv[3];
+		Tracer::Start();
+	} else if (argc != 2)  {
+		std::cerr << "Usage:  " << argv[0] << " filename [-trace trace.json]" << std::endl;
+		std::cerr << "        " << argv[0] << " -decode" << std::endl;
+		std::cerr << "        " << argv[0] << " -corpus [-objects n] [-pages n] [-depth n]"
+			" [-stream-size n] [-objstm] [-xrefstm] [-backend name] [-json results.json]"
+			" [-save corpus.pdf]"
+			<< std::endl;
+		return 1;
+	}
+
+	Document::Ptr pDoc = Document::Open(argv[1]);
+	if (!pDoc)  {
+		std::cerr << "Error opening document" << std::endl;
+		return 1;
+	}
+
+	size_t nFindings;
+	double dOne = TimeRules(pDoc, 1, 1, nFindings);
+	double dHundred = TimeRules(pDoc, 100, 1, nFindings);
+	double dSeparate = TimeRules(pDoc, 1, 100, nFindings);
+
+	std::cout << "preflight, 1 rule, 1 traversal:       " << dOne << " s" << std::endl;
+	std::cout << "preflight, 100 rules, 1 traversal:    " << dHundred << " s  ("
+		<< dHundred / dOne << "x)" << std::endl;
+	std::cout << "preflight, 100 rules, 100 traversals: " << dSeparate << " s  ("
+		<< dSeparate / dOne << "x)" << std::endl;
+
+	ReportPrefetch(pDoc, 1);
+	ReportPrefetch(pDoc, 2);
+
+	if (szTrace)  {
+		Tracer::Stop();
+		if (!Tracer::Write(std::string(szTrace)))  {
+			std::cerr << "Error writing " << szTrace << std::endl;
+			return 1;
+		}
+		if (Tracer::GetDropped())  {
+			std::cerr << Tracer::GetDropped() << " trace events dropped" << std::endl;
+		}
+	}
+
+	return 0;
+}
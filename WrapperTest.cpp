@@ -5,9 +5,14 @@
  *
  */
 
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 
 #include "PDFLibWrapper.h"
+#include "PDFLibMemory.h"
+#include "PDFLibSchema.h"
+#include "PDFLibText.h"
 
 using namespace PDFLibWrapper;
 
@@ -92,38 +97,10 @@ PrintInfo(const Object::Ptr &pObject, InfoState &rState)
 			break;
 		case Object::kString:
 			{
-				std::string sVal;
+				std::string sVal, sUTF8;
 				if (pObject->Get(sVal))  {
-					bool bUnicode = false;
-					if (sVal.size() > 3 && (unsigned char)sVal[0] == 0xfe && (unsigned char)sVal[1] == 0xff)  {
-						// Unicode string
-						std::wstring wsValue;
-						std::wstring::value_type cTemp;
-						std::string::const_iterator itChar = sVal.begin(),
-							itEndChars = sVal.end();
-						itChar += 2;  // skip BOM
-						wsValue.reserve(sVal.size() / 2 - 1);
-						while (itChar != itEndChars)  {
-							cTemp = *itChar << 8;
-							if (cTemp)  {
-								bUnicode = true;
-							}
-							cTemp += *++itChar;
-							wsValue += cTemp;
-							++itChar;
-						}
-						if (bUnicode)  {
-							std::flush(std::cout);
-							std::wcout << L'(' << wsValue << L')';
-							std::flush(std::wcout);
-						} else  {
-							std::string sNarrow(wsValue.begin(), wsValue.end());
-							sVal.swap(sNarrow);
-						}
-					}
-					if (!bUnicode)  {
-						std::cout << '(' << sVal << ')';
-					}
+					DecodeTextString(sVal, sUTF8);
+					std::cout << '(' << sUTF8 << ')';
 				}
 			}
 			break;
@@ -231,10 +208,63 @@ PrintInfo(const Object::Ptr &pObject, int nDepth = 1, int nIndent = 0,
 }
 
 
+// integers a field can't hold are mistyped, not cut to fit
+struct ImageSize  {
+	ImageSize() : m_nWidth(0), m_nHeight(0)  { }
+
+	int m_nWidth;
+	unsigned int m_nHeight;
+
+	static void DescribeSchema(Schema<ImageSize> &rSchema)  {
+		rSchema.Required<int, &ImageSize::m_nWidth>("Width")
+			.Required<unsigned int, &ImageSize::m_nHeight>("Height");
+	}
+};
+
+bool
+CheckSchemaRange(const char *szDict, bool bExpected)
+{
+	std::string sPDF = "%PDF-1.4\n1 0 obj\n";
+	sPDF += szDict;
+	sPDF += "\nendobj\ntrailer\n<< /Root 1 0 R >>\n";
+	MemoryDoc oDoc;
+	Object::Ptr pDict;
+	if (!oDoc.Parse(sPDF.data(), sPDF.size()) || !oDoc.GetObject(1, pDict) || !pDict)  {
+		std::cerr << "Error parsing " << szDict << std::endl;
+		return false;
+	}
+	ImageSize oSize;
+	SchemaErrors vErrors;
+	bool bDecoded = DecodeSchema(*pDict, oSize, &vErrors);
+	bool bMistyped = !vErrors.empty() && vErrors[0].m_eKind == SchemaError::kMistyped;
+	if (bDecoded != bExpected || (!bExpected && !bMistyped))  {
+		std::cerr << "Unexpected schema result for " << szDict << std::endl;
+		return false;
+	}
+	return true;
+}
+
+int
+RunSchemaCheck()
+{
+	bool bPassed = CheckSchemaRange("<< /Width 2147483647 /Height 4294967295 >>", true);
+	bPassed &= CheckSchemaRange("<< /Width 4294967297 /Height 1 >>", false);
+	bPassed &= CheckSchemaRange("<< /Width -2147483649 /Height 1 >>", false);
+	bPassed &= CheckSchemaRange("<< /Width 1 /Height 4294967297 >>", false);
+	bPassed &= CheckSchemaRange("<< /Width 1 /Height -1 >>", false);
+	std::cout << (bPassed ? "Schema check passed" : "Schema check failed") << std::endl;
+	return bPassed ? 0 : 1;
+}
+
+
 int main(int argc, char **argv)
 {
+	if (argc == 2 && strcmp(argv[1], "-schema") == 0)  {
+		return RunSchemaCheck();
+	}
 	if (argc < 2 || argc > 3)  {
 		std::cerr << "Usage:  " << argv[0] << " filename [depth]" << std::endl;
+		std::cerr << "        " << argv[0] << " -schema" << std::endl;
 		return 1;
 	}
 	int nDepth = 1;